@@ -45,6 +45,7 @@
 
 #define EXTENSION_OBJECT	"o"
 #define EXTENSION_SCRIPT	"dbg"
+#define EXTENSION_SYMBOLS	"sym"
 
 // TODO: Support JMP with operands that are symbols in the zeropage (currently they desymbolicate and error)
 static uint16_t assembleLine(ld6502_object_blob *blob, as6502_token *head, as6502_symbol_table *table, int printProcess, int printDot, uint16_t offset) {
@@ -95,7 +96,7 @@ static uint16_t assembleLine(ld6502_object_blob *blob, as6502_token *head, as650
 	return addrLen;
 }
 
-static void assembleFile(FILE *in, FILE *out, FILE *sym, int printProcess, int printTable, int printDot, ld6502_file_type format) {
+static void assembleFile(FILE *in, FILE *out, FILE *sym, FILE *symFile, int printProcess, int printTable, int printDot, ld6502_file_type format) {
 	char *line = NULL;
 	ssize_t len;
 	size_t linecap = 0;
@@ -192,6 +193,9 @@ static void assembleFile(FILE *in, FILE *out, FILE *sym, int printProcess, int p
 	if (sym) {
 		as6502_printSymbolScript(obj->table, sym);
 	}
+	if (symFile && !as6502_writeSymbolFile(obj->table, symFile)) {
+		as6502_warn(0, 0, "Could not write symbol file");
+	}
 
 	if (printDot) {
 		printf("EOF; }");
@@ -295,7 +299,7 @@ static char *outNameFromInName(const char *in, const char *ext) {
 }
 
 static void usage() {
-	fprintf(stderr, "usage: as6502 [-dStT] [-F format] [-o outfile] [file ...]\n");
+	fprintf(stderr, "usage: as6502 [-dStTy] [-F format] [-o outfile] [file ...]\n");
 }
 
 int main(int argc, char * const argv[]) {
@@ -307,11 +311,12 @@ int main(int argc, char * const argv[]) {
 	int printTable = NO;
 	int printDot = NO;
 	int makeSymScript = NO;
+	int makeSymFile = NO;
 	ld6502_file_type format = ld6502_file_type_FlatFile;
 	currentErrorCount = 0;
 
 	int ch;
-	while ((ch = getopt(argc, argv, "dSTF:o:t")) != -1) {
+	while ((ch = getopt(argc, argv, "dSTF:o:ty")) != -1) {
 		switch (ch) {
 			case 'F': {
 				if (!strncmp(optarg, "flat", 4)) {
@@ -330,6 +335,9 @@ int main(int argc, char * const argv[]) {
 			case 't': {
 				makeSymScript = YES;
 			} break;
+			case 'y': {
+				makeSymFile = YES;
+			} break;
 			case 'd': {
 				printDot = YES;
 			} break;
@@ -357,7 +365,7 @@ int main(int argc, char * const argv[]) {
 
 		as6502_warn(0, 0, "Assembling from stdin does not support symbols");
 
-		assembleFile(stdin, stdout, sym, NO, NO, NO, format);
+		assembleFile(stdin, stdout, sym, NULL, NO, NO, NO, format);
 	}
 	else {
 		for (/* i */; i < argc; i++) {
@@ -379,9 +387,23 @@ int main(int argc, char * const argv[]) {
 			}
 			outName = NULL;
 
-			assembleFile(in, out, sym, printProcess, printTable, printDot, format);
+			// Each input gets its own symbol file, since they can't be concatenated like scripts
+			FILE *symFile = NULL;
+			if (makeSymFile) {
+				char *fname = outNameFromInName(argv[i], EXTENSION_SYMBOLS);
+				symFile = fopen(fname, "w");
+				if (!symFile) {
+					perror("as6502");
+				}
+				free(fname);
+			}
+
+			assembleFile(in, out, sym, symFile, printProcess, printTable, printDot, format);
 			fclose(in);
 			fclose(out);
+			if (symFile) {
+				fclose(symFile);
+			}
 		}
 	}
 	if(sym) {
@@ -25,6 +25,10 @@
 #include <stdio.h> // as6502_printSymbolTable
 #include <ctype.h> // isspace
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <v6502/mem.h>
 #include <v6502/cpu.h>
@@ -40,6 +44,10 @@
 
 #define MAX_ADDRESS_TEXT_LEN			6
 
+#define SYMBOL_FILE_HEADER_LEN			(as6502_symbolFileMagicLength + 12)
+#define SYMBOL_FILE_ENTRY_LEN			8
+#define SYMBOL_FILE_INDEX_LEN			4
+
 // Address Table Lifecycle Functions
 as6502_symbol_table *as6502_createSymbolTable() {
 	return calloc(1, sizeof(as6502_symbol_table));
@@ -57,6 +65,11 @@ void as6502_destroySymbolTable(as6502_symbol_table *table) {
 		free(this);
 	}
 
+	free(table->file_symbols);
+	if (table->file_map) {
+		munmap(table->file_map, table->file_size);
+	}
+
 	free(table);
 }
 
@@ -77,6 +90,214 @@ void as6502_printSymbolScript(as6502_symbol_table *table, FILE *out) {
 			default: break;
 		}
 	}
+
+	for (size_t i = 0; i < table->file_count; i++) {
+		as6502_symbol *this = &table->file_symbols[i];
+		fprintf(out, "%s %s %#x\n", this->type == as6502_symbol_type_label ? "label" : "var", this->name, this->address);
+	}
+}
+
+// Binary Symbol Files
+
+static void _putLE(uint8_t *bytes, uint32_t value, int len) {
+	for (int i = 0; i < len; i++) {
+		bytes[i] = (uint8_t)(value >> (8 * i));
+	}
+}
+
+static uint32_t _getLE(const uint8_t *bytes, int len) {
+	uint32_t value = 0;
+	for (int i = 0; i < len; i++) {
+		value |= (uint32_t)bytes[i] << (8 * i);
+	}
+	return value;
+}
+
+static int _compareSymbolNames(const void *a, const void *b) {
+	return strcmp((*(as6502_symbol * const *)a)->name, (*(as6502_symbol * const *)b)->name);
+}
+
+static int _compareSymbolAddresses(const void *a, const void *b) {
+	const as6502_symbol *left = *(as6502_symbol * const *)a;
+	const as6502_symbol *right = *(as6502_symbol * const *)b;
+
+	if (left->address != right->address) {
+		return left->address < right->address ? -1 : 1;
+	}
+	return strcmp(left->name, right->name);
+}
+
+/**
+ *	Symbols are gathered into one array and sorted twice, once to find the
+ *	order of the name index, and once for the order of the entries. Symbols
+ *	that were added more than once are only written once.
+ */
+int as6502_writeSymbolFile(as6502_symbol_table *table, FILE *out) {
+	assert(table && out);
+
+	size_t count = table->file_count;
+	for (as6502_symbol *this = table->first_symbol; this; this = this->next) {
+		count++;
+	}
+
+	as6502_symbol **symbols = malloc((count ? count : 1) * sizeof(as6502_symbol *));
+	if (!symbols) {
+		return NO;
+	}
+
+	size_t linked = 0;
+	for (as6502_symbol *this = table->first_symbol; this; this = this->next) {
+		if (as6502_symbolTypeIsLinked(this->type)) {
+			symbols[linked++] = this;
+		}
+	}
+	for (size_t i = 0; i < table->file_count; i++) {
+		symbols[linked++] = &table->file_symbols[i];
+	}
+
+	qsort(symbols, linked, sizeof(as6502_symbol *), _compareSymbolNames);
+	count = 0;
+	size_t poolSize = 0;
+	for (size_t i = 0; i < linked; i++) {
+		if (!count || strcmp(symbols[count - 1]->name, symbols[i]->name)) {
+			symbols[count++] = symbols[i];
+			poolSize += strlen(symbols[i]->name) + 1;
+		}
+	}
+
+	// The name index is the position of each name's entry, in name order
+	qsort(symbols, count, sizeof(as6502_symbol *), _compareSymbolAddresses);
+	as6502_symbol **byName = malloc((count ? count : 1) * sizeof(as6502_symbol *));
+	size_t size = SYMBOL_FILE_HEADER_LEN + count * (SYMBOL_FILE_ENTRY_LEN + SYMBOL_FILE_INDEX_LEN) + poolSize;
+	uint8_t *file = calloc(1, size);
+	if (!byName || !file) {
+		free(byName);
+		free(file);
+		free(symbols);
+		return NO;
+	}
+	memcpy(byName, symbols, count * sizeof(as6502_symbol *));
+	qsort(byName, count, sizeof(as6502_symbol *), _compareSymbolNames);
+
+	memcpy(file, as6502_symbolFileMagic, as6502_symbolFileMagicLength);
+	_putLE(file + as6502_symbolFileMagicLength, as6502_symbolFileVersion, 4);
+	_putLE(file + as6502_symbolFileMagicLength + 4, (uint32_t)count, 4);
+	_putLE(file + as6502_symbolFileMagicLength + 8, (uint32_t)poolSize, 4);
+
+	uint8_t *entries = file + SYMBOL_FILE_HEADER_LEN;
+	uint8_t *index = entries + count * SYMBOL_FILE_ENTRY_LEN;
+	char *pool = (char *)(index + count * SYMBOL_FILE_INDEX_LEN);
+	size_t poolOffset = 0;
+	for (size_t i = 0; i < count; i++) {
+		uint8_t *entry = entries + i * SYMBOL_FILE_ENTRY_LEN;
+		_putLE(entry, (uint32_t)poolOffset, 4);
+		_putLE(entry + 4, symbols[i]->address, 2);
+		entry[6] = (uint8_t)symbols[i]->type;
+
+		size_t len = strlen(symbols[i]->name) + 1;
+		memcpy(pool + poolOffset, symbols[i]->name, len);
+		poolOffset += len;
+	}
+
+	// Names are unique, so each symbol's entry can be found by binary searching the entries for it
+	for (size_t i = 0; i < count; i++) {
+		size_t low = 0, high = count;
+		while (low < high) {
+			size_t middle = (low + high) / 2;
+			if (_compareSymbolAddresses(&symbols[middle], &byName[i]) < 0) {
+				low = middle + 1;
+			}
+			else {
+				high = middle;
+			}
+		}
+		_putLE(index + i * SYMBOL_FILE_INDEX_LEN, (uint32_t)low, 4);
+	}
+
+	int written = fwrite(file, 1, size, out) == size;
+	free(file);
+	free(byName);
+	free(symbols);
+	return written;
+}
+
+static void _unloadSymbolFile(as6502_symbol_table *table) {
+	free(table->file_symbols);
+	if (table->file_map) {
+		munmap(table->file_map, table->file_size);
+	}
+
+	table->file_symbols = NULL;
+	table->file_count = 0;
+	table->file_names = NULL;
+	table->file_map = NULL;
+	table->file_size = 0;
+}
+
+/**
+ *	Everything the lookups depend on is checked up front, so that a truncated
+ *	or corrupt file is refused rather than read out of bounds later.
+ */
+int as6502_loadSymbolFile(as6502_symbol_table *table, const char *path) {
+	assert(table && path);
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return NO;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) || (size_t)info.st_size < SYMBOL_FILE_HEADER_LEN) {
+		close(fd);
+		return NO;
+	}
+
+	size_t size = info.st_size;
+	uint8_t *file = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (file == MAP_FAILED) {
+		return NO;
+	}
+
+	uint64_t count = _getLE(file + as6502_symbolFileMagicLength + 4, 4);
+	uint64_t poolSize = _getLE(file + as6502_symbolFileMagicLength + 8, 4);
+	const uint8_t *entries = file + SYMBOL_FILE_HEADER_LEN;
+	const uint8_t *index = entries + count * SYMBOL_FILE_ENTRY_LEN;
+	const char *pool = (const char *)(index + count * SYMBOL_FILE_INDEX_LEN);
+
+	int valid = !memcmp(file, as6502_symbolFileMagic, as6502_symbolFileMagicLength) &&
+				_getLE(file + as6502_symbolFileMagicLength, 4) == as6502_symbolFileVersion &&
+				SYMBOL_FILE_HEADER_LEN + count * (SYMBOL_FILE_ENTRY_LEN + SYMBOL_FILE_INDEX_LEN) + poolSize == size &&
+				(!poolSize || !pool[poolSize - 1]);
+
+	as6502_symbol *symbols = valid ? calloc(count ? count : 1, sizeof(as6502_symbol)) : NULL;
+	for (size_t i = 0; symbols && i < count; i++) {
+		const uint8_t *entry = entries + i * SYMBOL_FILE_ENTRY_LEN;
+		uint32_t name = _getLE(entry, 4);
+		if (name >= poolSize || _getLE(index + i * SYMBOL_FILE_INDEX_LEN, 4) >= count || !as6502_symbolTypeIsLinked(entry[6])) {
+			free(symbols);
+			symbols = NULL;
+			break;
+		}
+
+		// The names are never written, so they can stay in the read only mapping
+		symbols[i].name = (char *)pool + name;
+		symbols[i].address = (uint16_t)_getLE(entry + 4, 2);
+		symbols[i].type = entry[6];
+	}
+
+	if (!symbols) {
+		munmap(file, size);
+		return NO;
+	}
+
+	_unloadSymbolFile(table);
+	table->file_symbols = symbols;
+	table->file_count = count;
+	table->file_names = index;
+	table->file_map = file;
+	table->file_size = size;
+	return YES;
 }
 
 void as6502_printSymbolTable(as6502_symbol_table *table) {
@@ -111,6 +332,10 @@ void as6502_printSymbolTable(as6502_symbol_table *table) {
 			printf("\t%s { name = \"%s\", not linked!, next = %p, line = %lu }\n", type, this->name, this->next, this->line);
 		}
 	}
+	for (size_t i = 0; i < table->file_count; i++) {
+		as6502_symbol *this = &table->file_symbols[i];
+		printf("\t%s { name = \"%s\", addr = %#x, from file }\n", this->type == as6502_symbol_type_label ? "Label" : "Var", this->name, this->address);
+	}
 	printf("}\n");
 }
 
@@ -124,6 +349,23 @@ as6502_symbol *as6502_symbolForString(as6502_symbol_table *table, const char *na
 		}
 	}
 
+	// The file's name index is sorted, so it can be searched
+	size_t low = 0, high = table->file_count;
+	while (low < high) {
+		size_t middle = (low + high) / 2;
+		as6502_symbol *this = &table->file_symbols[_getLE(table->file_names + middle * SYMBOL_FILE_INDEX_LEN, 4)];
+		int order = strcmp(this->name, name);
+		if (!order) {
+			return this;
+		}
+		if (order < 0) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+
 	return NULL;
 }
 
@@ -136,6 +378,21 @@ as6502_symbol *as6502_symbolForAddress(as6502_symbol_table *table, uint16_t addr
 		}
 	}
 
+	// The file's symbols are sorted by address, so the first at an address is found with a binary search
+	size_t low = 0, high = table->file_count;
+	while (low < high) {
+		size_t middle = (low + high) / 2;
+		if (table->file_symbols[middle].address < address) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	if (low < table->file_count && table->file_symbols[low].address == address) {
+		return &table->file_symbols[low];
+	}
+
 	return NULL;
 }
 
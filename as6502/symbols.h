@@ -27,9 +27,28 @@
 #define as6502_symbols_h
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
 
 #include <as6502/token.h>
 
+/** @brief Bytes at the start of every binary symbol file */
+#define as6502_symbolFileMagic			"v6502sym"
+/** @brief Length of as6502_symbolFileMagic, without a terminator */
+#define as6502_symbolFileMagicLength	8
+/** @brief Version of the binary symbol file format written by as6502_writeSymbolFile */
+#define as6502_symbolFileVersion		1
+
+/** A binary symbol file holds the linked labels and variables of a symbol table, so that a debugger can load tens of thousands of them without parsing a script. Every field is little endian.
+
+	- A header: as6502_symbolFileMagic, then the version, the symbol count, and the byte-length of the string pool, each 32 bits.
+	- An entry per symbol, sorted by address: a 32-bit offset of its name in the string pool, its 16-bit address, and its 8-bit as6502_symbol_type, padded to 8 bytes.
+	- An index of 32-bit entry numbers, sorted by name.
+	- The string pool, which holds every name, each with a terminator.
+
+	as6502_loadSymbolFile maps the file, rather than reading it, and the names of the loaded symbols point straight into the string pool.
+ */
+
 /** @defgroup sym_type_macros Symbol Type Test Macros */
 /**@{*/
 /** @brief Return YES if a given as6502_symbol_type has a low link bit */
@@ -71,6 +90,16 @@ typedef struct /** @cond STRUCT_FORWARD_DECLS */ _as6502_symbol /** @endcond */
 typedef struct {
 	/** @brief The head of the linked list of labels */
 	as6502_symbol *first_symbol;
+	/** @brief Symbols loaded from a binary symbol file, sorted by address, which are looked up after the linked list, or NULL */
+	as6502_symbol *file_symbols;
+	/** @brief Number of symbols in as6502_symbol_table::file_symbols */
+	size_t file_count;
+	/** @brief The symbol file's index of entry numbers, sorted by name */
+	const uint8_t *file_names;
+	/** @brief The mapped symbol file */
+	void *file_map;
+	/** @brief Byte-length of as6502_symbol_table::file_map */
+	size_t file_size;
 } as6502_symbol_table;
 
 /** @defgroup sym_lifecycle Symbol Table Lifecycle Functions */
@@ -83,6 +112,11 @@ void as6502_destroySymbolTable(as6502_symbol_table *table);
 void as6502_printSymbolTable(as6502_symbol_table *table);
 /** @brief Generates a debugger script containing all of the commands necessary for loading the symbol table generated during assembly into the debugger */
 void as6502_printSymbolScript(as6502_symbol_table *table, FILE *out);
+/** @brief Writes the linked symbols of a table as a binary symbol file, returning NO if it couldn't be written */
+int as6502_writeSymbolFile(as6502_symbol_table *table, FILE *out);
+/** @brief Maps a binary symbol file into a table, replacing any file loaded before, and returning NO if it isn't a valid symbol file */
+/** The loaded symbols are found by as6502_symbolForString and as6502_symbolForAddress in logarithmic time, but they aren't in the linked list, so they can't be removed. */
+int as6502_loadSymbolFile(as6502_symbol_table *table, const char *path);
 /**@}*/
 
 /** @defgroup sym_access Symbol Table Accessors */
@@ -48,7 +48,7 @@ static void printLabel(FILE *out, int verbose, as6502_symbol *label) {
 	}
 }
 
-static void disassembleFile(const char *in, FILE *out, ld6502_file_type format, uint16_t pstart, int printTable, int verbose, FILE *sym) {
+static void disassembleFile(const char *in, FILE *out, ld6502_file_type format, uint16_t pstart, int printTable, int verbose, FILE *sym, const char *symFileName) {
 	char line[MAX_LINE_LEN];
 	int insideOfString = 0;
 
@@ -163,12 +163,22 @@ static void disassembleFile(const char *in, FILE *out, ld6502_file_type format,
 		}
 	}
 
+	if (symFileName) {
+		FILE *symFile = fopen(symFileName, "w");
+		if (!symFile || !as6502_writeSymbolFile(table, symFile)) {
+			perror("dis6502");
+		}
+		if (symFile) {
+			fclose(symFile);
+		}
+	}
+
 	as6502_destroySymbolTable(table);
 	ld6502_destroyObject(obj);
 }
 
 static void usage() {
-	fprintf(stderr, "usage: dis6502 [-tTv] [-o out_file] [-F format] [-s load_address] [file ...]\n");
+	fprintf(stderr, "usage: dis6502 [-tTv] [-o out_file] [-F format] [-s load_address] [-y symbol_file] [file ...]\n");
 }
 
 int main(int argc, char * const argv[]) {
@@ -177,10 +187,11 @@ int main(int argc, char * const argv[]) {
 	uint16_t programStart = 0;
 	int printTable = NO;
 	FILE *sym = NULL;
+	const char *symFileName = NULL;
 	int verbose = NO;
 
 	int ch;
-	while ((ch = getopt(argc, argv, "o:F:s:Tt:v")) != -1) {
+	while ((ch = getopt(argc, argv, "o:F:s:Tt:vy:")) != -1) {
 		switch (ch) {
 			case 'F': {
 				if (!strncmp(optarg, "ines", 4)) {
@@ -205,6 +216,9 @@ int main(int argc, char * const argv[]) {
 			case 'v': {
 				verbose = YES;
 			} break;
+			case 'y': {
+				symFileName = optarg;
+			} break;
 			case '?':
 			default:
 				usage();
@@ -215,8 +229,15 @@ int main(int argc, char * const argv[]) {
 	argc -= optind;
 	argv += optind;
 
+	// A symbol file holds one table, and every input derives its own
+	if (symFileName && argc > 1) {
+		fprintf(stderr, "dis6502: -y can only be used with one input file\n");
+		usage();
+		return EXIT_FAILURE;
+	}
+
 	for (int i = 0; i < argc; i++) {
-		disassembleFile(argv[i], out, format, programStart, printTable, verbose, sym);
+		disassembleFile(argv[i], out, format, programStart, printTable, verbose, sym, symFileName);
 	}
 
 	if (sym) {
@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sysexits.h>
+
+#include <v6502/cpu.h>
+#include <v6502/ppu.h>
+#include <v6502/search.h>
+#include <v6502/log.h>
+
+#pragma mark Benchmark Harness
+
+#define TOTAL_BENCHMARKS	(sizeof(benchmarkFunctions) / sizeof(benchmarkFunction))
+#define ACCESS_COUNT		(1UL << 24)
+#define TILE_COUNT			(1UL << 22)
+#define FRAME_COUNT			2000
+#define SEARCH_COUNT		2000
+#define DUMP_COUNT			50
+
+typedef void (* benchmarkFunction)(void);
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint8_t returnOffset(struct _v6502_memory *memory, uint16_t offset, int trap, void *context) {
+	return (uint8_t)offset;
+}
+
+#pragma mark - Benchmarks
+
+/* Reads are spread over the whole address space, half of which is covered by
+ * ranges, so that both hits and misses are measured. Sequential reads model
+ * instruction fetch, scattered reads model data access.
+ */
+static void bench_mappedReads(size_t rangeCount, int cached) {
+	v6502_memory *memory = v6502_createMemory(0x10000);
+	memory->mapCacheEnabled = cached;
+
+	size_t stride = 0x10000 / rangeCount;
+	for (size_t i = 0; i < rangeCount; i++) {
+		v6502_map(memory, (uint16_t)(i * stride), stride / 2, returnOffset, NULL, NULL);
+	}
+
+	volatile uint8_t sink = 0;
+	double start = now();
+	for (unsigned long i = 0; i < ACCESS_COUNT; i++) {
+		sink += v6502_read(memory, (uint16_t)i, NO);
+	}
+	double sequential = now() - start;
+
+	start = now();
+	for (unsigned long i = 0; i < ACCESS_COUNT; i++) {
+		sink += v6502_read(memory, (uint16_t)(i * 0x9E37), NO);
+	}
+	double scattered = now() - start;
+
+	printf("%2zu ranges, %-8s %6.2f ns/read sequential, %6.2f ns/read scattered\n",
+		   rangeCount, cached ? "cached:" : "sorted:",
+		   sequential * 1e9 / ACCESS_COUNT, scattered * 1e9 / ACCESS_COUNT);
+
+	v6502_destroyMemory(memory);
+}
+
+static void bench_mappedReads1(void) {
+	bench_mappedReads(1, NO);
+	bench_mappedReads(1, YES);
+}
+
+static void bench_mappedReads8(void) {
+	bench_mappedReads(8, NO);
+	bench_mappedReads(8, YES);
+}
+
+static void bench_mappedReads64(void) {
+	bench_mappedReads(64, NO);
+	bench_mappedReads(64, YES);
+}
+
+/* A whole 8KB CHR ROM of noise is decoded over and over, which is the worst
+ * case for branchy code, since no two rows look alike.
+ */
+static void bench_tileDecoding(void) {
+	uint8_t chr[512 * ppu_bytesPerTile];
+	for (size_t i = 0; i < sizeof(chr); i++) {
+		chr[i] = (uint8_t)((i * 0x9E37) >> 5);
+	}
+	uint8_t *pixels = malloc(512 * ppu_pixelsPerTile);
+
+	double start = now();
+	for (unsigned long i = 0; i < TILE_COUNT; i += 512) {
+		ppu_decodeTilesScalar(chr, 512, pixels);
+	}
+	double scalar = now() - start;
+
+	start = now();
+	for (unsigned long i = 0; i < TILE_COUNT; i += 512) {
+		ppu_decodeTiles(chr, 512, pixels);
+	}
+	double vector = now() - start;
+
+	printf("tile decoding: %6.1f Mtiles/s scalar, %6.1f Mtiles/s vector\n",
+		   TILE_COUNT / scalar / 1e6, TILE_COUNT / vector / 1e6);
+
+	free(pixels);
+}
+
+static void bench_nametableRendering(void) {
+	uint8_t chr[256 * ppu_bytesPerTile];
+	uint8_t nametable[ppu_nametableSize];
+	for (size_t i = 0; i < sizeof(chr); i++) {
+		chr[i] = (uint8_t)((i * 0x9E37) >> 5);
+	}
+	for (size_t i = 0; i < sizeof(nametable); i++) {
+		nametable[i] = (uint8_t)(i * 7);
+	}
+
+	v6502_ppu *ppu = ppu_create(NULL, 0, chr, sizeof(chr));
+
+	double start = now();
+	for (int i = 0; i < FRAME_COUNT; i++) {
+		nametable[i % ppu_attributeOffset]++;
+		ppu_renderNametable(ppu, nametable);
+	}
+	double elapsed = now() - start;
+
+	printf("nametable rendering: %8.0f frames/s, %6.1f Mtiles/s\n",
+		   FRAME_COUNT / elapsed, FRAME_COUNT * (double)(ppu_columns * ppu_rows) / elapsed / 1e6);
+
+	ppu_destroy(ppu);
+}
+
+/* A whole address space of noise is searched for a pattern whose anchor byte
+ * is common in it, so that the full compare runs often, then filtered over
+ * and over, with one byte changing between filters.
+ */
+static void bench_memorySearch(void) {
+	static uint8_t image[search_trackedSize];
+	for (size_t i = 0; i < sizeof(image); i++) {
+		image[i] = (uint8_t)((i * 0x9E37) >> 5);
+	}
+
+	search_pattern pattern;
+	search_parsePattern("?? 9e ?? 37", &pattern);
+	size_t match;
+
+	double start = now();
+	for (int i = 0; i < SEARCH_COUNT; i++) {
+		search_findPatternScalar(image, sizeof(image), &pattern, &match, 1);
+	}
+	double scalar = now() - start;
+
+	start = now();
+	for (int i = 0; i < SEARCH_COUNT; i++) {
+		search_findPattern(image, sizeof(image), &pattern, &match, 1);
+	}
+	double vector = now() - start;
+
+	printf("pattern search: %7.1f MB/s scalar, %7.1f MB/s vector\n",
+		   SEARCH_COUNT * (double)sizeof(image) / scalar / 1e6, SEARCH_COUNT * (double)sizeof(image) / vector / 1e6);
+
+	search_tracker *tracker = malloc(sizeof(search_tracker));
+	search_startTracking(tracker, image);
+
+	start = now();
+	for (int i = 0; i < SEARCH_COUNT; i++) {
+		image[i] ^= 0x55;
+		search_filterScalar(tracker, image, search_rule_changed, 0);
+	}
+	scalar = now() - start;
+
+	search_startTracking(tracker, image);
+	start = now();
+	for (int i = 0; i < SEARCH_COUNT; i++) {
+		image[i] ^= 0x55;
+		search_filter(tracker, image, search_rule_changed, 0);
+	}
+	vector = now() - start;
+
+	printf("tracking filter: %6.1f MB/s scalar, %7.1f MB/s vector\n",
+		   SEARCH_COUNT * (double)sizeof(image) / scalar / 1e6, SEARCH_COUNT * (double)sizeof(image) / vector / 1e6);
+
+	free(tracker);
+}
+
+/* The formatter is compared against the printf per byte that
+ * v6502_printMemoryRange used to do, both writing all of memory to /dev/null.
+ */
+static void bench_memoryDump(void) {
+	static uint8_t image[0x10000];
+	for (size_t i = 0; i < sizeof(image); i++) {
+		image[i] = (uint8_t)(i * 0x9E37);
+	}
+
+	FILE *out = fopen("/dev/null", "w");
+	if (!out) {
+		return;
+	}
+
+	double start = now();
+	for (int i = 0; i < DUMP_COUNT; i++) {
+		fprintf(out, "      0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F\n");
+		for (size_t y = 0; y < sizeof(image); y += 0x10) {
+			fprintf(out, "%04zx ", y);
+			for (size_t x = y; x < y + 0x10; x++) {
+				fprintf(out, "%02x ", image[x]);
+			}
+			fprintf(out, "\n");
+		}
+	}
+	double perByte = now() - start;
+
+	start = now();
+	for (int i = 0; i < DUMP_COUNT; i++) {
+		v6502_printMemoryBytes(out, 0, image, sizeof(image));
+	}
+	double buffered = now() - start;
+
+	printf("memory dump: %10.1f ms per 64K printf per byte, %7.1f ms buffered\n",
+		   perByte / DUMP_COUNT * 1e3, buffered / DUMP_COUNT * 1e3);
+
+	fclose(out);
+}
+
+#pragma mark - Benchmark Harness
+
+/* Benchmarks are not pass/fail, they just print their own results. Adding one
+ * works the same way as adding a unit test in main.c.
+ */
+static benchmarkFunction benchmarkFunctions[] = {
+	bench_mappedReads1,
+	bench_mappedReads8,
+	bench_mappedReads64,
+	bench_tileDecoding,
+	bench_nametableRendering,
+	bench_memorySearch,
+	bench_memoryDump,
+};
+
+int main(int argc, const char *argv[]) {
+	for (size_t i = 0; i < TOTAL_BENCHMARKS; i++) {
+		benchmarkFunctions[i]();
+	}
+
+	return EX_OK;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * A device plugin with one register, which counts the writes to it, and can
+ * be snapshotted. It is built as a shared object and loaded by the unit tests.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <v6502/plugin.h>
+
+#define COUNTER_DEFAULT_REGISTER	0x4000
+
+typedef struct {
+	v6502_cpu *cpu;
+	const v6502_deviceHost *host;
+	uint16_t address;
+	uint8_t count;
+} counter;
+
+static uint8_t counter_read(v6502_memory *memory, uint16_t offset, int trap, void *context) {
+	return ((counter *)context)->count;
+}
+
+static void counter_write(v6502_memory *memory, uint16_t offset, uint8_t value, void *context) {
+	((counter *)context)->count++;
+}
+
+static void *counter_create(v6502_cpu *cpu, const v6502_deviceHost *host, const char *args) {
+	counter *dev = calloc(1, sizeof(counter));
+	if (!dev) {
+		return NULL;
+	}
+
+	dev->cpu = cpu;
+	dev->host = host;
+	dev->address = args ? strtol(args, NULL, 16) : COUNTER_DEFAULT_REGISTER;
+	return dev;
+}
+
+static int counter_map(void *device) {
+	counter *dev = device;
+	return dev->host->map(dev->cpu->memory, dev->address, 1, counter_read, counter_write, dev);
+}
+
+static void counter_reset(void *device) {
+	((counter *)device)->count = 0;
+}
+
+static size_t counter_snapshot(void *device, uint8_t *buffer, size_t size) {
+	if (buffer && size >= 1) {
+		buffer[0] = ((counter *)device)->count;
+	}
+	return 1;
+}
+
+static int counter_restore(void *device, const uint8_t *buffer, size_t size) {
+	if (size != 1) {
+		return 0;
+	}
+
+	((counter *)device)->count = buffer[0];
+	return 1;
+}
+
+static void counter_destroy(void *device) {
+	free(device);
+}
+
+static const v6502_deviceDescriptor _descriptor = {
+	.abiVersion = v6502_deviceABIVersion,
+	.name = "counter",
+	.create = counter_create,
+	.map = counter_map,
+	.reset = counter_reset,
+	.snapshot = counter_snapshot,
+	.restore = counter_restore,
+	.destroy = counter_destroy,
+};
+
+const v6502_deviceDescriptor *v6502_deviceEntry(void) {
+	return &_descriptor;
+}
@@ -21,12 +21,30 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <sysexits.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
 
 #include <as6502/color.h>
 #include <v6502/cpu.h>
 #include <v6502/log.h>
+#include <v6502/bank.h>
+#include <v6502/textmode.h>
+#include <v6502/keyboard.h>
+#include <v6502/timer.h>
+#include <v6502/block.h>
+#include <v6502/uart.h>
+#include <v6502/plugin.h>
+#include <v6502/ppu.h>
+#include <v6502/search.h>
+#include <v6502/gdbstub.h>
+#include <v6502/history.h>
+#include <v6502/worker.h>
+#include <v6502/breakpoint.h>
+#include <v6502/ring.h>
 #include <as6502/parser.h>
 
 #pragma mark Test Harness
@@ -47,6 +65,10 @@ static uint8_t returnHigh(struct _v6502_memory *memory, uint16_t offset, int tra
 	return ~0;
 }
 
+static uint8_t returnContext(struct _v6502_memory *memory, uint16_t offset, int trap, void *context) {
+	return *(uint8_t *)context;
+}
+
 static v6502_address_mode bruteForce_addressModeForOpcode(v6502_opcode opcode) {
 	switch (opcode) {
 		case v6502_opcode_brk:
@@ -440,6 +462,1723 @@ static int test_ceilingMemoryMapping() {
 	return rc;
 }
 
+static int test_unorderedMemoryMapping() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure mapped ranges are found regardless of the order they were mapped in...\n");
+
+	// Map every other 0x100 byte page backwards, each returning its own page number
+	uint8_t pages[0x80];
+	v6502_memory *memory = v6502_createMemory(0x10000);
+	for (int i = 0x7F; i >= 0; i--) {
+		pages[i] = i * 2;
+		if (!v6502_map(memory, i * 0x200, 0x100, returnContext, NULL, &pages[i])) {
+			printf("Couldn't map page %#02x!\n", i * 2);
+			rc++;
+		}
+	}
+
+	// Contiguous with a range mapped earlier, but below it
+	if (!v6502_map(memory, 0x0100, 0x100, returnHigh, NULL, NULL)) {
+		printf("Couldn't map a range directly below an existing one!\n");
+		rc++;
+	}
+	if (v6502_map(memory, 0x02FF, 2, returnHigh, NULL, NULL)) {
+		printf("Mapped a range straddling two existing ones!\n");
+		rc++;
+	}
+
+	// Walk the address space out of order, so the last hit is rarely right
+	v6502_writeBacking(memory, 0x0301, 0x5A);
+	for (uint32_t i = 0; i < 0x10000; i++) {
+		uint16_t address = (uint16_t)(i * 0x9E37);
+		uint8_t expected;
+		if ((address >> 8) & 1) {
+			expected = (address >> 8) == 0x01 ? BYTE_MAX : v6502_readBacking(memory, address);
+		}
+		else {
+			expected = address >> 8;
+		}
+
+		if (v6502_read(memory, address, NO) != expected) {
+			printf("Bad read at %#04x!\n", address);
+			rc++;
+			break;
+		}
+	}
+
+	v6502_destroyMemory(memory);
+	return rc;
+}
+
+static int test_extendedMemoryBanking() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure bank registers switch which part of extended memory is visible...\n");
+
+	// 1 megabyte of 8k banks, shown through two windows at 0x8000 and 0xA000
+	v6502_memory *memory = v6502_createMemory(0x10000);
+	v6502_extendedMemory *ext = v6502_createExtendedMemory(memory, 0x100000, 0x2000, 0x8000, 2, 0x7FF0);
+	if (!ext) {
+		printf("Couldn't create extended memory!\n");
+		v6502_destroyMemory(memory);
+		return 1;
+	}
+
+	// Select bank 0x45 in the first window, by writing the registers like the CPU would
+	v6502_write(memory, 0x7FF0, 0x45);
+	v6502_write(memory, 0x7FF1, 0x00);
+	v6502_write(memory, 0x8123, 0xA5);
+	if (ext->bytes[(0x45 * 0x2000) + 0x123] != 0xA5) {
+		printf("Write to the window didn't land in the selected bank!\n");
+		rc++;
+	}
+
+	// The same bank in the second window should alias it
+	v6502_write(memory, 0x7FF2, 0x45);
+	if (v6502_read(memory, 0xA123, NO) != 0xA5 || v6502_read(memory, 0x7FF2, NO) != 0x45) {
+		printf("Second window doesn't show the same bank!\n");
+		rc++;
+	}
+
+	// Switch away and back
+	v6502_selectBank(ext, 0, 0x7F);
+	if (v6502_read(memory, 0x8123, NO) != 0x00) {
+		printf("Switching banks didn't change the window!\n");
+		rc++;
+	}
+	v6502_selectBank(ext, 0, 0x45);
+	if (v6502_read(memory, 0x8123, NO) != 0xA5) {
+		printf("Switching back didn't restore the bank!\n");
+		rc++;
+	}
+
+	// Memory outside the windows is untouched
+	v6502_write(memory, 0x7000, 0x5A);
+	if (memory->bytes[0x7000] != 0x5A || memory->bytes[0x8123] != 0x00) {
+		printf("Ordinary memory was disturbed by the windows!\n");
+		rc++;
+	}
+
+	v6502_destroyMemory(memory);
+	v6502_destroyExtendedMemory(ext);
+	return rc;
+}
+
+static void recordFlush(struct _v6502_memory *memory, uint16_t start, size_t size, void *context) {
+	size_t *flushes = context;
+	flushes[0]++;
+	flushes[1] = start;
+	flushes[2] = size;
+}
+
+static int test_deferredWriteNotification() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure writes to deferred ranges are coalesced into a single flush...\n");
+
+	size_t flushes[3] = {0, 0, 0};
+	v6502_memory *memory = v6502_createMemory(0x10000);
+
+	if (v6502_mapDeferred(memory, 0x2080, 0x100, NULL, recordFlush, flushes)) {
+		printf("Mapped a deferred range that isn't page aligned!\n");
+		rc++;
+	}
+	if (!v6502_mapDeferred(memory, 0x2000, 0x200, NULL, recordFlush, flushes)) {
+		printf("Couldn't map the deferred range!\n");
+		v6502_destroyMemory(memory);
+		return rc + 1;
+	}
+
+	v6502_write(memory, 0x2010, 0x11);
+	v6502_write(memory, 0x2100, 0x22);
+	v6502_write(memory, 0x2005, 0x33);
+	if (flushes[0]) {
+		printf("Flush was called before the batch ended!\n");
+		rc++;
+	}
+	if (v6502_read(memory, 0x2100, NO) != 0x22) {
+		printf("Deferred write wasn't stored!\n");
+		rc++;
+	}
+
+	v6502_flushMemory(memory);
+	if (flushes[0] != 1 || flushes[1] != 0x2005 || flushes[2] != 0x2100 - 0x2005 + 1) {
+		printf("Expected one flush of 0x2005-0x2100, got %zu flushes, last %#zx + %#zx!\n", flushes[0], flushes[1], flushes[2]);
+		rc++;
+	}
+
+	v6502_flushMemory(memory);
+	if (flushes[0] != 1) {
+		printf("Flushed again with nothing written!\n");
+		rc++;
+	}
+
+	v6502_destroyMemory(memory);
+	return rc;
+}
+
+static void countFault(void *context, const char *reason) {
+	(*(int *)context)++;
+}
+
+static int test_sparseMemory() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure sparse memory only allocates pages when they are written, within budget...\n");
+
+	int faults = 0;
+	v6502_cpu *cpu = v6502_createCPU();
+	cpu->memory = v6502_createSparseMemory(0x10000, 3);
+	cpu->memory->fault_callback = countFault;
+	cpu->memory->fault_context = &faults;
+
+	v6502_reset(cpu);
+	if (v6502_read(cpu->memory, 0x1234, NO) || cpu->memory->pageCount) {
+		printf("Untouched sparse memory isn't empty!\n");
+		rc++;
+	}
+
+	// Zero page, then the stack
+	v6502_write(cpu->memory, 0x0010, 0x11);
+	v6502_write(cpu->memory, 0x0011, 0x22);
+	TEST_ASM("lda #$42");
+	TEST_ASM("pha");
+	if (cpu->memory->pageCount != 2 || v6502_read(cpu->memory, 0x0011, NO) != 0x22 || v6502_read(cpu->memory, 0x01FF, NO) != 0x42) {
+		printf("Expected two pages holding the written values, got %zu pages!\n", cpu->memory->pageCount);
+		rc++;
+	}
+
+	// The third page fits the budget, the fourth doesn't
+	v6502_write(cpu->memory, 0x8000, 0x33);
+	v6502_write(cpu->memory, 0x9000, 0x44);
+	if (cpu->memory->pageCount != 3 || faults != 1 || v6502_read(cpu->memory, 0x9000, NO)) {
+		printf("Page budget wasn't enforced!\n");
+		rc++;
+	}
+
+	v6502_clearMemory(cpu->memory);
+	if (cpu->memory->pageCount || v6502_read(cpu->memory, 0x8000, NO)) {
+		printf("Clearing didn't release the pages!\n");
+		rc++;
+	}
+
+	v6502_destroyMemory(cpu->memory);
+	v6502_destroyCPU(cpu);
+	return rc;
+}
+
+static int test_sharedPages() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure identical images share pages, until they are written...\n");
+
+	// Two and a half pages, loaded so that the first half page is partial
+	uint8_t image[0x280];
+	for (size_t i = 0; i < sizeof(image); i++) {
+		image[i] = (i * 7) + (i >> 8);
+	}
+
+	v6502_pagePool *pool = v6502_createPagePool();
+	v6502_memory *sparse = v6502_createSparseMemory(0x10000, 0);
+	v6502_memory *flat = v6502_createMemory(0x10000);
+	sparse->pagePool = pool;
+	flat->pagePool = pool;
+
+	v6502_loadBytesIntoMemory(sparse, image, sizeof(image), 0x0680);
+	v6502_loadBytesIntoMemory(flat, image, sizeof(image), 0x0680);
+	if (pool->pageCount != 2 || sparse->readPages[0x07] != flat->readPages[0x07] || sparse->readPages[0x08] != flat->readPages[0x08]) {
+		printf("Expected 2 shared pages, got %zu!\n", pool->pageCount);
+		rc++;
+	}
+	if (sparse->pageCount != 1 || v6502_read(sparse, 0x0680, NO) != image[0] || v6502_read(flat, 0x08FF, NO) != image[0x27F]) {
+		printf("Partial page wasn't loaded privately!\n");
+		rc++;
+	}
+
+	// Writing to one copy must not show up in the other
+	v6502_write(flat, 0x0700, 0xEE);
+	if (v6502_read(sparse, 0x0700, NO) != image[0x80] || v6502_read(flat, 0x0701, NO) != image[0x81] || flat->readPages[0x07] != flat->bytes + 0x0700) {
+		printf("Write to a shared page wasn't copied!\n");
+		rc++;
+	}
+
+	v6502_clearMemory(sparse);
+	if (sparse->pageCount || v6502_read(sparse, 0x0800, NO) || pool->pageCount != 1) {
+		printf("Clearing didn't release the shared pages!\n");
+		rc++;
+	}
+
+	v6502_destroyMemory(flat);
+	if (pool->pageCount) {
+		printf("Destroying memory didn't release the shared pages!\n");
+		rc++;
+	}
+
+	v6502_destroyMemory(sparse);
+	v6502_destroyPagePool(pool);
+	return rc;
+}
+
+static int test_headlessTextMode() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure headless text mode draws frames that can be hashed and compared...\n");
+
+	v6502_memory *memory = v6502_createMemory(0x10000);
+	v6502_textmode_video *vid = textMode_create(memory, textMode_backend_headless);
+
+	v6502_write(memory, textMode_addressForLocation(0, 0), 'H');
+	v6502_write(memory, textMode_addressForLocation(1, 0), 'i');
+	v6502_write(memory, textMode_addressForLocation(1, 0) + (textMode_attributeMemoryStart - textMode_characterMemoryStart), 0x17);
+	v6502_flushMemory(memory);
+
+	v6502_textmode_frame before = *textMode_grabFrame(vid);
+	if (vid->screen || memcmp(before.characters[0], "Hi  ", 4) || before.attributes[0][1] != 0x17) {
+		printf("Frame doesn't hold what was written!\n");
+		rc++;
+	}
+
+	// A new character, and a new attribute for a blank cell
+	v6502_write(memory, textMode_addressForLocation(5, 2), '!');
+	v6502_write(memory, textMode_addressForLocation(7, 3) + (textMode_attributeMemoryStart - textMode_characterMemoryStart), 0x42);
+	v6502_flushMemory(memory);
+
+	int x = -1;
+	int y = -1;
+	const v6502_textmode_frame *after = textMode_grabFrame(vid);
+	if (textMode_diffFrames(&before, after, &x, &y) != 2 || x != 5 || y != 2 || after->attributes[3][7] != 0x42 || textMode_hashFrame(&before) == textMode_hashFrame(after)) {
+		printf("Expected two differences starting at 5,2, got one at %d,%d!\n", x, y);
+		rc++;
+	}
+
+	textMode_destroy(vid);
+	v6502_destroyMemory(memory);
+	return rc;
+}
+
+static int test_textModeRecording() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure text mode recordings only hold the run-length coded cells that changed...\n");
+
+	v6502_cpu *cpu = v6502_createCPU();
+	cpu->memory = v6502_createMemory(0x10000);
+	v6502_textmode_video *vid = textMode_create(cpu->memory, textMode_backend_headless);
+	FILE *stream = tmpfile();
+	textMode_startRecording(vid, stream, cpu);
+
+	// One cell, then a run of 40 identical cells on the next row
+	v6502_write(cpu->memory, textMode_addressForLocation(0, 0), 'A');
+	for (int x = 0; x < 40; x++) {
+		v6502_write(cpu->memory, textMode_addressForLocation(x, 1), 'B');
+	}
+	v6502_flushMemory(cpu->memory);
+	textMode_grabFrame(vid);
+
+	// Nothing changed, so nothing is recorded
+	v6502_write(cpu->memory, textMode_addressForLocation(0, 0), 'A');
+	v6502_flushMemory(cpu->memory);
+	textMode_stopRecording(vid);
+
+	// Header, then cycles and span count, then skip, run count, repeat, character and attribute for each span
+	const uint8_t expected[] = {
+		'v', '6', 't', 'r', textMode_recordingVersion, textMode_columns, textMode_rows,
+		0, 2,
+		0, 1, 1, 'A', 0,
+		79, 1, 40, 'B', 0,
+	};
+	uint8_t recorded[sizeof(expected) + 1];
+	rewind(stream);
+	size_t length = fread(recorded, 1, sizeof(recorded), stream);
+	if (length != sizeof(expected) || memcmp(recorded, expected, sizeof(expected))) {
+		printf("Expected a %zu byte recording, got %zu bytes!\n", sizeof(expected), length);
+		rc++;
+	}
+	fclose(stream);
+
+	// A span that skips past the last cell, here by wrapping the cell count around, is rejected rather than drawn past the frame
+	const uint8_t corrupt[] = {
+		'v', '6', 't', 'r', textMode_recordingVersion, textMode_columns, textMode_rows,
+		0, 1,
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01, 1, 1, 'X', 0,
+	};
+	stream = tmpfile();
+	fwrite(corrupt, 1, sizeof(corrupt), stream);
+	rewind(stream);
+	if (textMode_play(stream, 0)) {
+		printf("A span past the end of the frame should have been rejected!\n");
+		rc++;
+	}
+
+	fclose(stream);
+	textMode_destroy(vid);
+	v6502_destroyMemory(cpu->memory);
+	v6502_destroyCPU(cpu);
+	return rc;
+}
+
+static int test_cycleCounting() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure each instruction stepped adds its base cycles...\n");
+
+	// lda #$01, sta $0200, inx, brk
+	const uint8_t program[] = { 0xA9, 0x01, 0x8D, 0x00, 0x02, 0xE8, 0x00 };
+
+	v6502_cpu *cpu = v6502_createCPU();
+	cpu->memory = v6502_createMemory(0x10000);
+	v6502_loadBytesIntoMemory(cpu->memory, program, sizeof(program), 0x0600);
+	v6502_write(cpu->memory, v6502_memoryVectorResetLow, 0x00);
+	v6502_write(cpu->memory, v6502_memoryVectorResetHigh, 0x06);
+
+	v6502_reset(cpu);
+	unsigned long executed = v6502_run(cpu, 100);
+	if (executed != 4 || cpu->cycles != 2 + 4 + 2 + 7) {
+		printf("Expected 4 instructions in 15 cycles, got %lu in %llu!\n", executed, (unsigned long long)cpu->cycles);
+		rc++;
+	}
+
+	v6502_destroyMemory(cpu->memory);
+	v6502_destroyCPU(cpu);
+	return rc;
+}
+
+static void countEvent(v6502_cpu *cpu, void *context) {
+	(*(int *)context)++;
+}
+
+static int test_scheduledInterrupts() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure events run at their deadlines, and IRQs wait for cli and return with rti...\n");
+
+	// Main: sei, cli, nop (loop here), jmp; Handler: inx, sta $0200 (acknowledge), rti
+	const uint8_t program[] = { 0x78, 0x58, 0xEA, 0x4C, 0x02, 0x06 };
+	const uint8_t handler[] = { 0xE8, 0x8D, 0x00, 0x02, 0x40 };
+
+	v6502_cpu *cpu = v6502_createCPU();
+	cpu->memory = v6502_createMemory(0x10000);
+	v6502_loadBytesIntoMemory(cpu->memory, program, sizeof(program), 0x0600);
+	v6502_loadBytesIntoMemory(cpu->memory, handler, sizeof(handler), 0x0700);
+	v6502_write(cpu->memory, v6502_memoryVectorResetLow, 0x00);
+	v6502_write(cpu->memory, v6502_memoryVectorResetHigh, 0x06);
+	v6502_write(cpu->memory, v6502_memoryVectorInterruptLow, 0x00);
+	v6502_write(cpu->memory, v6502_memoryVectorInterruptHigh, 0x07);
+	v6502_reset(cpu);
+
+	int kept = 0;
+	int cancelled = 0;
+	v6502_schedule(cpu, 100, countEvent, &cancelled);
+	v6502_schedule(cpu, 200, countEvent, &kept);
+	v6502_schedule(cpu, 10, countEvent, &kept);
+	v6502_cancelEvents(cpu, countEvent, &cancelled);
+
+	// Raised while interrupts are disabled, so it must wait for cli
+	v6502_step(cpu);
+	v6502_raiseIRQ(cpu, 1);
+	v6502_step(cpu);
+	if (cpu->pc != 0x0700 || cpu->sp != BYTE_MAX - 3 || !(cpu->sr & v6502_cpu_status_interrupt)) {
+		printf("IRQ wasn't taken after cli, pc is %#x!\n", cpu->pc);
+		rc++;
+	}
+
+	v6502_step(cpu);
+	v6502_clearIRQ(cpu, 1);
+	v6502_step(cpu);
+	v6502_step(cpu);
+	if (cpu->x != 1 || cpu->pc != 0x0602 || cpu->sp != BYTE_MAX || (cpu->sr & v6502_cpu_status_interrupt)) {
+		printf("rti didn't return to the interrupted instruction, pc is %#x!\n", cpu->pc);
+		rc++;
+	}
+
+	v6502_run(cpu, 100);
+	if (kept != 2 || cancelled || cpu->eventCount) {
+		printf("Expected 2 events and none cancelled, got %d and %d!\n", kept, cancelled);
+		rc++;
+	}
+
+	v6502_destroyMemory(cpu->memory);
+	v6502_destroyCPU(cpu);
+	return rc;
+}
+
+static int test_keyboardInterrupt() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure keys written to a file descriptor raise an IRQ, and can be read from the data register...\n");
+
+	// Main: lda #$01, sta $2800 (enable interrupts), cli, jmp *; Handler: lda $2801, sta $0200, brk
+	const uint8_t program[] = { 0xA9, 0x01, 0x8D, 0x00, 0x28, 0x58, 0x4C, 0x06, 0x06 };
+	const uint8_t handler[] = { 0xAD, 0x01, 0x28, 0x8D, 0x00, 0x02, 0x00 };
+
+	int fds[2];
+	if (pipe(fds)) {
+		printf("Couldn't create a pipe!\n");
+		return 1;
+	}
+
+	v6502_cpu *cpu = v6502_createCPU();
+	cpu->memory = v6502_createMemory(0x10000);
+	v6502_loadBytesIntoMemory(cpu->memory, program, sizeof(program), 0x0600);
+	v6502_loadBytesIntoMemory(cpu->memory, handler, sizeof(handler), 0x0700);
+	v6502_write(cpu->memory, v6502_memoryVectorResetLow, 0x00);
+	v6502_write(cpu->memory, v6502_memoryVectorResetHigh, 0x06);
+	v6502_write(cpu->memory, v6502_memoryVectorInterruptLow, 0x00);
+	v6502_write(cpu->memory, v6502_memoryVectorInterruptHigh, 0x07);
+	v6502_reset(cpu);
+
+	v6502_keyboard *kbd = keyboard_create(cpu, fds[0]);
+	keyboard_listen(kbd);
+	if (write(fds[1], "k", 1) != 1) {
+		rc++;
+	}
+
+	// The input thread takes a moment to notice the key
+	for (int i = 0; i < 1000 && !(cpu->sr & v6502_cpu_status_break); i++) {
+		v6502_run(cpu, 10000);
+		if (!(cpu->sr & v6502_cpu_status_break)) {
+			usleep(1000);
+		}
+	}
+
+	if (v6502_read(cpu->memory, 0x0200, NO) != 'k' || (v6502_read(cpu->memory, keyboard_statusRegister, NO) & keyboard_status_ready) || cpu->irqLines) {
+		printf("Key wasn't delivered through the IRQ handler!\n");
+		rc++;
+	}
+
+	keyboard_destroy(kbd);
+	close(fds[0]);
+	close(fds[1]);
+	v6502_destroyMemory(cpu->memory);
+	v6502_destroyCPU(cpu);
+	return rc;
+}
+
+static int test_intervalTimer() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure a periodic timer interrupts on time, and a one-shot timer counts down and stops...\n");
+
+	// Main: cli, jmp *; Handler: inc $0200, lda $2810 (acknowledge), rti
+	const uint8_t program[] = { 0x58, 0x4C, 0x01, 0x06 };
+	const uint8_t handler[] = { 0xEE, 0x00, 0x02, 0xAD, 0x10, 0x28, 0x40 };
+
+	v6502_cpu *cpu = v6502_createCPU();
+	cpu->memory = v6502_createMemory(0x10000);
+	v6502_loadBytesIntoMemory(cpu->memory, program, sizeof(program), 0x0600);
+	v6502_loadBytesIntoMemory(cpu->memory, handler, sizeof(handler), 0x0700);
+	v6502_write(cpu->memory, v6502_memoryVectorResetLow, 0x00);
+	v6502_write(cpu->memory, v6502_memoryVectorResetHigh, 0x06);
+	v6502_write(cpu->memory, v6502_memoryVectorInterruptLow, 0x00);
+	v6502_write(cpu->memory, v6502_memoryVectorInterruptHigh, 0x07);
+	v6502_reset(cpu);
+
+	v6502_intervalTimer *timer = intervalTimer_create(cpu);
+
+	// 25 counts of 4 cycles each, so an interrupt every 100 cycles
+	v6502_write(cpu->memory, intervalTimer_reloadLowRegister, 24);
+	v6502_write(cpu->memory, intervalTimer_reloadHighRegister, 0);
+	v6502_write(cpu->memory, intervalTimer_prescalerRegister, 3);
+	v6502_write(cpu->memory, intervalTimer_controlRegister, intervalTimer_control_enable | intervalTimer_control_periodic | intervalTimer_control_irq);
+
+	uint64_t start = cpu->cycles;
+	while (cpu->cycles - start < 1050) {
+		v6502_step(cpu);
+	}
+
+	if (v6502_read(cpu->memory, 0x0200, NO) != 10) {
+		printf("Expected 10 interrupts in 1050 cycles, got %d!\n", v6502_read(cpu->memory, 0x0200, NO));
+		rc++;
+	}
+
+	// A one-shot timer with no interrupt just counts
+	v6502_write(cpu->memory, intervalTimer_reloadLowRegister, 0x00);
+	v6502_write(cpu->memory, intervalTimer_reloadHighRegister, 0x10);
+	v6502_write(cpu->memory, intervalTimer_prescalerRegister, 0);
+	v6502_write(cpu->memory, intervalTimer_controlRegister, intervalTimer_control_enable);
+
+	start = cpu->cycles;
+	while (cpu->cycles - start < 0x100) {
+		v6502_step(cpu);
+	}
+
+	uint16_t expected = 0x1000 - (uint16_t)(cpu->cycles - start);
+	uint16_t count = v6502_read(cpu->memory, intervalTimer_countLowRegister, YES) | (v6502_read(cpu->memory, intervalTimer_countHighRegister, YES) << 8);
+	if (count != expected) {
+		printf("Expected a count of %#x, got %#x!\n", expected, count);
+		rc++;
+	}
+
+	while (cpu->cycles - start < 0x1100) {
+		v6502_step(cpu);
+	}
+
+	uint8_t control = v6502_read(cpu->memory, intervalTimer_controlRegister, YES);
+	if (control != intervalTimer_control_expired || intervalTimer_count(timer) || cpu->eventCount) {
+		printf("One-shot timer should have expired and stopped, control is %#x!\n", control);
+		rc++;
+	}
+
+	intervalTimer_destroy(timer);
+	v6502_destroyMemory(cpu->memory);
+	v6502_destroyCPU(cpu);
+	return rc;
+}
+
+static int test_blockDeviceTransfers() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure a block device moves whole blocks between an image and memory, and refuses to run off the image...\n");
+
+	char path[] = "/tmp/v6502-block-XXXXXX";
+	int fd = mkstemp(path);
+	if (fd < 0) {
+		printf("Couldn't create an image!\n");
+		return 1;
+	}
+
+	// Four blocks, each filled with its own number, plus a partial block that should be ignored
+	uint8_t block[256];
+	for (int i = 0; i < 4; i++) {
+		memset(block, i + 1, sizeof(block));
+		if (write(fd, block, sizeof(block)) != sizeof(block)) {
+			rc++;
+		}
+	}
+	if (write(fd, block, 100) != 100) {
+		rc++;
+	}
+
+	v6502_memory *mem = v6502_createMemory(0x10000);
+	v6502_blockDevice *dev = blockDevice_create(mem, path, 256);
+	if (!dev || dev->size != 1024) {
+		printf("Image should have been attached with 4 blocks!\n");
+		blockDevice_destroy(dev);
+		v6502_destroyMemory(mem);
+		close(fd);
+		unlink(path);
+		return rc + 1;
+	}
+
+	// Read blocks 1 and 2 to $4080, which straddles pages
+	v6502_write(mem, blockDevice_sectorLowRegister, 1);
+	v6502_write(mem, blockDevice_sectorHighRegister, 0);
+	v6502_write(mem, blockDevice_addressLowRegister, 0x80);
+	v6502_write(mem, blockDevice_addressHighRegister, 0x40);
+	v6502_write(mem, blockDevice_countRegister, 2);
+	v6502_write(mem, blockDevice_commandRegister, blockDevice_command_read);
+
+	if (v6502_read(mem, 0x407F, NO) != 0 || v6502_read(mem, 0x4080, NO) != 2 || v6502_read(mem, 0x417F, NO) != 2 || v6502_read(mem, 0x4180, NO) != 3 || v6502_read(mem, 0x427F, NO) != 3 || v6502_read(mem, 0x4280, NO) != 0) {
+		printf("Blocks weren't read into the right place!\n");
+		rc++;
+	}
+	if (dev->sector != 3 || dev->address != 0x4280 || (v6502_read(mem, blockDevice_commandRegister, NO) & blockDevice_status_error)) {
+		printf("Registers should point past the transfer, without an error!\n");
+		rc++;
+	}
+
+	// Write one block back from $4100 to the last sector, then check the file itself
+	v6502_write(mem, 0x4100, 0xAA);
+	v6502_write(mem, blockDevice_addressLowRegister, 0x00);
+	v6502_write(mem, blockDevice_addressHighRegister, 0x41);
+	v6502_write(mem, blockDevice_countRegister, 1);
+	v6502_write(mem, blockDevice_commandRegister, blockDevice_command_write);
+	v6502_write(mem, blockDevice_commandRegister, blockDevice_command_sync);
+
+	uint8_t written[2];
+	if (pread(fd, written, 2, 3 * 256) != 2 || written[0] != 0xAA || written[1] != 2) {
+		printf("Block wasn't written to the image!\n");
+		rc++;
+	}
+
+	// The sector register now points past the end
+	v6502_write(mem, blockDevice_commandRegister, blockDevice_command_read);
+	if (!(v6502_read(mem, blockDevice_commandRegister, NO) & blockDevice_status_error) || v6502_read(mem, 0x4200, NO) != 3) {
+		printf("Reading past the end of the image should fail, and move nothing!\n");
+		rc++;
+	}
+
+	// Two blocks to $FF80 only has room for half of the first one
+	v6502_write(mem, blockDevice_sectorLowRegister, 0);
+	v6502_write(mem, blockDevice_addressLowRegister, 0x80);
+	v6502_write(mem, blockDevice_addressHighRegister, 0xFF);
+	v6502_write(mem, blockDevice_countRegister, 2);
+	v6502_write(mem, blockDevice_commandRegister, blockDevice_command_read);
+	if (!(v6502_read(mem, blockDevice_commandRegister, NO) & blockDevice_status_error) || dev->sector != 0 || v6502_read(mem, 0xFFFF, NO) != 1) {
+		printf("A transfer cut short by the top of memory should fail, at the block it stopped in!\n");
+		rc++;
+	}
+
+	blockDevice_destroy(dev);
+	v6502_destroyMemory(mem);
+	close(fd);
+	unlink(path);
+	return rc;
+}
+
+static int test_uartEcho() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure a serial port receives a whole stream, and sends it back a line at a time...\n");
+
+	// lda $2830, bmi read, and #$20, beq (start), brk; read: lda $2831, sta $2832, jmp (start)
+	const uint8_t program[] = { 0xAD, 0x30, 0x28, 0x30, 0x05, 0x29, 0x20, 0xF0, 0xF7, 0x00, 0xAD, 0x31, 0x28, 0x8D, 0x32, 0x28, 0x4C, 0x00, 0x06 };
+	const char *input = "hello\nworld";
+
+	int in[2], out[2];
+	if (pipe(in) || pipe(out)) {
+		printf("Couldn't create pipes!\n");
+		return 1;
+	}
+	fcntl(out[0], F_SETFL, O_NONBLOCK);
+	if (write(in[1], input, strlen(input)) != strlen(input)) {
+		rc++;
+	}
+	close(in[1]);
+
+	v6502_cpu *cpu = v6502_createCPU();
+	cpu->memory = v6502_createMemory(0x10000);
+	v6502_loadBytesIntoMemory(cpu->memory, program, sizeof(program), 0x0600);
+	v6502_write(cpu->memory, v6502_memoryVectorResetLow, 0x00);
+	v6502_write(cpu->memory, v6502_memoryVectorResetHigh, 0x06);
+	v6502_reset(cpu);
+
+	v6502_uart *uart = uart_create(cpu, in[0], out[1]);
+	uart_listen(uart);
+
+	// The input thread takes a moment to read the stream
+	for (int i = 0; i < 1000 && !(cpu->sr & v6502_cpu_status_break); i++) {
+		v6502_run(cpu, 10000);
+		if (!(cpu->sr & v6502_cpu_status_break)) {
+			usleep(1000);
+		}
+	}
+
+	// Only the finished line has been written so far
+	char output[32] = { 0 };
+	ssize_t length = read(out[0], output, sizeof(output) - 1);
+	if (length != 6 || strcmp(output, "hello\n")) {
+		printf("Expected only the first line to have been sent, got \"%s\"!\n", length > 0 ? output : "");
+		rc++;
+	}
+
+	uart_destroy(uart);
+	memset(output, 0, sizeof(output));
+	length = read(out[0], output, sizeof(output) - 1);
+	if (length != 5 || strcmp(output, "world")) {
+		printf("Expected the rest to be sent on destroy, got \"%s\"!\n", length > 0 ? output : "");
+		rc++;
+	}
+
+	close(in[0]);
+	close(out[0]);
+	close(out[1]);
+	v6502_destroyMemory(cpu->memory);
+	v6502_destroyCPU(cpu);
+	return rc;
+}
+
+/** A device with one register, which counts the writes to it, for test_devicePlugins */
+typedef struct {
+	v6502_cpu *cpu;
+	const v6502_deviceHost *host;
+	uint8_t count;
+} testDevice;
+
+static int testDevicesDestroyed;
+
+static uint8_t testDevice_read(v6502_memory *memory, uint16_t offset, int trap, void *context) {
+	return ((testDevice *)context)->count;
+}
+
+static void testDevice_write(v6502_memory *memory, uint16_t offset, uint8_t value, void *context) {
+	((testDevice *)context)->count++;
+}
+
+static void *testDevice_create(v6502_cpu *cpu, const v6502_deviceHost *host, const char *args) {
+	testDevice *dev = calloc(1, sizeof(testDevice));
+	dev->cpu = cpu;
+	dev->host = host;
+	return dev;
+}
+
+static int testDevice_map(void *device) {
+	testDevice *dev = device;
+	return dev->host->map(dev->cpu->memory, 0x4000, 1, testDevice_read, testDevice_write, dev);
+}
+
+/** Maps a second register before failing on the first, which is taken, leaving the device stranded */
+static testDevice *testDeviceStranded;
+
+static int testDevice_mapPartly(void *device) {
+	testDevice *dev = device;
+	testDeviceStranded = dev;
+	return dev->host->map(dev->cpu->memory, 0x4001, 1, testDevice_read, testDevice_write, dev) && testDevice_map(device);
+}
+
+static void testDevice_reset(void *device) {
+	((testDevice *)device)->count = 0;
+}
+
+static void testDevice_destroy(void *device) {
+	testDevicesDestroyed++;
+	free(device);
+}
+
+static int test_devicePlugins() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure devices are attached through their hooks, reset with the CPU, and destroyed when detached, but not while still mapped...\n");
+
+	const v6502_deviceDescriptor descriptor = {
+		.abiVersion = v6502_deviceABIVersion,
+		.name = "counter",
+		.create = testDevice_create,
+		.map = testDevice_map,
+		.reset = testDevice_reset,
+		.destroy = testDevice_destroy,
+	};
+	v6502_deviceDescriptor future = descriptor;
+	future.abiVersion = v6502_deviceABIVersion + 1;
+
+	testDevicesDestroyed = 0;
+	v6502_cpu *cpu = v6502_createCPU();
+	cpu->memory = v6502_createMemory(0x10000);
+
+	if (v6502_attachDevice(cpu, &future, NULL) || v6502_loadDevice(cpu, "/nonexistent/device.so", NULL)) {
+		printf("Devices that can't work shouldn't be attached!\n");
+		rc++;
+	}
+
+	v6502_device *device = v6502_attachDevice(cpu, &descriptor, NULL);
+	if (!device) {
+		printf("Couldn't attach device!\n");
+		v6502_destroyMemory(cpu->memory);
+		v6502_destroyCPU(cpu);
+		return rc + 1;
+	}
+
+	v6502_write(cpu->memory, 0x4000, 0xFF);
+	v6502_write(cpu->memory, 0x4000, 0xFF);
+	if (v6502_read(cpu->memory, 0x4000, NO) != 2) {
+		printf("Device register should have counted 2 writes!\n");
+		rc++;
+	}
+
+	// A second device can't take the same register
+	if (v6502_attachDevice(cpu, &descriptor, NULL) || testDevicesDestroyed != 1) {
+		printf("Device that couldn't be mapped should have been destroyed!\n");
+		rc++;
+	}
+
+	// One that fails after mapping something has to stay alive, since that range still calls it
+	v6502_deviceDescriptor partial = descriptor;
+	partial.map = testDevice_mapPartly;
+	if (v6502_attachDevice(cpu, &partial, NULL) || testDevicesDestroyed != 1) {
+		printf("Device that mapped some ranges before failing shouldn't have been destroyed!\n");
+		rc++;
+	}
+	v6502_write(cpu->memory, 0x4001, 0xFF);
+	if (!testDeviceStranded || v6502_read(cpu->memory, 0x4001, NO) != 1) {
+		printf("Range mapped by a device that failed should still reach it!\n");
+		rc++;
+	}
+
+	v6502_resetDevices(cpu);
+	if (v6502_read(cpu->memory, 0x4000, NO) != 0) {
+		printf("Device wasn't reset!\n");
+		rc++;
+	}
+
+	v6502_detachDevices(cpu);
+	if (testDevicesDestroyed != 2) {
+		printf("Device wasn't destroyed!\n");
+		rc++;
+	}
+
+	v6502_destroyMemory(cpu->memory);
+	v6502_destroyCPU(cpu);
+	free(testDeviceStranded);
+	return rc;
+}
+
+static int test_devicePluginHistory() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure a device plugin with snapshot hooks is loaded, and rewound along with memory...\n");
+
+	v6502_cpu *cpu = v6502_createCPU();
+	cpu->memory = v6502_createMemory(0x10000);
+
+	// Built by tests/Makefile, which runs the tests from this directory
+	v6502_device *device = v6502_loadDevice(cpu, "./counter_device.so", "4000");
+	if (!device) {
+		v6502_destroyMemory(cpu->memory);
+		v6502_destroyCPU(cpu);
+		return 1;
+	}
+
+	v6502_deviceSnapshot *devices = v6502_snapshotDevices(cpu);
+	v6502_write(cpu->memory, 0x4000, 0xFF);
+	v6502_write(cpu->memory, 0x4000, 0xFF);
+	if (!devices || devices->count != 1 || !v6502_restoreDevices(cpu, devices) || v6502_read(cpu->memory, 0x4000, NO) != 0) {
+		printf("Device should have been restored to 0 writes, got %d!\n", v6502_read(cpu->memory, 0x4000, NO));
+		rc++;
+	}
+	v6502_destroyDeviceSnapshot(devices);
+
+	// sta $4000; lda $4000; sta $4000; brk
+	const uint8_t program[] = {
+		0x8D, 0x00, 0x40,
+		0xAD, 0x00, 0x40,
+		0x8D, 0x00, 0x40,
+		0x00,
+	};
+	v6502_loadBytesIntoMemory(cpu->memory, program, sizeof(program), 0x0600);
+	cpu->pc = 0x0600;
+
+	v6502_history *history = v6502_createHistory(cpu, history_defaultInterval);
+	for (int i = 0; i < 3; i++) {
+		v6502_step(cpu);
+		v6502_recordHistory(history, 1);
+	}
+
+	// The device goes back to the snapshot, then sees the first write again, but not the second
+	v6502_reverseStep(history);
+	if (v6502_read(cpu->memory, 0x4000, NO) != 1 || cpu->ac != 1) {
+		printf("Expected the device to have counted 1 write, and to have loaded 1, got %d and %d!\n", v6502_read(cpu->memory, 0x4000, NO), cpu->ac);
+		rc++;
+	}
+
+	v6502_reverseStep(history);
+	v6502_reverseStep(history);
+	if (v6502_read(cpu->memory, 0x4000, NO) != 0) {
+		printf("Expected the device to have counted no writes, got %d!\n", v6502_read(cpu->memory, 0x4000, NO));
+		rc++;
+	}
+
+	v6502_destroyHistory(history);
+	v6502_detachDevices(cpu);
+	v6502_destroyMemory(cpu->memory);
+	v6502_destroyCPU(cpu);
+	return rc;
+}
+
+static int test_patternTables() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure CHR tiles decode the same with and without SIMD, and a nametable renders with its attributes...\n");
+
+	uint8_t chr[4 * ppu_bytesPerTile];
+	for (size_t i = 0; i < sizeof(chr); i++) {
+		chr[i] = (uint8_t)((i * 0x9E37) >> 3);
+	}
+
+	uint8_t scalar[4 * ppu_pixelsPerTile], vector[4 * ppu_pixelsPerTile];
+	ppu_decodeTilesScalar(chr, 4, scalar);
+	ppu_decodeTiles(chr, 4, vector);
+	if (memcmp(scalar, vector, sizeof(scalar))) {
+		printf("Decoded tiles differ!\n");
+		rc++;
+	}
+
+	// Tile 1 is a diagonal line in color 3, over color 1
+	memset(chr + ppu_bytesPerTile, 0, ppu_bytesPerTile);
+	for (int y = 0; y < 8; y++) {
+		chr[ppu_bytesPerTile + y] = 0xFF;
+		chr[ppu_bytesPerTile + 8 + y] = 0x80 >> y;
+	}
+
+	v6502_memory *mem = v6502_createMemory(0x10000);
+	v6502_ppu *ppu = ppu_create(mem, 0x2000, chr, sizeof(chr));
+
+	// Tile 1 at the top left, and in the next quadrant to the right, with the first attribute byte giving them palettes 2 and 1
+	v6502_write(mem, 0x2000, 1);
+	v6502_write(mem, 0x2002, 1);
+	v6502_write(mem, 0x2000 + ppu_attributeOffset, (1 << 2) | 2);
+	ppu_renderBackground(ppu);
+
+	if (ppu->framebuffer[0][0] != ((2 << 2) | 3) || ppu->framebuffer[0][1] != ((2 << 2) | 1) || ppu->framebuffer[7][7] != ((2 << 2) | 3) || ppu->framebuffer[7][6] != ((2 << 2) | 1)) {
+		printf("Tile wasn't drawn with palette 2!\n");
+		rc++;
+	}
+	if (ppu->framebuffer[0][16] != ((1 << 2) | 3) || ppu->framebuffer[0][17] != ((1 << 2) | 1) || ppu->framebuffer[7][23] != ((1 << 2) | 3)) {
+		printf("Tile in the next quadrant wasn't drawn with palette 1!\n");
+		rc++;
+	}
+
+	// The image shows each palette index in its color
+	FILE *image = tmpfile();
+	int width = 0, height = 0, depth = 0;
+	static uint8_t rgb[ppu_height][ppu_width][3];
+	if (!image || !ppu_writeImage(ppu, image) || fseek(image, 0, SEEK_SET) || fscanf(image, "P6 %d %d %d", &width, &height, &depth) != 3 || fgetc(image) != '\n' || fread(rgb, 1, sizeof(rgb), image) != sizeof(rgb)) {
+		printf("Couldn't write and read back the image!\n");
+		rc++;
+	}
+	else {
+		const uint8_t green[3] = {0xB8, 0xF8, 0x18}, darkRed[3] = {0xA4, 0x00, 0x00}, orange[3] = {0xFC, 0xA0, 0x44};
+		if (width != ppu_width || height != ppu_height || depth != 255 || memcmp(rgb[0][0], green, 3) || memcmp(rgb[0][17], darkRed, 3) || memcmp(rgb[7][23], orange, 3)) {
+			printf("Image colors don't match the default palette!\n");
+			rc++;
+		}
+	}
+	if (image) {
+		fclose(image);
+	}
+
+	uint32_t hash = ppu_hashFrame(ppu);
+	ppu_renderBackground(ppu);
+	if (ppu_hashFrame(ppu) != hash) {
+		printf("Rendering the same nametable should give the same frame!\n");
+		rc++;
+	}
+
+	ppu_destroy(ppu);
+	v6502_destroyMemory(mem);
+	return rc;
+}
+
+static int test_breakpointBitmap() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure breakpoints can be added and removed in any order, and count hits and ignores...\n");
+
+	v6502_breakpoint_list *list = v6502_createBreakpointList();
+
+	// Several to a page, so removing one can't clear the page
+	for (uint32_t address = 0x0100; address < 0x10000; address += 0x0FF1) {
+		v6502_addBreakpointToList(list, address);
+		v6502_addBreakpointToList(list, address + 1);
+	}
+	v6502_addBreakpointToList(list, 0x0100);
+	size_t added = list->count;
+
+	for (uint32_t address = 0x0100; address < 0x10000; address += 0x0FF1) {
+		v6502_removeBreakpointFromList(list, address);
+	}
+
+	for (uint32_t address = 0; address < 0x10000; address++) {
+		int expected = NO;
+		for (size_t i = 0; i < list->count; i++) {
+			expected |= list->breakpoints[i].address == address;
+		}
+		if (v6502_breakpointIsInList(list, address) != expected) {
+			printf("Breakpoint at %#06x should%s be set!\n", address, expected ? "" : "n't");
+			rc++;
+		}
+	}
+	if (added != 32 || list->count != 16) {
+		printf("Expected 32 breakpoints, then 16, got %zu then %zu!\n", added, list->count);
+		rc++;
+	}
+
+	// Breakpoints without conditions only look at the program counter
+	v6502_cpu cpu = { .pc = 0x0101 };
+	v6502_breakpointAtAddress(list, 0x0101)->ignoreCount = 2;
+	int stops = 0;
+	for (int i = 0; i < 5; i++) {
+		stops += v6502_hitBreakpoint(list, &cpu);
+	}
+	cpu.pc = 0x0100;
+	if (stops != 3 || v6502_breakpointAtAddress(list, 0x0101)->hits != 5 || v6502_hitBreakpoint(list, &cpu)) {
+		printf("Expected 3 stops in 5 hits, with 2 ignored!\n");
+		rc++;
+	}
+
+	v6502_destroyBreakpointList(list);
+	return rc;
+}
+
+static int test_breakpointConditions() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure breakpoint conditions compile once, and evaluate registers, memory and symbols...\n");
+
+	v6502_cpu *cpu = v6502_createCPU();
+	cpu->memory = v6502_createMemory(0x10000);
+	as6502_symbol_table *table = as6502_createSymbolTable();
+	as6502_addSymbolToTable(table, 0, "counter", 0x0200, as6502_symbol_type_variable);
+
+	cpu->ac = 0x10;
+	cpu->x = 3;
+	v6502_write(cpu->memory, 0x0200, 4);
+
+	const struct { const char *source; int expected; } cases[] = {
+		{ "a == $10 && mem[$0200] > 3", YES },
+		{ "a == $10 && mem[counter] > 4", NO },
+		{ "mem[counter]==x+1", YES },
+		{ "x < 3 || !(a & %10000)", NO },
+		{ "(x | 4) == 7 && -x == 0 - 3 && ~a == -17", YES },
+		{ "mem[counter + 1] != 0 || x >= 0x3", YES },
+		{ "$7fffffff + 1 == -$7fffffff - 1 && -($7fffffff + 1) < 0", YES },
+	};
+
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		const char *error = NULL;
+		v6502_condition *condition = v6502_compileCondition(cases[i].source, table, &error);
+		if (!condition) {
+			printf("Couldn't compile \"%s\": %s!\n", cases[i].source, error);
+			rc++;
+			continue;
+		}
+		if (v6502_evaluateCondition(condition, cpu) != cases[i].expected) {
+			printf("\"%s\" should be %s!\n", cases[i].source, cases[i].expected ? "true" : "false");
+			rc++;
+		}
+		v6502_destroyCondition(condition);
+	}
+
+	const char *invalid[] = { "", "a ==", "mem[1", "nosuchsymbol > 1", "a == 1 1" };
+	for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+		const char *error = NULL;
+		v6502_condition *condition = v6502_compileCondition(invalid[i], table, &error);
+		if (condition || !error) {
+			printf("\"%s\" shouldn't have compiled!\n", invalid[i]);
+			v6502_destroyCondition(condition);
+			rc++;
+		}
+	}
+
+	// A false condition neither stops nor counts as a hit
+	v6502_breakpoint_list *list = v6502_createBreakpointList();
+	v6502_addBreakpointToList(list, 0x0600);
+	v6502_setBreakpointCondition(list, 0x0600, v6502_compileCondition("x == 5", table, NULL));
+	cpu->pc = 0x0600;
+	int stoppedEarly = v6502_hitBreakpoint(list, cpu);
+	cpu->x = 5;
+	if (stoppedEarly || !v6502_hitBreakpoint(list, cpu) || list->breakpoints[0].hits != 1) {
+		printf("Conditional breakpoint should only stop, and count, when its condition is true!\n");
+		rc++;
+	}
+
+	v6502_destroyBreakpointList(list);
+	as6502_destroySymbolTable(table);
+	v6502_destroyMemory(cpu->memory);
+	v6502_destroyCPU(cpu);
+	return rc;
+}
+
+/** Frames a GDB remote protocol packet onto the end of out */
+static void appendGDBPacket(char *out, const char *payload) {
+	unsigned checksum = 0;
+	for (const char *c = payload; *c; c++) {
+		checksum += (unsigned char)*c;
+	}
+	sprintf(out + strlen(out), "$%s#%02x", payload, checksum & 0xFF);
+}
+
+static int test_gdbStub() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure the GDB stub stops at watchpoints and breakpoints, and reads and writes memory, refusing bad hex...\n");
+
+	v6502_cpu *cpu = v6502_createCPU();
+	cpu->memory = v6502_createMemory(0x10000);
+	v6502_breakpoint_list *list = v6502_createBreakpointList();
+	v6502_gdbStub *stub = gdbStub_create(cpu, list);
+
+	// inx; stx $0300; jmp $0600
+	const uint8_t program[] = { 0xE8, 0x8E, 0x00, 0x03, 0x4C, 0x00, 0x06 };
+	v6502_loadBytesIntoMemory(cpu->memory, program, sizeof(program), 0x0600);
+	cpu->pc = 0x0600;
+
+	const struct { const char *request; const char *reply; } exchanges[] = {
+		{ "?", "S05" },
+		{ "Z2,300,1", "OK" },
+		{ "c", "T05watch:0300;" },
+		{ "z2,300,1", "OK" },
+		{ "Z0,604,1", "OK" },
+		{ "c", "S05" },
+		{ "p5", "0406" },
+		{ "m300,2", "0200" },
+		{ "M301,1:aa", "OK" },
+		{ "m301,1", "aa" },
+		{ "M301,2:bbzz", "E01" },
+		{ "m301,1", "aa" },
+		{ "Z3,300,1", "" },
+		{ "D", "OK" },
+	};
+
+	char requests[512] = "";
+	char expected[512] = "";
+	for (size_t i = 0; i < sizeof(exchanges) / sizeof(exchanges[0]); i++) {
+		appendGDBPacket(requests, exchanges[i].request);
+		strcat(expected, "+");
+		appendGDBPacket(expected, exchanges[i].reply);
+	}
+
+	// The whole session is small enough to sit in the socket buffers either way
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+		printf("Couldn't create a socket pair!\n");
+		rc++;
+	}
+	else {
+		write(fds[0], requests, strlen(requests));
+		int killed = gdbStub_serve(stub, fds[1]);
+		close(fds[1]);
+
+		char replies[512] = "";
+		ssize_t length;
+		size_t total = 0;
+		while ((length = read(fds[0], replies + total, sizeof(replies) - 1 - total)) > 0) {
+			total += length;
+		}
+		replies[total] = '\0';
+		close(fds[0]);
+
+		if (killed || strcmp(replies, expected)) {
+			printf("Expected \"%s\", got \"%s\"!\n", expected, replies);
+			rc++;
+		}
+	}
+
+	if (list->count != 1 || cpu->x != 2) {
+		printf("Expected one breakpoint left, and x to be 2!\n");
+		rc++;
+	}
+
+	gdbStub_destroy(stub);
+	v6502_destroyBreakpointList(list);
+	v6502_destroyMemory(cpu->memory);
+	v6502_destroyCPU(cpu);
+	return rc;
+}
+
+/** A device that reads as a different value every time, so replaying it again would give the wrong answer */
+static uint8_t readCounter(v6502_memory *memory, uint16_t offset, int trap, void *context) {
+	return (*(uint8_t *)context) += 7;
+}
+
+static int test_reverseExecution() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure going back replays device reads from the log, and restores memory and registers...\n");
+
+	v6502_cpu *cpu = v6502_createCPU();
+	cpu->memory = v6502_createMemory(0x10000);
+	uint8_t counter = 0;
+	v6502_map(cpu->memory, 0x4000, 1, readCounter, NULL, &counter);
+
+	// lda $4000; sta $0300,x; inx; jmp $0600
+	const uint8_t program[] = { 0xAD, 0x00, 0x40, 0x9D, 0x00, 0x03, 0xE8, 0x4C, 0x00, 0x06 };
+	v6502_loadBytesIntoMemory(cpu->memory, program, sizeof(program), 0x0600);
+	cpu->pc = 0x0600;
+
+	v6502_history *history = v6502_createHistory(cpu, 5);
+
+	uint8_t page[v6502_memoryPageSize];
+	v6502_cpu saved;
+	for (int i = 0; i < 40; i++) {
+		if (i == 22) {
+			saved = *cpu;
+			v6502_readBackingBytes(cpu->memory, 0x0300, page, sizeof(page));
+		}
+		v6502_step(cpu);
+		v6502_recordHistory(history, 1);
+	}
+	uint8_t counted = counter;
+
+	for (int i = 0; i < 18; i++) {
+		if (!v6502_reverseStep(history)) {
+			printf("Couldn't step back from instruction %llu!\n", (unsigned long long)history->instruction);
+			rc++;
+			break;
+		}
+	}
+
+	uint8_t restored[v6502_memoryPageSize];
+	v6502_readBackingBytes(cpu->memory, 0x0300, restored, sizeof(restored));
+	if (cpu->pc != saved.pc || cpu->ac != saved.ac || cpu->x != saved.x || cpu->cycles != saved.cycles || memcmp(page, restored, sizeof(page))) {
+		printf("Expected pc %#06x, a %#04x, x %#04x, got pc %#06x, a %#04x, x %#04x!\n", saved.pc, saved.ac, saved.x, cpu->pc, cpu->ac, cpu->x);
+		rc++;
+	}
+	if (counter != counted) {
+		printf("The device was read %d more times while replaying!\n", (uint8_t)(counter - counted) / 7);
+		rc++;
+	}
+
+	// The last time at the breakpoint before instruction 22 was two instructions before it
+	v6502_breakpoint_list *list = v6502_createBreakpointList();
+	v6502_addBreakpointToList(list, 0x0606);
+	if (!v6502_reverseContinue(history, list) || cpu->pc != 0x0606 || history->instruction != 18) {
+		printf("Expected to go back to the breakpoint at instruction 18, got %#06x at %llu!\n", cpu->pc, (unsigned long long)history->instruction);
+		rc++;
+	}
+
+	// Nothing before the first snapshot can be reached
+	v6502_removeBreakpointFromList(list, 0x0606);
+	if (v6502_reverseContinue(history, list) || history->instruction != 0 || cpu->pc != 0x0600) {
+		printf("Expected to stop at the start of history!\n");
+		rc++;
+	}
+
+	v6502_destroyBreakpointList(list);
+	v6502_destroyHistory(history);
+	v6502_destroyMemory(cpu->memory);
+	v6502_destroyCPU(cpu);
+	return rc;
+}
+
+static int hardwareEventCalls;
+
+static void writeFromEvent(v6502_cpu *cpu, void *context) {
+	hardwareEventCalls++;
+	v6502_writeBacking(cpu->memory, 0x0500, 0x55);
+}
+
+static int test_reverseHardwareWrites() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure what devices write to memory, by DMA or from events, is written again when replaying...\n");
+
+	char path[] = "/tmp/v6502-replay-XXXXXX";
+	int fd = mkstemp(path);
+	uint8_t block[256];
+	memset(block, 0xAB, sizeof(block));
+	if (fd < 0 || write(fd, block, sizeof(block)) != sizeof(block)) {
+		printf("Couldn't create an image!\n");
+		return 1;
+	}
+	close(fd);
+
+	v6502_cpu *cpu = v6502_createCPU();
+	cpu->memory = v6502_createMemory(0x10000);
+	v6502_blockDevice *dev = blockDevice_create(cpu->memory, path, 256);
+
+	// Read sector 0 to $0400, then lda $0400; lda $0500; brk
+	const uint8_t program[] = {
+		0xA9, 0x01, 0x8D, blockDevice_countRegister & 0xFF, blockDevice_countRegister >> 8,
+		0xA9, 0x04, 0x8D, blockDevice_addressHighRegister & 0xFF, blockDevice_addressHighRegister >> 8,
+		0xA9, blockDevice_command_read, 0x8D, blockDevice_commandRegister & 0xFF, blockDevice_commandRegister >> 8,
+		0xAD, 0x00, 0x04,
+		0xAD, 0x00, 0x05,
+		0x00,
+	};
+	v6502_loadBytesIntoMemory(cpu->memory, program, sizeof(program), 0x0600);
+	cpu->pc = 0x0600;
+
+	hardwareEventCalls = 0;
+	v6502_history *history = v6502_createHistory(cpu, history_defaultInterval);
+	v6502_schedule(cpu, cpu->cycles + 4, writeFromEvent, NULL);
+	for (int i = 0; i < 8; i++) {
+		v6502_step(cpu);
+		v6502_recordHistory(history, 1);
+	}
+
+	// Going back replays everything from the only snapshot, which was taken before the DMA and the event
+	v6502_reverseStep(history);
+	if (v6502_read(cpu->memory, 0x0400, NO) != 0xAB || v6502_read(cpu->memory, 0x04FF, NO) != 0xAB || v6502_read(cpu->memory, 0x0500, NO) != 0x55) {
+		printf("Expected $ab at $0400 and $55 at $0500, got $%02x and $%02x!\n", v6502_read(cpu->memory, 0x0400, NO), v6502_read(cpu->memory, 0x0500, NO));
+		rc++;
+	}
+	v6502_step(cpu);
+	v6502_recordHistory(history, 1);
+	if (cpu->ac != 0x55) {
+		printf("Expected to load $55 from the event's write, got $%02x!\n", cpu->ac);
+		rc++;
+	}
+
+	v6502_reverseStep(history);
+	v6502_reverseStep(history);
+	v6502_step(cpu);
+	if (cpu->ac != 0xAB || dev->sector != 1) {
+		printf("Expected to load $ab from the DMA, without another transfer, got $%02x!\n", cpu->ac);
+		rc++;
+	}
+	if (hardwareEventCalls != 1) {
+		printf("The event was called %d times!\n", hardwareEventCalls);
+		rc++;
+	}
+
+	v6502_destroyHistory(history);
+	blockDevice_destroy(dev);
+	v6502_destroyMemory(cpu->memory);
+	v6502_destroyCPU(cpu);
+	unlink(path);
+	return rc;
+}
+
+static int test_reverseBankSwitching() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure bank switches are undone and replayed along with the memory in each bank...\n");
+
+	v6502_cpu *cpu = v6502_createCPU();
+	cpu->memory = v6502_createMemory(0x10000);
+	v6502_extendedMemory *ext = v6502_createExtendedMemory(cpu->memory, 0x4000, 0x1000, 0x8000, 1, 0x0200);
+
+	// Write $11 to bank 0, switch to bank 1, write $22 to it, then lda $8000
+	const uint8_t program[] = {
+		0xA9, 0x11, 0x8D, 0x00, 0x80,
+		0xA9, 0x01, 0x8D, 0x00, 0x02,
+		0xA9, 0x22, 0x8D, 0x00, 0x80,
+		0xAD, 0x00, 0x80,
+		0x00,
+	};
+	v6502_loadBytesIntoMemory(cpu->memory, program, sizeof(program), 0x0600);
+	cpu->pc = 0x0600;
+
+	v6502_history *history = v6502_createHistory(cpu, history_defaultInterval);
+	for (int i = 0; i < 7; i++) {
+		v6502_step(cpu);
+		v6502_recordHistory(history, 1);
+	}
+
+	// Replaying from the snapshot, which was taken before bank 1 was switched in, has to switch again
+	v6502_reverseStep(history);
+	if (v6502_selectedBank(ext, 0) != 1 || ext->bytes[0] != 0x11 || v6502_read(cpu->memory, 0x8000, NO) != 0x22) {
+		printf("Expected bank 1 holding $22 in the window, got bank %d holding $%02x!\n", v6502_selectedBank(ext, 0), v6502_read(cpu->memory, 0x8000, NO));
+		rc++;
+	}
+	v6502_step(cpu);
+	v6502_recordHistory(history, 1);
+	if (cpu->ac != 0x22) {
+		printf("Expected to load $22 from bank 1, got $%02x!\n", cpu->ac);
+		rc++;
+	}
+
+	// Both banks go back, whichever one is switched in
+	for (int i = 0; i < 7; i++) {
+		v6502_reverseStep(history);
+	}
+	if (v6502_selectedBank(ext, 0) != 0 || ext->bytes[0] || ext->bytes[0x1000]) {
+		printf("Expected bank 0 switched in, and both banks empty, got bank %d holding $%02x and $%02x!\n", v6502_selectedBank(ext, 0), ext->bytes[0], ext->bytes[0x1000]);
+		rc++;
+	}
+
+	v6502_destroyHistory(history);
+	v6502_destroyExtendedMemory(ext);
+	v6502_destroyMemory(cpu->memory);
+	v6502_destroyCPU(cpu);
+	return rc;
+}
+
+static worker_stop runUntilBrk(v6502_cpu *cpu, void *context) {
+	v6502_run(cpu, 1000);
+	return (cpu->sr & v6502_cpu_status_break) ? worker_stop_brk : worker_stop_none;
+}
+
+static void copyCPU(v6502_cpu *cpu, void *context) {
+	*(v6502_cpu *)context = *cpu;
+}
+
+static int test_cpuWorker() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure a worker can be called into, paused, and stopped by the program...\n");
+
+	v6502_cpu *cpu = v6502_createCPU();
+	cpu->memory = v6502_createMemory(0x10000);
+
+	// inx; jmp $0600
+	const uint8_t program[] = { 0xE8, 0x4C, 0x00, 0x06 };
+	v6502_loadBytesIntoMemory(cpu->memory, program, sizeof(program), 0x0600);
+	cpu->pc = 0x0600;
+
+	v6502_worker *worker = worker_create(cpu, runUntilBrk, NULL);
+	worker_resume(worker);
+
+	// A call sees the CPU between instructions, while it keeps running
+	v6502_cpu seen;
+	worker_call(worker, copyCPU, &seen);
+	if (seen.pc != 0x0600 && seen.pc != 0x0601) {
+		printf("Call saw the CPU mid-instruction, at %#06x!\n", seen.pc);
+		rc++;
+	}
+
+	worker_stop stop;
+	if (worker_pollStop(worker, &stop)) {
+		printf("Worker stopped on its own, with %d!\n", stop);
+		rc++;
+	}
+	if ((stop = worker_pause(worker)) != worker_stop_pause || worker_pause(worker) != worker_stop_none) {
+		printf("Expected a pause, got %d!\n", stop);
+		rc++;
+	}
+
+	// The CPU belongs to this thread again, so it can be changed directly
+	v6502_write(cpu->memory, 0x0600, 0x00);
+	worker_resume(worker);
+	if ((stop = worker_waitForStop(worker)) != worker_stop_brk || !(cpu->sr & v6502_cpu_status_break)) {
+		printf("Expected to stop at a brk, got %d!\n", stop);
+		rc++;
+	}
+
+	worker_destroy(worker);
+	v6502_destroyMemory(cpu->memory);
+	v6502_destroyCPU(cpu);
+	return rc;
+}
+
+static int test_memorySearch() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure vector searches and filters agree with the scalar ones...\n");
+
+	static uint8_t image[search_trackedSize], changed[search_trackedSize];
+	for (size_t i = 0; i < sizeof(image); i++) {
+		image[i] = (uint8_t)((i * 0x9E37) >> 7);
+	}
+
+	// Plant a pattern at the very end, which the vector loop can't reach
+	const uint8_t planted[] = { 0xA9, 0x42, 0x8D, 0x00 };
+	memcpy(image + sizeof(image) - sizeof(planted), planted, sizeof(planted));
+
+	const char *patterns[] = { "a9 42 8d 00", "?? 42 ?? $00", "a9", "??" };
+	for (size_t p = 0; p < sizeof(patterns) / sizeof(patterns[0]); p++) {
+		search_pattern pattern;
+		if (!search_parsePattern(patterns[p], &pattern)) {
+			printf("Couldn't parse \"%s\"!\n", patterns[p]);
+			rc++;
+			continue;
+		}
+
+		size_t vector[16], scalar[16];
+		size_t vectorCount = search_findPattern(image, sizeof(image), &pattern, vector, 16);
+		size_t scalarCount = search_findPatternScalar(image, sizeof(image), &pattern, scalar, 16);
+		if (vectorCount != scalarCount || memcmp(vector, scalar, (vectorCount < 16 ? vectorCount : 16) * sizeof(size_t))) {
+			printf("\"%s\" found %zu matches, but %zu a byte at a time!\n", patterns[p], vectorCount, scalarCount);
+			rc++;
+		}
+		if (p == 0 && (vectorCount != 1 || vector[0] != sizeof(image) - sizeof(planted))) {
+			printf("Expected the planted pattern once, at the end!\n");
+			rc++;
+		}
+	}
+
+	search_pattern invalid;
+	if (search_parsePattern("a9 4", &invalid) == NO || search_parsePattern("a9 123", &invalid) || search_parsePattern("", &invalid) || search_parsePattern("a9 ???", &invalid)) {
+		printf("Patterns weren't parsed as expected!\n");
+		rc++;
+	}
+
+	// Every rule, over memory that changes in both directions
+	search_tracker *vector = malloc(sizeof(search_tracker));
+	search_tracker *scalar = malloc(sizeof(search_tracker));
+	search_startTracking(vector, image);
+	search_startTracking(scalar, image);
+	for (search_rule rule = search_rule_changed; rule <= search_rule_equal; rule++) {
+		for (size_t i = 0; i < sizeof(changed); i++) {
+			changed[i] = image[i] + (uint8_t)((i * rule) % 3) - 1;
+		}
+
+		size_t vectorCount = search_filter(vector, changed, rule, 0x42);
+		size_t scalarCount = search_filterScalar(scalar, changed, rule, 0x42);
+		if (vectorCount != scalarCount || memcmp(vector->candidates, scalar->candidates, sizeof(vector->candidates))) {
+			printf("Rule %d left %zu addresses, but %zu a byte at a time!\n", rule, vectorCount, scalarCount);
+			rc++;
+		}
+
+		// Start over every time, so that later rules have something left to filter
+		search_startTracking(vector, image);
+		search_startTracking(scalar, image);
+	}
+
+	// A counter that goes up once, then stays put
+	image[0x0300] = 1;
+	search_startTracking(vector, image);
+	image[0x0300] = 2;
+	search_filter(vector, image, search_rule_increased, 0);
+	search_filter(vector, image, search_rule_unchanged, 0);
+	if (search_filter(vector, image, search_rule_equal, 2) != 1 || !vector->candidates[0x0300]) {
+		printf("Expected only the counter to be left!\n");
+		rc++;
+	}
+
+	free(vector);
+	free(scalar);
+	return rc;
+}
+
+static int test_ringOrdering() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure a ring keeps bytes in order, and refuses them when full...\n");
+
+	v6502_ring *ring = v6502_createRing(3);
+	uint8_t byte = 0;
+
+	if (ring->capacity != 4 || v6502_ringPop(ring, &byte)) {
+		printf("New ring should be empty, with room for 4 bytes!\n");
+		rc++;
+	}
+
+	// Wrap around a few times
+	for (int round = 0; round < 3; round++) {
+		for (uint8_t i = 0; i < 4; i++) {
+			v6502_ringPush(ring, round * 4 + i);
+		}
+		if (v6502_ringPush(ring, 0xFF)) {
+			printf("Full ring accepted a byte!\n");
+			rc++;
+		}
+		for (uint8_t i = 0; i < 4; i++) {
+			if (!v6502_ringPop(ring, &byte) || byte != round * 4 + i) {
+				printf("Expected %d, got %d!\n", round * 4 + i, byte);
+				rc++;
+			}
+		}
+	}
+
+	v6502_destroyRing(ring);
+	return rc;
+}
+
+static int test_symbolFile() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure binary symbol files load with the same lookups as the table they came from, and refuse to load when damaged...\n");
+
+	as6502_symbol_table *table = as6502_createSymbolTable();
+	as6502_addSymbolToTable(table, 0, "start", 0x0600, as6502_symbol_type_label);
+	as6502_addSymbolToTable(table, 0, "loop", 0x0603, as6502_symbol_type_label);
+	as6502_addSymbolToTable(table, 0, "again", 0x0603, as6502_symbol_type_label);
+	as6502_addSymbolToTable(table, 0, "counter", 0x0200, as6502_symbol_type_variable);
+
+	char path[] = "/tmp/v6502-symbols-XXXXXX";
+	int fd = mkstemp(path);
+	FILE *file = fd < 0 ? NULL : fdopen(fd, "w");
+	if (!file) {
+		printf("Couldn't create a symbol file!\n");
+		as6502_destroySymbolTable(table);
+		return 1;
+	}
+	if (!as6502_writeSymbolFile(table, file)) {
+		printf("Couldn't write the symbol file!\n");
+		rc++;
+	}
+	fclose(file);
+
+	as6502_symbol_table *loaded = as6502_createSymbolTable();
+	if (!as6502_loadSymbolFile(loaded, path) || loaded->file_count != 4) {
+		printf("Couldn't load the symbol file back!\n");
+		rc++;
+	}
+
+	const char *names[] = { "start", "loop", "again", "counter" };
+	for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		as6502_symbol *original = as6502_symbolForString(table, names[i]);
+		as6502_symbol *symbol = as6502_symbolForString(loaded, names[i]);
+		if (!symbol || symbol->address != original->address || symbol->type != original->type) {
+			printf("\"%s\" wasn't found at %#x!\n", names[i], original->address);
+			rc++;
+		}
+	}
+	if (as6502_symbolForString(loaded, "missing") || as6502_symbolForAddress(loaded, 0x0601)) {
+		printf("Found a symbol that was never written!\n");
+		rc++;
+	}
+
+	// Of two symbols at an address, the one first by name is found
+	as6502_symbol *shared = as6502_symbolForAddress(loaded, 0x0603);
+	if (!shared || strcmp(shared->name, "again") || !as6502_symbolForAddress(loaded, 0x0200)) {
+		printf("Addresses didn't find their symbols!\n");
+		rc++;
+	}
+	as6502_destroySymbolTable(loaded);
+
+	// Damage the magic, and then cut the file short
+	loaded = as6502_createSymbolTable();
+	fd = open(path, O_WRONLY);
+	if (fd < 0 || write(fd, "v6502dbg", 8) != 8) {
+		rc++;
+	}
+	close(fd);
+	if (as6502_loadSymbolFile(loaded, path)) {
+		printf("Loaded a symbol file with the wrong magic!\n");
+		rc++;
+	}
+	if (truncate(path, 30) || as6502_loadSymbolFile(loaded, path) || loaded->file_count) {
+		printf("Loaded a truncated symbol file!\n");
+		rc++;
+	}
+
+	as6502_destroySymbolTable(loaded);
+	as6502_destroySymbolTable(table);
+	unlink(path);
+	return rc;
+}
+
+static int test_memoryDump() {
+	TEST_START;
+	int rc = 0;
+
+	printf("Making sure hex dumps keep v6502_printMemoryRange's layout, and read back into the same bytes...\n");
+
+	uint8_t bytes[0x24];
+	for (size_t i = 0; i < sizeof(bytes); i++) {
+		bytes[i] = (uint8_t)(i * 7 + 1);
+	}
+
+	// An unaligned range, so that both ends have blank columns
+	FILE *stream = tmpfile();
+	v6502_printMemoryBytes(stream, 0x02fe, bytes, sizeof(bytes));
+	rewind(stream);
+
+	char line[64];
+	const char *expected[] = {
+		"      0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F\n",
+		"02f0                                           01 08 \n",
+	};
+	for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+		if (!fgets(line, sizeof(line), stream) || strcmp(line, expected[i])) {
+			printf("Line %zu of the dump was \"%s\"!\n", i, line);
+			rc++;
+		}
+	}
+
+	rewind(stream);
+	uint8_t image[0x10000] = { 0 };
+	uint16_t start = 0;
+	size_t length = v6502_scanMemoryBytes(stream, &start, image);
+	if (length != sizeof(bytes) || start != 0x02fe || memcmp(image, bytes, sizeof(bytes))) {
+		printf("Read back %zu bytes from %#x, instead of %zu from 0x2fe!\n", length, start, sizeof(bytes));
+		rc++;
+	}
+	fclose(stream);
+
+	// The top of memory has no row after it to wrap around to
+	stream = tmpfile();
+	v6502_printMemoryBytes(stream, 0xfff8, bytes, 8);
+	rewind(stream);
+	length = v6502_scanMemoryBytes(stream, &start, image);
+	if (length != 8 || start != 0xfff8 || memcmp(image, bytes, 8)) {
+		printf("The top of memory didn't read back!\n");
+		rc++;
+	}
+	fclose(stream);
+
+	return rc;
+}
+
 static int test_cmpCarrySet() {
 	TEST_START;
 	int rc = 0;
@@ -509,8 +2248,35 @@ static testFunction testFunctions[] = {
 	test_intersectingMemoryMapping,
 	test_contiguousMemoryMapping,
 	test_ceilingMemoryMapping,
+	test_unorderedMemoryMapping,
+	test_extendedMemoryBanking,
+	test_deferredWriteNotification,
+	test_sparseMemory,
+	test_sharedPages,
 	test_addressModeForOpcode,
 	test_instructionLengthForOpcode,
+	test_cycleCounting,
+	test_headlessTextMode,
+	test_textModeRecording,
+	test_scheduledInterrupts,
+	test_ringOrdering,
+	test_keyboardInterrupt,
+	test_intervalTimer,
+	test_blockDeviceTransfers,
+	test_uartEcho,
+	test_devicePlugins,
+	test_devicePluginHistory,
+	test_patternTables,
+	test_breakpointBitmap,
+	test_breakpointConditions,
+	test_gdbStub,
+	test_reverseExecution,
+	test_reverseHardwareWrites,
+	test_reverseBankSwitching,
+	test_cpuWorker,
+	test_memorySearch,
+	test_symbolFile,
+	test_memoryDump,
 	test_cmpCarrySet,
 	test_adc1,
 };
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "bank.h"
+
+static size_t _firstPageOfWindow(v6502_extendedMemory *ext, size_t window) {
+	return (ext->windowStart + (window * ext->windowSize)) / v6502_memoryPageSize;
+}
+
+static void _installBank(v6502_extendedMemory *ext, size_t window, uint16_t bank) {
+	uint8_t *bytes = ext->bytes + (bank * ext->windowSize);
+	size_t firstPage = _firstPageOfWindow(ext, window);
+
+	for (size_t i = 0; i < ext->windowSize / v6502_memoryPageSize; i++) {
+		v6502_repointPage(ext->memory, firstPage + i, bytes + (i * v6502_memoryPageSize));
+	}
+}
+
+static uint8_t _readBankRegister(v6502_memory *memory, uint16_t offset, int trap, void *context) {
+	v6502_extendedMemory *ext = context;
+	uint16_t reg = offset - ext->registerStart;
+	uint16_t bank = v6502_selectedBank(ext, reg / 2);
+
+	return (reg % 2) ? (bank >> 8) : (bank & BYTE_MAX);
+}
+
+static void _writeBankRegister(v6502_memory *memory, uint16_t offset, uint8_t value, void *context) {
+	v6502_extendedMemory *ext = context;
+	uint16_t reg = offset - ext->registerStart;
+	uint16_t bank = v6502_selectedBank(ext, reg / 2);
+
+	// Low byte first
+	if (reg % 2) {
+		bank = (bank & BYTE_MAX) | (value << 8);
+	}
+	else {
+		bank = (bank & ~BYTE_MAX) | value;
+	}
+
+	v6502_selectBank(ext, reg / 2, bank);
+}
+
+void v6502_selectBank(v6502_extendedMemory *ext, size_t window, uint16_t bank) {
+	assert(ext);
+	assert(window < ext->windowCount);
+
+	// Like most real mappers, the unused high bits of the bank number are ignored
+	_installBank(ext, window, bank % (ext->size / ext->windowSize));
+}
+
+uint16_t v6502_selectedBank(v6502_extendedMemory *ext, size_t window) {
+	assert(ext);
+	assert(window < ext->windowCount);
+
+	// The page tables are the only record of which bank is selected, so that memory snapshots put it back too
+	return (ext->memory->readPages[_firstPageOfWindow(ext, window)] - ext->bytes) / ext->windowSize;
+}
+
+/**
+ *	If there are allocation problems, or the requested layout is invalid,
+ *	v6502_createExtendedMemory will return NULL.
+ */
+v6502_extendedMemory *v6502_createExtendedMemory(v6502_memory *memory, size_t size, size_t windowSize, uint16_t windowStart, size_t windowCount, uint16_t registerStart) {
+	assert(memory);
+
+	// Windows must line up with the page tables, and banks must line up with windows
+	if (!windowSize || windowSize % v6502_memoryPageSize || windowStart % v6502_memoryPageSize) {
+		return NULL;
+	}
+	if (!size || size % windowSize || size > v6502_extendedMemoryMaxSize) {
+		return NULL;
+	}
+	if (!windowCount || windowStart + (windowCount * windowSize) > 0x10000) {
+		return NULL;
+	}
+
+	// Allocate Extended Memory Struct
+	v6502_extendedMemory *ext = calloc(1, sizeof(v6502_extendedMemory));
+	if (!ext) {
+		return NULL;
+	}
+
+	ext->bytes = calloc(size, sizeof(uint8_t));
+	if (!ext->bytes) {
+		v6502_destroyExtendedMemory(ext);
+		return NULL;
+	}
+
+	ext->size = size;
+	ext->windowSize = windowSize;
+	ext->windowStart = windowStart;
+	ext->windowCount = windowCount;
+	ext->registerStart = registerStart;
+	ext->memory = memory;
+
+	// Bank switches have to happen again when replaying, since they aren't writes to memory
+	if (!v6502_mapReplayed(memory, registerStart, windowCount * 2, _readBankRegister, _writeBankRegister, ext)) {
+		v6502_destroyExtendedMemory(ext);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < windowCount; i++) {
+		_installBank(ext, i, 0);
+	}
+
+	return ext;
+}
+
+void v6502_destroyExtendedMemory(v6502_extendedMemory *ext) {
+	if (!ext) {
+		return;
+	}
+
+	free(ext->bytes);
+	free(ext);
+}
@@ -0,0 +1,75 @@
+/** @brief Banked Extended Memory */
+/** @file bank.h */
+
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef v6502_bank_h
+#define v6502_bank_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <v6502/mem.h>
+
+/** @defgroup bank Banked Extended Memory */
+/**@{*/
+/** @brief Largest amount of host memory an extended memory object may hold (16 megabytes) */
+#define v6502_extendedMemoryMaxSize         0x1000000
+
+/** @struct */
+/** @brief Extended Memory Object */
+/** Extended memory is a pool of host memory larger than the 64k address space, carved into banks that are the size of a window. Each window is a fixed range of the CPU's address space that shows one bank at a time, and each window has a pair of bank registers (low byte first) that software writes to choose which bank is visible.
+
+	Switching banks only repoints the v6502_memory page tables, so accesses to a window cost the same as accesses to ordinary memory, with no callbacks.
+ */
+typedef struct {
+	/** @brief Host memory backing every bank */
+	uint8_t *bytes;
+	/** @brief Byte-length of the extended memory */
+	size_t size;
+	/** @brief Byte-length of each window, and therefore each bank */
+	size_t windowSize;
+	/** @brief Address of the first window in the CPU's address space */
+	uint16_t windowStart;
+	/** @brief Number of adjacent windows, starting at windowStart */
+	size_t windowCount;
+	/** @brief Address of the first bank register, each window has two */
+	uint16_t registerStart;
+	/** @brief The v6502_memory that the windows appear in */
+	v6502_memory *memory;
+} v6502_extendedMemory;
+
+/** @brief Create v6502_extendedMemory, and install its windows and bank registers into a v6502_memory */
+/** The size must be a multiple of windowSize, which must be a multiple of v6502_memoryPageSize (4k or 8k windows are typical.) All windows start out showing bank 0. Returns NULL if the layout doesn't fit in the address space, the registers can't be mapped, or allocation fails. */
+v6502_extendedMemory *v6502_createExtendedMemory(v6502_memory *memory, size_t size, size_t windowSize, uint16_t windowStart, size_t windowCount, uint16_t registerStart);
+/** @brief Destroy v6502_extendedMemory */
+/** The windows still point at the freed banks, so the v6502_memory it was created with must not be used afterwards. */
+void v6502_destroyExtendedMemory(v6502_extendedMemory *ext);
+/** @brief Make a bank visible in a window, as if software had written the bank registers */
+void v6502_selectBank(v6502_extendedMemory *ext, size_t window, uint16_t bank);
+/** @brief Which bank is visible in a window */
+/** This is read from the v6502_memory page tables, where memory snapshots save it, so it goes back along with memory when a snapshot is restored. */
+uint16_t v6502_selectedBank(v6502_extendedMemory *ext, size_t window);
+/**@}*/
+
+#endif
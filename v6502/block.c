@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <assert.h>
+
+#include "block.h"
+
+static int blockDevice_transfer(v6502_blockDevice *dev, int toImage) {
+	size_t offset = (size_t)dev->sector * dev->blockSize;
+	size_t length = (size_t)dev->count * dev->blockSize;
+
+	if (offset + length > dev->size || (toImage && (dev->status & blockDevice_status_readOnly))) {
+		return NO;
+	}
+
+	size_t moved;
+	if (toImage) {
+		moved = v6502_readBackingBytes(dev->memory, dev->address, dev->image + offset, length);
+	}
+	else {
+		moved = v6502_writeBackingBytes(dev->memory, dev->address, dev->image + offset, length);
+	}
+
+	// Running off the top of the address space stops the transfer, leaving the sector register at the first block that didn't fit
+	dev->sector += moved / dev->blockSize;
+	dev->address += moved;
+	return moved == length;
+}
+
+int blockDevice_execute(v6502_blockDevice *dev, blockDevice_command command) {
+	int ok;
+
+	switch (command) {
+		case blockDevice_command_read:
+			ok = blockDevice_transfer(dev, NO);
+			break;
+		case blockDevice_command_write:
+			ok = blockDevice_transfer(dev, YES);
+			break;
+		case blockDevice_command_sync:
+			ok = (dev->status & blockDevice_status_readOnly) || !msync(dev->image, dev->size, MS_SYNC);
+			break;
+		default:
+			ok = NO;
+			break;
+	}
+
+	if (ok) {
+		dev->status &= ~blockDevice_status_error;
+	}
+	else {
+		dev->status |= blockDevice_status_error;
+	}
+	return ok;
+}
+
+static uint8_t blockDevice_read(v6502_memory *memory, uint16_t offset, int trap, void *context) {
+	v6502_blockDevice *dev = context;
+
+	switch (offset) {
+		case blockDevice_commandRegister:
+			return dev->status;
+		case blockDevice_sectorLowRegister:
+			return dev->sector & 0xFF;
+		case blockDevice_sectorHighRegister:
+			return dev->sector >> 8;
+		case blockDevice_addressLowRegister:
+			return dev->address & 0xFF;
+		case blockDevice_addressHighRegister:
+			return dev->address >> 8;
+		case blockDevice_countRegister:
+			return dev->count;
+		default:
+			return 0;
+	}
+}
+
+static void blockDevice_write(v6502_memory *memory, uint16_t offset, uint8_t value, void *context) {
+	v6502_blockDevice *dev = context;
+
+	switch (offset) {
+		case blockDevice_commandRegister:
+			blockDevice_execute(dev, value);
+			break;
+		case blockDevice_sectorLowRegister:
+			dev->sector = (dev->sector & 0xFF00) | value;
+			break;
+		case blockDevice_sectorHighRegister:
+			dev->sector = (dev->sector & 0x00FF) | (value << 8);
+			break;
+		case blockDevice_addressLowRegister:
+			dev->address = (dev->address & 0xFF00) | value;
+			break;
+		case blockDevice_addressHighRegister:
+			dev->address = (dev->address & 0x00FF) | (value << 8);
+			break;
+		case blockDevice_countRegister:
+			dev->count = value;
+			break;
+		default:
+			break;
+	}
+}
+
+v6502_blockDevice *blockDevice_create(v6502_memory *mem, const char *path, size_t blockSize) {
+	assert(mem && path);
+
+	if (blockSize != 256 && blockSize != 512) {
+		return NULL;
+	}
+
+	int readOnly = NO;
+	int fd = open(path, O_RDWR);
+	if (fd < 0) {
+		readOnly = YES;
+		fd = open(path, O_RDONLY);
+		if (fd < 0) {
+			return NULL;
+		}
+	}
+
+	// Only whole blocks are mapped, and the mapping outlives the descriptor
+	struct stat st;
+	size_t size = 0;
+	if (!fstat(fd, &st)) {
+		size = ((size_t)st.st_size / blockSize) * blockSize;
+	}
+
+	uint8_t *image = MAP_FAILED;
+	if (size) {
+		image = mmap(NULL, size, readOnly ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+	if (image == MAP_FAILED) {
+		return NULL;
+	}
+
+	v6502_blockDevice *dev = calloc(1, sizeof(v6502_blockDevice));
+	if (!dev) {
+		munmap(image, size);
+		return NULL;
+	}
+
+	dev->memory = mem;
+	dev->image = image;
+	dev->size = size;
+	dev->blockSize = blockSize;
+	dev->status = blockDevice_status_ready;
+	if (readOnly) {
+		dev->status |= blockDevice_status_readOnly;
+	}
+	if (blockSize == 512) {
+		dev->status |= blockDevice_status_largeBlocks;
+	}
+
+	if (!v6502_map(mem, blockDevice_commandRegister, blockDevice_registerCount, blockDevice_read, blockDevice_write, dev)) {
+		munmap(image, size);
+		free(dev);
+		return NULL;
+	}
+
+	return dev;
+}
+
+void blockDevice_destroy(v6502_blockDevice *dev) {
+	if (!dev) {
+		return;
+	}
+
+	if (!(dev->status & blockDevice_status_readOnly)) {
+		msync(dev->image, dev->size, MS_SYNC);
+	}
+	munmap(dev->image, dev->size);
+	free(dev);
+}
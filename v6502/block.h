@@ -0,0 +1,110 @@
+/** @brief 6502 Reference Platform Block Storage Device */
+/** @file block.h */
+
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef v6502_block_h
+#define v6502_block_h
+
+#include <v6502/mem.h>
+#include <v6502/textmode.h>
+
+/** @brief Address of the block device command register when written, and status register when read */
+#define blockDevice_commandRegister		(textMode_registerStart + 0x20)
+/** @brief Address of the low byte of the block device sector register */
+#define blockDevice_sectorLowRegister	(textMode_registerStart + 0x21)
+/** @brief Address of the high byte of the block device sector register */
+#define blockDevice_sectorHighRegister	(textMode_registerStart + 0x22)
+/** @brief Address of the low byte of the block device DMA address register */
+#define blockDevice_addressLowRegister	(textMode_registerStart + 0x23)
+/** @brief Address of the high byte of the block device DMA address register */
+#define blockDevice_addressHighRegister	(textMode_registerStart + 0x24)
+/** @brief Address of the block device sector count register */
+#define blockDevice_countRegister		(textMode_registerStart + 0x25)
+/** @brief Number of block device registers */
+#define blockDevice_registerCount		6
+/** @brief Block size used by the reference platform */
+#define blockDevice_defaultBlockSize	512
+
+/** The guest sets up the sector, DMA address and sector count registers, then writes a command. Transfers finish before the write does, so the status register can be checked straight away. Afterwards, the sector and address registers point just past the blocks that were moved, so consecutive transfers don't need them set up again.
+
+	A transfer that would run off the end of the image moves nothing, and sets blockDevice_status_error. One that runs off the top of the address space stops there, with the sector register pointing at the first block that didn't fit, and sets blockDevice_status_error too.
+ */
+
+/** @defgroup blockDevice Reference Platform Block Storage */
+/**@{*/
+/** @enum */
+/** @brief Block Device Commands */
+typedef enum {
+	/** @brief Copy blocks from the image into memory */
+	blockDevice_command_read  = 0x01,
+	/** @brief Copy blocks from memory into the image */
+	blockDevice_command_write = 0x02,
+	/** @brief Make sure everything written so far has reached the host file */
+	blockDevice_command_sync  = 0x03,
+} blockDevice_command;
+
+/** @enum */
+/** @brief Block Device Status Register Bits */
+typedef enum {
+	/** @brief The last command failed */
+	blockDevice_status_error       = 1 << 0,
+	/** @brief The image can't be written to */
+	blockDevice_status_readOnly    = 1 << 1,
+	/** @brief Blocks are 512 bytes, rather than 256 */
+	blockDevice_status_largeBlocks = 1 << 6,
+	/** @brief There is an image to transfer to and from */
+	blockDevice_status_ready       = 1 << 7,
+} blockDevice_status;
+
+/** @struct */
+/** @brief Block Storage Hardware Object */
+/** The host image is mapped into the emulator's address space, so a transfer is a copy between it and v6502_memory, a page at a time, with no system call or callback per byte. */
+typedef struct {
+	/** @brief The v6502_memory that blocks are transferred to and from */
+	v6502_memory *memory;
+	/** @brief The mapped image */
+	uint8_t *image;
+	/** @brief Size of the mapped image in bytes */
+	size_t size;
+	/** @brief Bytes per block, which is 256 or 512 */
+	size_t blockSize;
+	/** @brief Status register */
+	uint8_t status;
+	/** @brief Sector register */
+	uint16_t sector;
+	/** @brief DMA address register */
+	uint16_t address;
+	/** @brief Sector count register */
+	uint8_t count;
+} v6502_blockDevice;
+
+/** @brief Create v6502_blockDevice, mapping its registers into a v6502_memory, and a host image file into memory */
+/** The image is opened for writing if possible, and read only otherwise. Any partial block at the end of the image is left alone. Returns NULL if the block size isn't 256 or 512, the image can't be opened or mapped, the registers can't be mapped, or allocation fails. */
+v6502_blockDevice *blockDevice_create(v6502_memory *mem, const char *path, size_t blockSize);
+/** @brief Destroy v6502_blockDevice, writing any changes back to the image file */
+void blockDevice_destroy(v6502_blockDevice *dev);
+/** @brief Run a command as if the guest had written it to the command register, returning NO if it failed */
+int blockDevice_execute(v6502_blockDevice *dev, blockDevice_command command);
+/**@}*/
+
+#endif
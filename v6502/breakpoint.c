@@ -21,6 +21,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include <as6502/parser.h>
@@ -36,6 +37,9 @@ void v6502_destroyBreakpointList(v6502_breakpoint_list *list) {
 		return;
 	}
 
+	for (size_t i = 0; i < list->count; i++) {
+		v6502_destroyCondition(list->breakpoints[i].condition);
+	}
 	free(list->breakpoints);
 	free(list);
 }
@@ -43,41 +47,83 @@ void v6502_destroyBreakpointList(v6502_breakpoint_list *list) {
 void v6502_addBreakpointToList(v6502_breakpoint_list *list, uint16_t address) {
 	assert(list);
 
-	if (!v6502_breakpointIsInList(list, address)) {
-		list->breakpoints = realloc(list->breakpoints, sizeof(address) * (list->count + 1));
-		list->breakpoints[list->count] = address;
-		list->count++;
+	if (v6502_breakpointIsInList(list, address)) {
+		return;
+	}
+
+	if (list->count == list->capacity) {
+		size_t capacity = list->capacity ? list->capacity * 2 : 8;
+		v6502_breakpoint *breakpoints = realloc(list->breakpoints, sizeof(v6502_breakpoint) * capacity);
+		if (!breakpoints) {
+			return;
+		}
+		list->breakpoints = breakpoints;
+		list->capacity = capacity;
 	}
+
+	list->breakpoints[list->count] = (v6502_breakpoint){ .address = address };
+	list->count++;
+
+	list->pages[address >> 8]++;
+	list->bitmap[address >> 3] |= 1 << (address & 7);
 }
 
-static uint16_t *locationOfBreakpointInList(v6502_breakpoint_list *list, uint16_t address) {
+v6502_breakpoint *v6502_breakpointAtAddress(v6502_breakpoint_list *list, uint16_t address) {
 	assert(list);
 
+	if (!v6502_breakpointIsInList(list, address)) {
+		return NULL;
+	}
+
 	for (size_t i = 0; i < list->count; i++) {
-		if (list->breakpoints[i] == address) {
+		if (list->breakpoints[i].address == address) {
 			return &list->breakpoints[i];
 		}
 	}
 	return NULL;
 }
 
-int v6502_breakpointIsInList(v6502_breakpoint_list *list, uint16_t address) {
-	return locationOfBreakpointInList(list, address) != NULL;
+int v6502_hitBreakpoint(v6502_breakpoint_list *list, v6502_cpu *cpu) {
+	v6502_breakpoint *breakpoint = v6502_breakpointAtAddress(list, cpu->pc);
+
+	if (!breakpoint || (breakpoint->condition && !v6502_evaluateCondition(breakpoint->condition, cpu))) {
+		return NO;
+	}
+
+	breakpoint->hits++;
+	if (breakpoint->ignoreCount) {
+		breakpoint->ignoreCount--;
+		return NO;
+	}
+	return YES;
+}
+
+int v6502_setBreakpointCondition(v6502_breakpoint_list *list, uint16_t address, v6502_condition *condition) {
+	v6502_breakpoint *breakpoint = v6502_breakpointAtAddress(list, address);
+
+	if (!breakpoint) {
+		v6502_destroyCondition(condition);
+		return NO;
+	}
+
+	v6502_destroyCondition(breakpoint->condition);
+	breakpoint->condition = condition;
+	return YES;
 }
 
 void v6502_removeBreakpointFromList(v6502_breakpoint_list *list, uint16_t address) {
 	assert(list);
 
-	uint16_t *loc = locationOfBreakpointInList(list, address);
+	v6502_breakpoint *loc = v6502_breakpointAtAddress(list, address);
 
 	if (loc) {
-		// Shift the entire list down one
-		for (size_t i = (loc - list->breakpoints) + 1; i < list->count; i++) {
-			list->breakpoints[i - 1] = list->breakpoints[i];
-		}
-
+		// Shift the rest of the list down one, keeping the order they were added in
+		size_t index = loc - list->breakpoints;
+		v6502_destroyCondition(loc->condition);
+		memmove(loc, loc + 1, sizeof(v6502_breakpoint) * (list->count - index - 1));
 		list->count--;
-		list->breakpoints = realloc(list->breakpoints, sizeof(address) * list->count);
+
+		list->pages[address >> 8]--;
+		list->bitmap[address >> 3] &= ~(1 << (address & 7));
 	}
 }
-
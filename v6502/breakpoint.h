@@ -27,15 +27,40 @@
 #define v6502_breakpoint_h
 
 #include <stdint.h>
+#include <stddef.h>
+
+#include <v6502/cpu.h>
+#include <v6502/condition.h>
 
 /** @defgroup breakpoint Breakpoint Management */
 /**@{*/
+/** @struct */
+/** @brief A Single Breakpoint, and What Has Happened At It */
+typedef struct {
+	/** @brief Address of the breakpoint */
+	uint16_t address;
+	/** @brief Number of times the breakpoint has been reached */
+	unsigned long hits;
+	/** @brief Number of times the breakpoint will be passed over before it stops the CPU */
+	unsigned long ignoreCount;
+	/** @brief Condition that has to be true for the breakpoint to count as reached, or NULL to always stop */
+	v6502_condition *condition;
+} v6502_breakpoint;
+
+/** @struct */
 /** @brief Breakpoint List Object */
+/** Checking an address costs the same no matter how many breakpoints there are, since it only looks at a count of breakpoints on the address's page, and then a bitmap of every address. The list of v6502_breakpoint structs is only searched when a breakpoint is actually reached. */
 typedef struct {
-	/** @brief Array of breakpoint addresses */
-	uint16_t *breakpoints;
+	/** @brief Array of breakpoints, in the order they were added */
+	v6502_breakpoint *breakpoints;
 	/** @brief Number of breakpoints in the array */
 	size_t count;
+	/** @brief Number of breakpoints the array has room for */
+	size_t capacity;
+	/** @brief Number of breakpoints on each page */
+	uint16_t pages[256];
+	/** @brief One bit per address, set if there is a breakpoint there */
+	uint8_t bitmap[0x10000 / 8];
 } v6502_breakpoint_list;
 
 /** @brief Create a v6502_breakpoint_list */
@@ -47,7 +72,18 @@ void v6502_addBreakpointToList(v6502_breakpoint_list *list, uint16_t address);
 /** @brief Locate and remove the first matching address in a v6502_breakpoint_list */
 void v6502_removeBreakpointFromList(v6502_breakpoint_list *list, uint16_t address);
 /** @brief Check if an address is present in a v6502_breakpoint_list */
-int v6502_breakpointIsInList(v6502_breakpoint_list *list, uint16_t address);
+static inline int v6502_breakpointIsInList(const v6502_breakpoint_list *list, uint16_t address) {
+	// Most pages have no breakpoints, so the bitmap usually isn't touched at all
+	return list->pages[address >> 8] && (list->bitmap[address >> 3] & (1 << (address & 7)));
+}
+/** @brief Get the v6502_breakpoint at an address, or NULL if there isn't one */
+v6502_breakpoint *v6502_breakpointAtAddress(v6502_breakpoint_list *list, uint16_t address);
+/** @brief Count a hit of the breakpoint at a v6502_cpu's program counter, returning YES if it should stop the CPU, or NO if its condition is false, it is being ignored, or there isn't one */
+/** A breakpoint whose condition is false isn't counted as hit, and doesn't use up its ignore count. */
+int v6502_hitBreakpoint(v6502_breakpoint_list *list, v6502_cpu *cpu);
+/** @brief Give the breakpoint at an address a condition, replacing and destroying any it had, or remove its condition if condition is NULL */
+/** The list takes ownership of the condition. Returns NO, and destroys the condition, if there is no breakpoint at the address. */
+int v6502_setBreakpointCondition(v6502_breakpoint_list *list, uint16_t address, v6502_condition *condition);
 /**@}*/
 
 #endif
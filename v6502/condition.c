@@ -0,0 +1,405 @@
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+
+#include <as6502/parser.h>
+
+#include "condition.h"
+
+/** State of a compilation in progress */
+typedef struct {
+	const char *cursor;
+	as6502_symbol_table *table;
+	v6502_conditionInstruction *program;
+	size_t length;
+	size_t capacity;
+	int depth;
+	int maxDepth;
+	const char *error;
+} _compiler;
+
+static void _emit(_compiler *c, v6502_conditionOp op, int32_t value) {
+	if (c->error) {
+		return;
+	}
+
+	if (c->length == c->capacity) {
+		size_t capacity = c->capacity ? c->capacity * 2 : 16;
+		v6502_conditionInstruction *program = realloc(c->program, sizeof(v6502_conditionInstruction) * capacity);
+		if (!program) {
+			c->error = "Out of memory";
+			return;
+		}
+		c->program = program;
+		c->capacity = capacity;
+	}
+
+	c->program[c->length++] = (v6502_conditionInstruction){ .op = op, .value = value };
+
+	// Track how deep the stack gets, so evaluation never has to check
+	switch (op) {
+		case v6502_conditionOp_push:
+		case v6502_conditionOp_register:
+			c->depth++;
+			break;
+		case v6502_conditionOp_memory:
+		case v6502_conditionOp_not:
+		case v6502_conditionOp_complement:
+		case v6502_conditionOp_negate:
+			break;
+		default:
+			c->depth--;
+			break;
+	}
+	if (c->depth > c->maxDepth) {
+		c->maxDepth = c->depth;
+	}
+	if (c->maxDepth > v6502_conditionStackDepth) {
+		c->error = "Condition is too deeply nested";
+	}
+}
+
+static void _skipSpace(_compiler *c) {
+	while (isspace((unsigned char)*c->cursor)) {
+		c->cursor++;
+	}
+}
+
+/** Consumes a token if it is next, returning YES if it was */
+static int _accept(_compiler *c, const char *token) {
+	_skipSpace(c);
+
+	size_t length = strlen(token);
+	if (strncmp(c->cursor, token, length)) {
+		return NO;
+	}
+
+	// Don't take the first half of a longer operator, like < out of <=, or & out of &&
+	char next = c->cursor[length];
+	if (length == 1 && strchr("<>!&|", token[0]) && (next == '=' || (next == token[0] && (next == '&' || next == '|')))) {
+		return NO;
+	}
+
+	c->cursor += length;
+	return YES;
+}
+
+static void _compileOr(_compiler *c);
+
+static void _compileNumber(_compiler *c) {
+	int base = 10;
+	if (*c->cursor == '$') {
+		base = 16;
+		c->cursor++;
+	}
+	else if (*c->cursor == '%') {
+		base = 2;
+		c->cursor++;
+	}
+	else if (c->cursor[0] == '0' && (c->cursor[1] == 'x' || c->cursor[1] == 'X')) {
+		base = 16;
+		c->cursor += 2;
+	}
+
+	char *end;
+	long value = strtol(c->cursor, &end, base);
+	if (end == c->cursor) {
+		c->error = "Expected a number";
+		return;
+	}
+
+	c->cursor = end;
+	_emit(c, v6502_conditionOp_push, (int32_t)value);
+}
+
+static void _compilePrimary(_compiler *c) {
+	_skipSpace(c);
+
+	if (_accept(c, "(")) {
+		_compileOr(c);
+		if (!_accept(c, ")")) {
+			c->error = "Expected ')'";
+		}
+		return;
+	}
+
+	if (isdigit((unsigned char)*c->cursor) || *c->cursor == '$' || *c->cursor == '%') {
+		_compileNumber(c);
+		return;
+	}
+
+	if (!isalpha((unsigned char)*c->cursor) && *c->cursor != '_') {
+		c->error = "Expected a register, symbol, number or mem[]";
+		return;
+	}
+
+	const char *start = c->cursor;
+	while (isalnum((unsigned char)*c->cursor) || *c->cursor == '_') {
+		c->cursor++;
+	}
+	size_t length = c->cursor - start;
+
+	if (length == 3 && !strncasecmp(start, "mem", 3) && _accept(c, "[")) {
+		_compileOr(c);
+		if (!_accept(c, "]")) {
+			c->error = "Expected ']'";
+		}
+		_emit(c, v6502_conditionOp_memory, 0);
+		return;
+	}
+
+	static const struct { const char *name; v6502_conditionRegister reg; } registers[] = {
+		{ "a",  v6502_conditionRegister_ac },
+		{ "x",  v6502_conditionRegister_x },
+		{ "y",  v6502_conditionRegister_y },
+		{ "sp", v6502_conditionRegister_sp },
+		{ "sr", v6502_conditionRegister_sr },
+		{ "pc", v6502_conditionRegister_pc },
+	};
+	for (size_t i = 0; i < sizeof(registers) / sizeof(registers[0]); i++) {
+		if (strlen(registers[i].name) == length && !strncasecmp(start, registers[i].name, length)) {
+			_emit(c, v6502_conditionOp_register, registers[i].reg);
+			return;
+		}
+	}
+
+	// Anything else must be a symbol, which never moves, so it becomes a constant
+	char *name = strndup(start, length);
+	as6502_symbol *symbol = c->table ? as6502_symbolForString(c->table, name) : NULL;
+	free(name);
+	if (!symbol) {
+		c->error = "Unknown symbol";
+		return;
+	}
+	_emit(c, v6502_conditionOp_push, symbol->address);
+}
+
+static void _compileUnary(_compiler *c) {
+	if (_accept(c, "!")) {
+		_compileUnary(c);
+		_emit(c, v6502_conditionOp_not, 0);
+	}
+	else if (_accept(c, "~")) {
+		_compileUnary(c);
+		_emit(c, v6502_conditionOp_complement, 0);
+	}
+	else if (_accept(c, "-")) {
+		_compileUnary(c);
+		_emit(c, v6502_conditionOp_negate, 0);
+	}
+	else {
+		_compilePrimary(c);
+	}
+}
+
+static void _compileAdditive(_compiler *c) {
+	_compileUnary(c);
+	while (!c->error) {
+		if (_accept(c, "+")) {
+			_compileUnary(c);
+			_emit(c, v6502_conditionOp_add, 0);
+		}
+		else if (_accept(c, "-")) {
+			_compileUnary(c);
+			_emit(c, v6502_conditionOp_subtract, 0);
+		}
+		else {
+			return;
+		}
+	}
+}
+
+static void _compileBitwise(_compiler *c) {
+	_compileAdditive(c);
+	while (!c->error) {
+		if (_accept(c, "&")) {
+			_compileAdditive(c);
+			_emit(c, v6502_conditionOp_bitAnd, 0);
+		}
+		else if (_accept(c, "|")) {
+			_compileAdditive(c);
+			_emit(c, v6502_conditionOp_bitOr, 0);
+		}
+		else if (_accept(c, "^")) {
+			_compileAdditive(c);
+			_emit(c, v6502_conditionOp_bitXor, 0);
+		}
+		else {
+			return;
+		}
+	}
+}
+
+static void _compileComparison(_compiler *c) {
+	static const struct { const char *token; v6502_conditionOp op; } comparisons[] = {
+		// Longer tokens first, so that <= isn't taken as <
+		{ "==", v6502_conditionOp_equal },
+		{ "!=", v6502_conditionOp_notEqual },
+		{ "<=", v6502_conditionOp_lessOrEqual },
+		{ ">=", v6502_conditionOp_greaterOrEqual },
+		{ "<",  v6502_conditionOp_less },
+		{ ">",  v6502_conditionOp_greater },
+	};
+
+	_compileBitwise(c);
+	for (size_t i = 0; i < sizeof(comparisons) / sizeof(comparisons[0]) && !c->error; i++) {
+		if (_accept(c, comparisons[i].token)) {
+			_compileBitwise(c);
+			_emit(c, comparisons[i].op, 0);
+			return;
+		}
+	}
+}
+
+static void _compileAnd(_compiler *c) {
+	_compileComparison(c);
+	while (!c->error && _accept(c, "&&")) {
+		_compileComparison(c);
+		_emit(c, v6502_conditionOp_and, 0);
+	}
+}
+
+static void _compileOr(_compiler *c) {
+	_compileAnd(c);
+	while (!c->error && _accept(c, "||")) {
+		_compileAnd(c);
+		_emit(c, v6502_conditionOp_or, 0);
+	}
+}
+
+v6502_condition *v6502_compileCondition(const char *source, as6502_symbol_table *table, const char **error) {
+	assert(source);
+
+	_compiler c = { .cursor = source, .table = table };
+	_compileOr(&c);
+
+	_skipSpace(&c);
+	if (!c.error && *c.cursor) {
+		c.error = "Unexpected text after condition";
+	}
+
+	v6502_condition *condition = NULL;
+	if (!c.error) {
+		condition = malloc(sizeof(v6502_condition));
+		if (condition) {
+			condition->source = strdup(source);
+		}
+		if (!condition || !condition->source) {
+			free(condition);
+			condition = NULL;
+			c.error = "Out of memory";
+		}
+	}
+
+	if (c.error) {
+		free(c.program);
+		if (error) {
+			*error = c.error;
+		}
+		return NULL;
+	}
+
+	condition->program = c.program;
+	condition->length = c.length;
+	return condition;
+}
+
+void v6502_destroyCondition(v6502_condition *condition) {
+	if (!condition) {
+		return;
+	}
+
+	free(condition->source);
+	free(condition->program);
+	free(condition);
+}
+
+int v6502_evaluateCondition(const v6502_condition *condition, v6502_cpu *cpu) {
+	int32_t stack[v6502_conditionStackDepth];
+	int top = -1;
+
+	for (size_t i = 0; i < condition->length; i++) {
+		const v6502_conditionInstruction *instruction = &condition->program[i];
+
+		switch (instruction->op) {
+			case v6502_conditionOp_push:
+				stack[++top] = instruction->value;
+				continue;
+			case v6502_conditionOp_register: {
+				int32_t value = 0;
+				switch ((v6502_conditionRegister)instruction->value) {
+					case v6502_conditionRegister_ac: value = cpu->ac; break;
+					case v6502_conditionRegister_x:  value = cpu->x;  break;
+					case v6502_conditionRegister_y:  value = cpu->y;  break;
+					case v6502_conditionRegister_sp: value = cpu->sp; break;
+					case v6502_conditionRegister_sr: value = cpu->sr; break;
+					case v6502_conditionRegister_pc: value = cpu->pc; break;
+				}
+				stack[++top] = value;
+			} continue;
+			// Looking at memory mustn't disturb any hardware mapped there
+			case v6502_conditionOp_memory:
+				stack[top] = v6502_read(cpu->memory, (uint16_t)stack[top], NO);
+				continue;
+			case v6502_conditionOp_not:
+				stack[top] = !stack[top];
+				continue;
+			case v6502_conditionOp_complement:
+				stack[top] = ~stack[top];
+				continue;
+			case v6502_conditionOp_negate:
+				stack[top] = (int32_t)(0 - (uint32_t)stack[top]);
+				continue;
+			default:
+				break;
+		}
+
+		// Everything else takes two operands, and leaves one
+		int32_t right = stack[top--];
+		int32_t left = stack[top];
+		int32_t result = 0;
+		switch (instruction->op) {
+			case v6502_conditionOp_or:             result = left || right; break;
+			case v6502_conditionOp_and:            result = left && right; break;
+			case v6502_conditionOp_equal:          result = left == right; break;
+			case v6502_conditionOp_notEqual:       result = left != right; break;
+			case v6502_conditionOp_less:           result = left < right;  break;
+			case v6502_conditionOp_lessOrEqual:    result = left <= right; break;
+			case v6502_conditionOp_greater:        result = left > right;  break;
+			case v6502_conditionOp_greaterOrEqual: result = left >= right; break;
+			case v6502_conditionOp_bitAnd:         result = left & right;  break;
+			case v6502_conditionOp_bitOr:          result = left | right;  break;
+			case v6502_conditionOp_bitXor:         result = left ^ right;  break;
+			// Arithmetic wraps, rather than overflowing, which would be undefined
+			case v6502_conditionOp_add:            result = (int32_t)((uint32_t)left + (uint32_t)right); break;
+			case v6502_conditionOp_subtract:       result = (int32_t)((uint32_t)left - (uint32_t)right); break;
+			default: break;
+		}
+		stack[top] = result;
+	}
+
+	return top >= 0 && stack[top] != 0;
+}
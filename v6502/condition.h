@@ -0,0 +1,105 @@
+/** @brief Compiled Breakpoint Conditions */
+/** @file condition.h */
+
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef v6502_condition_h
+#define v6502_condition_h
+
+#include <v6502/cpu.h>
+#include <as6502/symbols.h>
+
+/** @brief Deepest a condition's evaluation stack can get */
+#define v6502_conditionStackDepth	32
+
+/** A condition is an expression over registers (a, x, y, sp, sr and pc), memory bytes (mem[addr]), symbols, and numbers (decimal, $hex, 0xhex or %binary). From loosest to tightest, the operators are ||, &&, comparisons (== != < <= > >=), bitwise (& | ^), additive (+ -), and unary (! ~ -), and parentheses group. It is true if it is nonzero, like C.
+
+	Conditions are compiled once into a flat program for a stack machine, with symbols already resolved, so evaluating one at a breakpoint is a short loop with no parsing.
+ */
+
+/** @defgroup condition Breakpoint Conditions */
+/**@{*/
+/** @enum */
+/** @brief Condition Opcodes */
+typedef enum {
+	v6502_conditionOp_push,
+	v6502_conditionOp_register,
+	v6502_conditionOp_memory,
+	v6502_conditionOp_not,
+	v6502_conditionOp_complement,
+	v6502_conditionOp_negate,
+	v6502_conditionOp_or,
+	v6502_conditionOp_and,
+	v6502_conditionOp_equal,
+	v6502_conditionOp_notEqual,
+	v6502_conditionOp_less,
+	v6502_conditionOp_lessOrEqual,
+	v6502_conditionOp_greater,
+	v6502_conditionOp_greaterOrEqual,
+	v6502_conditionOp_bitAnd,
+	v6502_conditionOp_bitOr,
+	v6502_conditionOp_bitXor,
+	v6502_conditionOp_add,
+	v6502_conditionOp_subtract,
+} v6502_conditionOp;
+
+/** @enum */
+/** @brief Registers a Condition Can Read */
+typedef enum {
+	v6502_conditionRegister_ac,
+	v6502_conditionRegister_x,
+	v6502_conditionRegister_y,
+	v6502_conditionRegister_sp,
+	v6502_conditionRegister_sr,
+	v6502_conditionRegister_pc,
+} v6502_conditionRegister;
+
+/** @struct */
+/** @brief One Step of a Compiled Condition */
+typedef struct {
+	/** @brief What the step does */
+	v6502_conditionOp op;
+	/** @brief The number pushed by v6502_conditionOp_push, or the v6502_conditionRegister read by v6502_conditionOp_register */
+	int32_t value;
+} v6502_conditionInstruction;
+
+/** @struct */
+/** @brief Compiled Condition Object */
+typedef struct {
+	/** @brief The expression the condition was compiled from */
+	char *source;
+	/** @brief The compiled steps */
+	v6502_conditionInstruction *program;
+	/** @brief Number of steps in v6502_condition::program */
+	size_t length;
+} v6502_condition;
+
+/** @brief Compile a condition, resolving any symbols in a table, which may be NULL */
+/** Returns NULL on failure, with a description of the problem in error if it isn't NULL. */
+v6502_condition *v6502_compileCondition(const char *source, as6502_symbol_table *table, const char **error);
+/** @brief Destroy a v6502_condition */
+void v6502_destroyCondition(v6502_condition *condition);
+/** @brief Evaluate a v6502_condition against the state of a v6502_cpu, returning YES if it is true */
+int v6502_evaluateCondition(const v6502_condition *condition, v6502_cpu *cpu);
+/**@}*/
+
+#endif
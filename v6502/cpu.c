@@ -21,6 +21,8 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <assert.h>
 
 #include "cpu.h"
 
@@ -150,6 +152,35 @@ static void _executeInPlaceBIT(v6502_cpu *cpu, uint8_t operand) {
 	//! [bit]
 }
 
+static void _push(v6502_cpu *cpu, uint8_t value) {
+	v6502_write(cpu->memory, v6502_memoryStartStack + cpu->sp--, value);
+}
+
+static uint8_t _pull(v6502_cpu *cpu) {
+	return v6502_read(cpu->memory, v6502_memoryStartStack + ++cpu->sp, YES);
+}
+
+/** Base cycle counts for every opcode, including the undocumented ones */
+static const uint8_t _cycleTable[256] = {
+/*	0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F */
+	7, 6, 2, 8, 3, 3, 5, 5, 3, 2, 2, 2, 4, 4, 6, 6, // 0
+	2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // 1
+	6, 6, 2, 8, 3, 3, 5, 5, 4, 2, 2, 2, 4, 4, 6, 6, // 2
+	2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // 3
+	6, 6, 2, 8, 3, 3, 5, 5, 3, 2, 2, 2, 3, 4, 6, 6, // 4
+	2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // 5
+	6, 6, 2, 8, 3, 3, 5, 5, 4, 2, 2, 2, 5, 4, 6, 6, // 6
+	2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // 7
+	2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4, // 8
+	2, 6, 2, 6, 4, 4, 4, 4, 2, 5, 2, 5, 5, 5, 5, 5, // 9
+	2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4, // A
+	2, 5, 2, 5, 4, 4, 4, 4, 2, 4, 2, 4, 4, 4, 4, 4, // B
+	2, 6, 2, 8, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 6, // C
+	2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // D
+	2, 6, 2, 8, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 6, // E
+	2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // F
+};
+
 #pragma mark -
 #pragma mark CPU Lifecycle
 
@@ -158,6 +189,11 @@ v6502_cpu *v6502_createCPU(void) {
 }
 
 void v6502_destroyCPU(v6502_cpu *cpu) {
+	if (!cpu) {
+		return;
+	}
+
+	free(cpu->events);
 	free(cpu);
 }
 
@@ -282,9 +318,41 @@ v6502_address_mode v6502_addressModeForOpcode(v6502_opcode opcode) {
 	return v6502_address_mode_unknown;
 }
 
+int v6502_cyclesForOpcode(v6502_opcode opcode) {
+	return _cycleTable[(uint8_t)opcode];
+}
+
+static void _serviceEvents(v6502_cpu *cpu);
+
+/** Pushes the return address the same way jsr does, followed by the status register, then jumps through a vector */
+static void _interrupt(v6502_cpu *cpu, uint16_t vectorLow, uint16_t vectorHigh) {
+	_push(cpu, cpu->pc);        // Low byte first
+	_push(cpu, cpu->pc >> 8);   // High byte second
+	_push(cpu, (cpu->sr & ~v6502_cpu_status_break) | v6502_cpu_status_ignored);
+
+	cpu->sr |= v6502_cpu_status_interrupt;
+	cpu->pc = (v6502_read(cpu->memory, vectorHigh, NO) << 8);
+	cpu->pc |= v6502_read(cpu->memory, vectorLow, NO);
+	cpu->cycles += 7;
+}
+
+/** Returns the replay log that interrupts should be added to, if they are being recorded */
+static v6502_replayLog *_recordingLog(v6502_cpu *cpu) {
+	v6502_replayLog *log = cpu->memory ? cpu->memory->replayLog : NULL;
+	return (log && !log->replaying) ? log : NULL;
+}
+
+static int _replaying(v6502_cpu *cpu) {
+	return cpu->memory && cpu->memory->replayLog && cpu->memory->replayLog->replaying;
+}
+
 void v6502_nmi(v6502_cpu *cpu) {
-	cpu->pc = (v6502_read(cpu->memory, v6502_memoryVectorNMIHigh, NO) << 8);
-	cpu->pc |= v6502_read(cpu->memory, v6502_memoryVectorNMILow, NO);
+	v6502_replayLog *log = _recordingLog(cpu);
+	if (log) {
+		v6502_logReplayEntry(log, v6502_replayEntry_nmi, cpu->cycles, 0);
+	}
+
+	_interrupt(cpu, v6502_memoryVectorNMILow, v6502_memoryVectorNMIHigh);
 }
 
 void v6502_reset(v6502_cpu *cpu) {
@@ -307,6 +375,23 @@ void v6502_step(v6502_cpu *cpu) {
 	if (instructionLength > 2) { high = v6502_read(cpu->memory, cpu->pc + 2, YES); }
 	v6502_execute(cpu, opcode, low, high);
 	cpu->pc += instructionLength;
+	cpu->cycles += _cycleTable[opcode];
+
+	if (cpu->cycles >= cpu->nextEvent) {
+		_serviceEvents(cpu);
+	}
+}
+
+unsigned long v6502_run(v6502_cpu *cpu, unsigned long budget) {
+	unsigned long executed = 0;
+
+	while (executed < budget && !(cpu->sr & v6502_cpu_status_break)) {
+		v6502_step(cpu);
+		executed++;
+	}
+
+	v6502_flushMemory(cpu->memory);
+	return executed;
 }
 
 /*
@@ -490,31 +575,34 @@ void v6502_execute(v6502_cpu *cpu, uint8_t opcode, uint8_t low, uint8_t high) {
 
 		// Stack Instructions
 		case v6502_opcode_jsr: {
-			cpu->memory->bytes[v6502_memoryStartStack + cpu->sp--] = cpu->pc;        // Low byte first
-			cpu->memory->bytes[v6502_memoryStartStack + cpu->sp--] = (cpu->pc >> 8); // High byte second
+			_push(cpu, cpu->pc);        // Low byte first
+			_push(cpu, cpu->pc >> 8);   // High byte second
 			cpu->pc = BOTH_BYTES;
 			cpu->pc -= 3; // To compensate for post execution shift
 		} return;
 		case v6502_opcode_rti: {
-			/** TODO: @todo Interrupts (RTI/RTS) */
+			cpu->sr = _pull(cpu) | v6502_cpu_status_ignored;
+			cpu->pc = (_pull(cpu) << 8);
+			cpu->pc |= _pull(cpu);
+			cpu->pc -= 1; // To compensate for post execution shift
 		} return;
 		case v6502_opcode_rts: {
-			cpu->pc = (cpu->memory->bytes[v6502_memoryStartStack + ++cpu->sp] << 8);
-			cpu->pc |= cpu->memory->bytes[v6502_memoryStartStack + ++cpu->sp];
+			cpu->pc = (_pull(cpu) << 8);
+			cpu->pc |= _pull(cpu);
 			cpu->pc += 2; // To compensate for post execution shift ( - 1 rts, + 3 jsr )
 		} return;
 		case v6502_opcode_pha: {
-			cpu->memory->bytes[v6502_memoryStartStack + cpu->sp--] = cpu->ac;
+			_push(cpu, cpu->ac);
 		} return;
 		case v6502_opcode_pla: {
-			cpu->ac = cpu->memory->bytes[v6502_memoryStartStack + ++cpu->sp];
+			cpu->ac = _pull(cpu);
 			FLAG_NEG_AND_ZERO_WITH_RESULT(cpu->ac);
 		} return;
 		case v6502_opcode_php: {
-			cpu->memory->bytes[v6502_memoryStartStack + cpu->sp--] = cpu->sr;
+			_push(cpu, cpu->sr);
 		} return;
 		case v6502_opcode_plp: {
-			cpu->sr = cpu->memory->bytes[v6502_memoryStartStack + ++cpu->sp];
+			cpu->sr = _pull(cpu);
 		} return;
 
 		// ADC
@@ -775,3 +863,131 @@ void v6502_execute(v6502_cpu *cpu, uint8_t opcode, uint8_t low, uint8_t high) {
 		} return;
 	}
 }
+
+#pragma mark -
+#pragma mark CPU Events
+
+static void _updateNextEvent(v6502_cpu *cpu) {
+	// A pending IRQ has to be checked after every instruction, until it is taken, and so does the replay log
+	if (cpu->irqLines || _replaying(cpu)) {
+		cpu->nextEvent = 0;
+	}
+	else {
+		cpu->nextEvent = cpu->eventCount ? cpu->events[0].deadline : UINT64_MAX;
+	}
+}
+
+/** Takes the interrupts that were taken by this point the first time around, and makes the writes that events made to memory, instead of asking the hardware */
+static void _replayInterrupts(v6502_cpu *cpu, v6502_replayLog *log) {
+	while (log->position < log->count) {
+		v6502_replayEntry *entry = &log->entries[log->position];
+		if (entry->type == v6502_replayEntry_read || entry->cycles > cpu->cycles) {
+			break;
+		}
+
+		log->position++;
+		if (entry->type == v6502_replayEntry_write) {
+			v6502_writeBacking(cpu->memory, entry->address, entry->value);
+		}
+		else if (entry->type == v6502_replayEntry_nmi) {
+			_interrupt(cpu, v6502_memoryVectorNMILow, v6502_memoryVectorNMIHigh);
+		}
+		else {
+			_interrupt(cpu, v6502_memoryVectorInterruptLow, v6502_memoryVectorInterruptHigh);
+		}
+	}
+}
+
+static void _serviceEvents(v6502_cpu *cpu) {
+	if (_replaying(cpu)) {
+		_replayInterrupts(cpu, cpu->memory->replayLog);
+		_updateNextEvent(cpu);
+		return;
+	}
+
+	// Whatever events write to memory is logged, so that it can be written again when replaying
+	v6502_replayLog *log = _recordingLog(cpu);
+	while (cpu->eventCount && cpu->events[0].deadline <= cpu->cycles) {
+		v6502_event event = cpu->events[0];
+		cpu->eventCount--;
+		memmove(&cpu->events[0], &cpu->events[1], sizeof(v6502_event) * cpu->eventCount);
+
+		// The callback may schedule, so the list must be consistent first
+		if (log) {
+			log->hardware++;
+			log->hardwareCycles = cpu->cycles;
+		}
+		event.callback(cpu, event.context);
+		if (log) {
+			log->hardware--;
+		}
+	}
+
+	if (cpu->irqLines && !(cpu->sr & v6502_cpu_status_interrupt)) {
+		if (log) {
+			v6502_logReplayEntry(log, v6502_replayEntry_irq, cpu->cycles, 0);
+		}
+		_interrupt(cpu, v6502_memoryVectorInterruptLow, v6502_memoryVectorInterruptHigh);
+	}
+
+	_updateNextEvent(cpu);
+}
+
+/**
+ *	Hardware rarely has more than a few events outstanding, so they are kept in
+ *	a sorted array, and the earliest deadline is cached in v6502_cpu::nextEvent.
+ */
+int v6502_schedule(v6502_cpu *cpu, uint64_t deadline, v6502_eventFunction *callback, void *context) {
+	assert(cpu && callback);
+
+	// Periodic hardware reschedules constantly, so the array only ever grows
+	if (cpu->eventCount == cpu->eventCapacity) {
+		size_t capacity = cpu->eventCapacity ? cpu->eventCapacity * 2 : 4;
+		v6502_event *events = realloc(cpu->events, sizeof(v6502_event) * capacity);
+		if (!events) {
+			return NO;
+		}
+		cpu->events = events;
+		cpu->eventCapacity = capacity;
+	}
+	v6502_event *events = cpu->events;
+
+	// Events with the same deadline run in the order they were scheduled
+	size_t index = cpu->eventCount;
+	while (index > 0 && events[index - 1].deadline > deadline) {
+		index--;
+	}
+	memmove(&events[index + 1], &events[index], sizeof(v6502_event) * (cpu->eventCount - index));
+
+	events[index].deadline = deadline;
+	events[index].callback = callback;
+	events[index].context = context;
+	cpu->eventCount++;
+
+	_updateNextEvent(cpu);
+	return YES;
+}
+
+void v6502_cancelEvents(v6502_cpu *cpu, v6502_eventFunction *callback, void *context) {
+	assert(cpu);
+
+	size_t kept = 0;
+	for (size_t i = 0; i < cpu->eventCount; i++) {
+		if (cpu->events[i].callback != callback || cpu->events[i].context != context) {
+			cpu->events[kept++] = cpu->events[i];
+		}
+	}
+	cpu->eventCount = kept;
+
+	_updateNextEvent(cpu);
+}
+
+void v6502_raiseIRQ(v6502_cpu *cpu, uint32_t lines) {
+	cpu->irqLines |= lines;
+	_updateNextEvent(cpu);
+}
+
+void v6502_clearIRQ(v6502_cpu *cpu, uint32_t lines) {
+	cpu->irqLines &= ~lines;
+	_updateNextEvent(cpu);
+}
@@ -30,9 +30,29 @@
 
 #include <v6502/mem.h>
 
+/** @cond STRUCT_FORWARD_DECLS */
+/* Forward declaration needed for circular dependency of event function and structures */
+struct _v6502_cpu;
+/** @endcond */
+
+/** @ingroup cpu_events */
+/** @brief The function prototype for events scheduled by virtual hardware (See: v6502_schedule) */
+typedef void (v6502_eventFunction)(struct _v6502_cpu *cpu, void *context);
+
 /** @struct */
-/** @brief Virtual CPU Object */
+/** @brief Scheduled Event Record */
 typedef struct {
+	/** @brief Value of v6502_cpu::cycles at or after which the event is called */
+	uint64_t deadline;
+	/** @brief Event callback */
+	v6502_eventFunction *callback;
+	/** @brief Context pointer, generally used to point to hardware data structures */
+	void *context;
+} v6502_event;
+
+/** @struct */
+/** @brief Virtual CPU Object */
+typedef struct /** @cond STRUCT_FORWARD_DECLS */ _v6502_cpu /** @endcond */ {
 	/** @brief Program counter (16-bit) */
 	uint16_t pc;
 	/** @brief Accumulator (8-bit) */
@@ -45,6 +65,18 @@ typedef struct {
 	uint8_t sr;
 	/** @brief Stack Pointer (8-bit) */
 	uint8_t sp;
+	/** @brief Number of clock cycles executed, counting the base cycles of each instruction (See: v6502_cyclesForOpcode) */
+	uint64_t cycles;
+	/** @brief Value of cycles at which v6502_step next needs to look at events or interrupts, which is the only per-instruction cost of @ref cpu_events */
+	uint64_t nextEvent;
+	/** @brief Scheduled events, sorted by deadline */
+	v6502_event *events;
+	/** @brief Number of scheduled events */
+	size_t eventCount;
+	/** @brief Number of events that fit in the events array before it has to grow */
+	size_t eventCapacity;
+	/** @brief One bit for each piece of virtual hardware currently requesting an IRQ (See: v6502_raiseIRQ) */
+	uint32_t irqLines;
 	/** @brief Virtual Memory */
 	v6502_memory *memory;
 	/** @brief Fault Callback Function */
@@ -308,6 +340,8 @@ void v6502_destroyCPU(v6502_cpu *cpu);
 int v6502_instructionLengthForOpcode(v6502_opcode opcode);
 /** @brief Return the v6502_address_mode of an instruction based on the opcode (See: @ref cpu_kmap) */
 v6502_address_mode v6502_addressModeForOpcode(v6502_opcode opcode);
+/** @brief Return the number of clock cycles an instruction takes, not counting the extra cycles for crossing a page or taking a branch */
+int v6502_cyclesForOpcode(v6502_opcode opcode);
 /** @brief Execute an instruction on a v6502_cpu. */
 /** It is important to note that this does not alter the program counter, \ref v6502_step
  is required in order for that to happen. This is because some operations (like
@@ -316,10 +350,28 @@ v6502_address_mode v6502_addressModeForOpcode(v6502_opcode opcode);
 void v6502_execute(v6502_cpu *cpu, uint8_t opcode, uint8_t low, uint8_t high);
 /** @brief Single step a v6502_cpu */
 void v6502_step(v6502_cpu *cpu);
+/** @brief Step a v6502_cpu until it executes a brk, or a given number of instructions have been executed */
+/** This is the fast way to run a v6502_cpu in batches. The break flag should be cleared before calling this, since it is how a brk is detected. At the end of the batch, any deferred memory writes are flushed (See: v6502_flushMemory). Returns the number of instructions executed. */
+unsigned long v6502_run(v6502_cpu *cpu, unsigned long budget);
 /** @brief Hardware reset a v6502_cpu */
 void v6502_reset(v6502_cpu *cpu);
 /** @brief Send an NMI to a v6502_cpu */
+/** The program counter and status register are pushed to the stack, and execution continues at the NMI vector. */
 void v6502_nmi(v6502_cpu *cpu);
 /**@}*/
 
+/** @defgroup cpu_events Events and Interrupts */
+/**@{*/
+/** @brief Schedule a callback for when a v6502_cpu has executed up to a given cycle count */
+/** Events are called between instructions by v6502_step, in deadline order, so that virtual hardware can act at a point in emulated time without being called for every instruction. A callback may schedule further events, including itself. Returns YES if the event was scheduled, and NO if it couldn't be allocated. */
+int v6502_schedule(v6502_cpu *cpu, uint64_t deadline, v6502_eventFunction *callback, void *context);
+/** @brief Remove every scheduled event with a given callback and context */
+void v6502_cancelEvents(v6502_cpu *cpu, v6502_eventFunction *callback, void *context);
+/** @brief Request an IRQ on behalf of the virtual hardware owning the given line bits */
+/** IRQs are level triggered, so the CPU keeps taking them whenever the interrupt flag is clear, until every line has been cleared with v6502_clearIRQ, usually when the interrupt handler acknowledges the hardware. */
+void v6502_raiseIRQ(v6502_cpu *cpu, uint32_t lines);
+/** @brief Withdraw an IRQ request on behalf of the virtual hardware owning the given line bits */
+void v6502_clearIRQ(v6502_cpu *cpu, uint32_t lines);
+/**@}*/
+
 #endif
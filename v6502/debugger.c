@@ -25,6 +25,7 @@
 #include <strings.h>
 #include <stdlib.h>
 #include <ctype.h> // isdigit
+#include <assert.h>
 #include <as6502/linectl.h>
 #include <as6502/parser.h>
 #include <dis6502/reverse.h>
@@ -32,9 +33,20 @@
 #include "debugger.h"
 #include "log.h"
 #include "breakpoint.h"
+#include "plugin.h"
+#include "history.h"
+#include "search.h"
+#include "ppu.h"
 
 #define DISASSEMBLY_COUNT		10
 #define MAX_ARG_LEN				23
+#define MAX_COMMAND_LEN			17
+/** Letters, and the hyphen */
+#define TRIE_ALPHABET			27
+#define MAX_TRIE_NODES			256
+/** Most addresses a search or track lists */
+#define MAX_LISTED_ADDRESSES	64
+#define MAX_IMAGE_SIZE			0x10000
 
 #define XSTRINGIFY(a)			# a
 #define STRINGIFY(a)			XSTRINGIFY(a)
@@ -42,36 +54,51 @@
 #define regeq(a, b)	(!strncasecmp(a, b, sizeof(a)))
 
 #define DEBUGGER_COMMAND_LIST(_) \
-	_(breakpoint,  "<addr>",         "Toggles a breakpoint at the specified address. If no address is spefied, lists all breakpoints.") \
+	_(breakpoint,  "<addr>",         "Toggles a breakpoint at the specified address. Following the address with 'if <condition>', such as 'if a == $10 && mem[$0200] > 3', sets a breakpoint that only stops when the condition is true. If no address is spefied, lists all breakpoints.") \
 	_(cpu,         NULL,             "Displays the current state of the CPU.") \
 	_(disassemble, "<addr>",         "Disassemble " STRINGIFY(DISASSEMBLY_COUNT) " instructions starting at a given address, or the program counter if no address is specified.") \
+	_(device,      "<file> <args>",  "Load a device plugin, passing it any arguments given. If no file is specified, lists all devices.") \
+	_(dump,        "<addr> <n> <file>", "Dumps n bytes of memory starting at the address, or all of it from the address on if n is 0 or not specified. The bytes are written raw to the file, or as a hex dump if its name ends in .hex. If no file is specified, the hex dump is printed.") \
 	_(help,        NULL,             "Displays this help.") \
 	_(iv,          "<type> <addr>",  "Sets the interrupt vector of the type specified (of nmi, reset, interrupt) to the given address. If no address is specified, then the vector value is output.") \
+	_(ignore,      "<addr> <count>", "Passes over the breakpoint at the specified address the given number of times before stopping at it again.") \
 	_(label,       "<name> <addr>",  "Define a new label for automatic symbolication during disassembly.") \
 	_(load,        "<file> <addr>",  "Load binary image into memory at the address specified. If no address is specified, then the reset vector is used.") \
 	_(nmi,         NULL,             "Sends a non-maskable interrupt to the CPU.") \
 	_(peek,        "<addr>",         "Dumps the memory at and around a given address.") \
 	_(poke,        "<addr> <value>", "Sets the location in memory to the value specified.") \
+	_(pause,       NULL,             "Stops the CPU when it is running in the background, and returns to the prompt.") \
+	_(ppu,         "<chr> <nt> <file>", "Renders the nametable at the nt address, using a pattern table of CHR data at the chr address, to a PPM image file. Memory is read as it is stored, so mapped hardware isn't disturbed.") \
 	_(quit,        NULL,             "Exits v6502.") \
 	_(run,         NULL,             "Contunuously steps the cpu until a 'brk' instruction is encountered.") \
 	_(register,    "<reg> <value>",  "Sets the value of the specified register.") \
 	_(reset,       NULL,             "Resets the CPU.") \
+	_(reverse_continue, NULL,        "Runs the CPU backwards until it reaches a breakpoint, or the start of its recorded history.") \
+	_(reverse_step, NULL,            "Steps the CPU back one instruction.") \
+	_(restore,     "<file> <addr>",  "Writes a file made by dump back into memory at the address specified. If no address is specified, then hex dumps go back where they were dumped from, and raw images go to 0.") \
 	_(mreset,      NULL,             "Zeroes all memory.") \
 	_(script,      NULL,             "Load a script of debugger commands.") \
+	_(search,      "<bytes>",        "Searches memory for a pattern of hex bytes, such as 'a9 ?? 8d', where ?? matches any byte.") \
 	_(step,        NULL,             "Forcibly steps the CPU once.") \
-	_(symbols,     NULL,             "Print the entire symbol table as it currently exists.") \
+	_(symbols,     "<file>",         "Loads a binary symbol file, as written by as6502 -y or dis6502 -y, replacing any loaded before. If no file is specified, then the entire symbol table is printed as it currently exists.") \
+	_(track,       "<rule> <value>", "Narrows down the addresses whose values follow a rule since the last track, where the rule is one of changed, unchanged, increased, decreased, or equal followed by a value. 'track start' begins again with every address, 'track stop' forgets them, and no rule lists the addresses left.") \
 	_(var,         "<name> <addr>",  "Define a new variable for automatic symbolication during disassembly.") \
 	_(verbose,     NULL,             "Toggle verbose mode; prints each instruction as they are executed when running.")
 
+/* Names in DEBUGGER_COMMAND_LIST are identifiers, so hyphens are spelled as
+ * underscores there, and put back by _spellDebuggerCommands.
+ */
 #define CMD_ARRAY_MEMBER(cmd, args, help) XSTRINGIFY(cmd),
-static const char *_debuggerCommands[] = {
+static char _debuggerCommands[][MAX_COMMAND_LEN] = {
 	DEBUGGER_COMMAND_LIST(CMD_ARRAY_MEMBER)
 };
 
 #define CMD_ENUM_MEMBER(cmd, args, help) v6502_debuggerCommand_ ## cmd,
 typedef enum {
 	DEBUGGER_COMMAND_LIST(CMD_ENUM_MEMBER)
-	v6502_debuggerCommand_NONE
+	v6502_debuggerCommand_NONE,
+	// jmp is a special override, which comes before every listed command, and isn't in help
+	v6502_debuggerCommand_jmp
 } v6502_debuggerCommand;
 
 #define ARGS_ARRAY_MEMBER(cmd, args, help) args,
@@ -84,13 +111,78 @@ static const char *_debuggerHelp[] = {
 	DEBUGGER_COMMAND_LIST(HELP_ARRAY_MEMBER)
 };
 
-static v6502_debuggerCommand v6502_debuggerCommandParse(const char *command, size_t len) {
+/* A command matches any prefix of its name, and the first command in
+ * DEBUGGER_COMMAND_LIST wins when a prefix is shared, so each node of the trie
+ * keeps the first command below it. Parsing is then one step per character
+ * typed, rather than a comparison against every name.
+ */
+typedef struct {
+	uint8_t first;
+	uint8_t children[TRIE_ALPHABET];
+} _commandTrieNode;
+
+static _commandTrieNode _commandTrie[MAX_TRIE_NODES];
+
+/** Addresses being narrowed down by the track command, which is allocated by 'track start' */
+static search_tracker *_tracker;
+
+static int _trieIndex(char c) {
+	if (c >= 'a' && c <= 'z') {
+		return c - 'a';
+	}
+	return c == '-' ? TRIE_ALPHABET - 1 : -1;
+}
+
+static void _spellDebuggerCommands(void) {
+	static int spelled;
+	if (spelled) {
+		return;
+	}
+
+	int nodes = 1;
 	for (int i = 0; i < v6502_debuggerCommand_NONE; i++) {
-		if (v6502_compareDebuggerCommand(command, len, _debuggerCommands[i])) {
-			return i;
+		int node = 0;
+		for (char *c = _debuggerCommands[i]; *c; c++) {
+			if (*c == '_') {
+				*c = '-';
+			}
+
+			int index = _trieIndex(*c);
+			assert(index >= 0);
+			if (!_commandTrie[node].children[index]) {
+				assert(nodes < MAX_TRIE_NODES);
+				_commandTrie[nodes].first = i;
+				_commandTrie[node].children[index] = nodes++;
+			}
+			node = _commandTrie[node].children[index];
+		}
+	}
+	spelled = YES;
+}
+
+static v6502_debuggerCommand v6502_debuggerCommandParse(const char *command, size_t len) {
+	if (v6502_compareDebuggerCommand(command, len, "jmp")) {
+		return v6502_debuggerCommand_jmp;
+	}
+
+	_spellDebuggerCommands();
+	int node = 0;
+	for (size_t i = 0; i < len && command[i] && !isspace(CTYPE_CAST command[i]); i++) {
+		int index = _trieIndex(command[i]);
+		if (index < 0 || !_commandTrie[node].children[index]) {
+			return v6502_debuggerCommand_NONE;
 		}
+		node = _commandTrie[node].children[index];
+	}
+	return _commandTrie[node].first;
+}
+
+const char *v6502_debuggerCommandName(const char *command, size_t len) {
+	v6502_debuggerCommand cmd = v6502_debuggerCommandParse(command, len);
+	if (cmd >= v6502_debuggerCommand_NONE) {
+		return NULL;
 	}
-	return v6502_debuggerCommand_NONE;
+	return _debuggerCommands[cmd];
 }
 
 int v6502_loadFileAtAddress(v6502_memory *mem, const char *fname, uint16_t address) {
@@ -101,27 +193,26 @@ int v6502_loadFileAtAddress(v6502_memory *mem, const char *fname, uint16_t addre
 		return NO;
 	}
 
-	uint8_t byte;
-	uint16_t offset = 0;
-
-	while (fread(&byte, 1, 1, f)) {
-		mem->bytes[address + (offset++)] = byte;
-	}
-
-	fprintf(stderr, "Loaded %u bytes at %#x.\n", offset, address);
-
+	// Read the whole image, so that identical pages can be shared
+	uint8_t image[0x10000];
+	size_t size = fread(image, 1, sizeof(image) - address, f);
 	fclose(f);
 
+	size = v6502_loadBytesIntoMemory(mem, image, size, address);
+	fprintf(stderr, "Loaded %zu bytes at %#x.\n", size, address);
+
 	return YES;
 }
 
-void v6502_runDebuggerScript(v6502_cpu *cpu, FILE *file, v6502_breakpoint_list *breakpoint_list, as6502_symbol_table *table, v6502_debuggerRunCallback runCallback, int *verbose) {
-	char *line = NULL;
-	size_t cap = 0;
-	ssize_t len;
-	while ((len = getline(&line, &cap, file)) > 0) {
-		v6502_handleDebuggerCommand(cpu, line, len, breakpoint_list, table, runCallback, verbose);
+void v6502_runDebuggerScript(v6502_cpu *cpu, FILE *file, v6502_breakpoint_list *breakpoint_list, as6502_symbol_table *table, v6502_history *history, v6502_debuggerRunCallback runCallback, int *verbose) {
+	v6502_debuggerScript *script = v6502_compileDebuggerScript(file);
+	if (!script) {
+		fprintf(stderr, "Could not read debugger script!\n");
+		return;
 	}
+
+	v6502_runCompiledDebuggerScript(cpu, script, breakpoint_list, table, history, runCallback, verbose);
+	v6502_destroyDebuggerScript(script);
 }
 
 static void _makeSymbolOfType(const char *command, size_t len, as6502_symbol_table *table, as6502_symbol_type symbolType) {
@@ -138,18 +229,29 @@ static void _makeSymbolOfType(const char *command, size_t len, as6502_symbol_tab
 	free(name);
 }
 
-int v6502_compareDebuggerCommand(const char *command, size_t len, const char *literal) {
-	char *cmd = strndup(command, len);
+/** Dumps are hex if their file name ends in .hex, and raw otherwise */
+static int _isHexDumpName(const char *filename) {
+	size_t length = strlen(filename);
+	return length >= 4 && !strcasecmp(filename + length - 4, ".hex");
+}
 
-	trimgreedytaild(cmd, len);
+/** Lists addresses eight to a line, and how many more there were than could be listed */
+static void _printAddresses(const size_t *addresses, size_t listed, size_t total) {
+	for (size_t i = 0; i < listed; i++) {
+		printf("0x%04zx%c", addresses[i], (i % 8 == 7 || i == listed - 1) ? '\n' : ' ');
+	}
+	if (total > listed) {
+		printf("...and %zu more.\n", total - listed);
+	}
+}
 
-	for (size_t i = 0; i < len && cmd[i]; i++) {
-		if (cmd[i] != literal[i]) {
-			free(cmd);
+int v6502_compareDebuggerCommand(const char *command, size_t len, const char *literal) {
+	// Only the first word counts, and it only has to be the start of the literal
+	for (size_t i = 0; i < len && command[i] && !isspace(CTYPE_CAST command[i]); i++) {
+		if (command[i] != literal[i]) {
 			return NO;
 		}
 	}
-	free(cmd);
 	return YES;
 }
 
@@ -157,6 +259,7 @@ unsigned char v6502_completeDebuggerCommand(EditLine *e, int ch) {
 	const LineInfo *lineInfo = el_line(e);
 	size_t len = lineInfo->cursor - lineInfo->buffer;
 	int multiMatch = NO;
+	_spellDebuggerCommands();
 
 	// Find how many possible matches there are
 	int matches = 0;
@@ -191,27 +294,23 @@ unsigned char v6502_completeDebuggerCommand(EditLine *e, int ch) {
 	return CC_REFRESH;
 }
 
-/** Returns YES if handled */
-int v6502_handleDebuggerCommand(v6502_cpu *cpu, char *command, size_t len, v6502_breakpoint_list *breakpoint_list, as6502_symbol_table *table, v6502_debuggerRunCallback runCallback, int *verbose) {
+/** Runs a command that has already been parsed, returning YES if there was one */
+static int _runDebuggerCommand(v6502_debuggerCommand cmd, v6502_cpu *cpu, char *command, size_t len, v6502_breakpoint_list *breakpoint_list, as6502_symbol_table *table, v6502_history *history, v6502_debuggerRunCallback runCallback, int *verbose) {
 	// Make a backup for length calculation
 	const char *_command = command;
 
-	// jmp is a special override
-	if (v6502_compareDebuggerCommand(command, len, "jmp")) {
-		command = trimheadtospc(command, len);
-		command++;
-
-		uint16_t address = as6502_valueForString(NULL, command, len - (_command - command));
-		cpu->pc = address;
-
-		return YES;
-	}
+	switch (cmd) {
+		case v6502_debuggerCommand_jmp: {
+			command = trimheadtospc(command, len);
+			command++;
 
-	v6502_debuggerCommand cmd = v6502_debuggerCommandParse(command, len);
+			uint16_t address = as6502_valueForString(NULL, command, len - (_command - command));
+			cpu->pc = address;
 
-	switch (cmd) {
+			return YES;
+		}
 		case v6502_debuggerCommand_help: {
-			for (size_t i = 0; i < (sizeof(_debuggerCommands) / sizeof(const char *)); i++) {
+			for (int i = 0; i < v6502_debuggerCommand_NONE; i++) {
 				if (_debuggerCommandArguments[i]) {
 					char concat[MAX_ARG_LEN];
 					snprintf(concat, MAX_ARG_LEN, "%s %s", _debuggerCommands[i], _debuggerCommandArguments[i]);
@@ -231,16 +330,37 @@ int v6502_handleDebuggerCommand(v6502_cpu *cpu, char *command, size_t len, v6502
 				// Get address
 				uint16_t address;
 
+				// Anything after "if" is a condition, which is compiled now, rather than parsed at every hit
+				v6502_condition *condition = NULL;
+				char *conditionText = strstr(command, " if ");
+				if (conditionText) {
+					*conditionText = '\0';
+					conditionText += 4;
+					trimgreedytailchard(conditionText, '\n');
+
+					const char *error = NULL;
+					condition = v6502_compileCondition(conditionText, table, &error);
+					if (!condition) {
+						printf("Invalid condition: %s.\n", error);
+						return YES;
+					}
+				}
+
 				// Direct address or symbol name
 				if (isdigit(command[0]) || command[0] == '$') {
-					address = as6502_valueForString(NULL, command, len - (_command - command));
+					address = as6502_valueForString(NULL, command, strlen(command));
 				}
 				else {
 					address = as6502_addressForSymbolByName(table, command);
 				}
 
-				// Toggle breakpoint
-				if (v6502_breakpointIsInList(breakpoint_list, address)) {
+				// A condition is added to a breakpoint, rather than toggling it
+				if (condition) {
+					v6502_addBreakpointToList(breakpoint_list, address);
+					v6502_setBreakpointCondition(breakpoint_list, address, condition);
+					printf("Added breakpoint 0x%04x, if %s.\n", address, condition->source);
+				}
+				else if (v6502_breakpointIsInList(breakpoint_list, address)) {
 					v6502_removeBreakpointFromList(breakpoint_list, address);
 					printf("Removed breakpoint %#04x.\n", address);
 				}
@@ -255,6 +375,38 @@ int v6502_handleDebuggerCommand(v6502_cpu *cpu, char *command, size_t len, v6502
 
 			return YES;
 		}
+		case v6502_debuggerCommand_ignore: {
+			command = trimheadtospc(command, len);
+
+			if (!command[0]) {
+				printf("You must specify a breakpoint address.\n");
+				return YES;
+			}
+			command++;
+
+			uint16_t address;
+			if (isdigit(command[0]) || command[0] == '$') {
+				address = as6502_valueForString(NULL, command, len - (_command - command));
+			}
+			else {
+				size_t sLen = strnspc(command, len - (_command - command)) - command;
+				char *name = strndup(command, sLen);
+				address = as6502_addressForSymbolByName(table, name);
+				free(name);
+			}
+
+			v6502_breakpoint *breakpoint = v6502_breakpointAtAddress(breakpoint_list, address);
+			if (!breakpoint) {
+				printf("There is no breakpoint at %#04x.\n", address);
+				return YES;
+			}
+
+			command = trimheadtospc(command, len);
+			breakpoint->ignoreCount = command[0] ? strtoul(command + 1, NULL, 10) : 0;
+			printf("Will ignore breakpoint %#04x %lu time%s.\n", address, breakpoint->ignoreCount, breakpoint->ignoreCount == 1 ? "" : "s");
+
+			return YES;
+		}
 		case v6502_debuggerCommand_cpu: {
 			v6502_printCpuState(stderr, cpu);
 			return YES;
@@ -263,6 +415,11 @@ int v6502_handleDebuggerCommand(v6502_cpu *cpu, char *command, size_t len, v6502
 			v6502_nmi(cpu);
 			return YES;
 		}
+		case v6502_debuggerCommand_pause: {
+			// Only the prompt can reach a CPU running in the background, so everything else finds it stopped
+			printf("The CPU isn't running.\n");
+			return YES;
+		}
 		case v6502_debuggerCommand_iv: {
 			command = trimheadtospc(command, len);
 			command++;
@@ -341,6 +498,228 @@ int v6502_handleDebuggerCommand(v6502_cpu *cpu, char *command, size_t len, v6502
 
 			return YES;
 		}
+		case v6502_debuggerCommand_device: {
+			command = trimheadtospc(command, len);
+
+			if (!command[0]) {
+				v6502_printDevices(cpu);
+				return YES;
+			}
+			// Bump past space
+			command++;
+
+			size_t fLen = strnspc(command, len - (_command - command)) - command;
+			char *filename = strndup(command, fLen);
+
+			// Everything after the filename belongs to the device
+			command = trimheadtospc(command, len);
+			char *args = NULL;
+			if (command[0]) {
+				// Scripts leave the newline on
+				args = strdup(command + 1);
+				trimgreedytailchard(args, '\n');
+			}
+
+			v6502_device *device = v6502_loadDevice(cpu, filename, args);
+			if (device) {
+				printf("Attached %s.\n", device->descriptor->name ? device->descriptor->name : filename);
+			}
+
+			free(args);
+			free(filename);
+			return YES;
+		}
+		case v6502_debuggerCommand_dump: {
+			command = trimheadtospc(command, len);
+			if (!command[0]) {
+				printf("You must specify an address to dump from.\n");
+				return YES;
+			}
+			command++;
+			uint16_t start = as6502_valueForString(NULL, command, len - (_command - command));
+
+			// Zero, or no length at all, dumps to the top of memory
+			size_t length = 0;
+			command = trimheadtospc(command, len);
+			if (command[0]) {
+				command++;
+				length = as6502_valueForString(NULL, command, len - (_command - command));
+				command = trimheadtospc(command, len);
+			}
+			if (start >= cpu->memory->size) {
+				printf("0x%04x is beyond the end of memory.\n", start);
+				return YES;
+			}
+			if (!length || length > cpu->memory->size - start) {
+				length = cpu->memory->size - start;
+			}
+
+			char *filename = NULL;
+			if (command[0]) {
+				command++;
+				size_t fLen = strnspc(command, len - (_command - command)) - command;
+				if (fLen) {
+					filename = strndup(command, fLen);
+					if (!filename) {
+						printf("Could not allocate the file name!\n");
+						return YES;
+					}
+				}
+			}
+
+			// Dumps look at what is stored, so mapped hardware isn't disturbed
+			uint8_t *bytes = malloc(length);
+			if (!bytes) {
+				printf("Could not allocate %zu bytes to dump!\n", length);
+				free(filename);
+				return YES;
+			}
+			length = v6502_readBackingBytes(cpu->memory, start, bytes, length);
+
+			if (!filename) {
+				v6502_printMemoryBytes(stdout, start, bytes, length);
+			}
+			else {
+				FILE *file = fopen(filename, "w");
+				if (!file) {
+					printf("Could not open \"%s\" for writing!\n", filename);
+				}
+				else {
+					if (_isHexDumpName(filename)) {
+						v6502_printMemoryBytes(file, start, bytes, length);
+					}
+					else {
+						fwrite(bytes, 1, length, file);
+					}
+					if (fclose(file)) {
+						printf("Could not write \"%s\"!\n", filename);
+					}
+					else {
+						printf("Dumped %zu bytes from 0x%04x to \"%s\".\n", length, start, filename);
+					}
+				}
+			}
+
+			free(filename);
+			free(bytes);
+			return YES;
+		}
+		case v6502_debuggerCommand_restore: {
+			command = trimheadtospc(command, len);
+			if (!command[0]) {
+				printf("You must specify a file to restore.\n");
+				return YES;
+			}
+			command++;
+
+			size_t fLen = strnspc(command, len - (_command - command)) - command;
+			char *filename = strndup(command, fLen);
+			if (!filename) {
+				printf("Could not allocate the file name!\n");
+				return YES;
+			}
+
+			int hasAddress = NO;
+			uint16_t address = 0;
+			command = trimheadtospc(command, len);
+			if (command[0] && command[1] && !isspace(CTYPE_CAST command[1])) {
+				command++;
+				address = as6502_valueForString(NULL, command, len - (_command - command));
+				hasAddress = YES;
+			}
+
+			FILE *file = fopen(filename, "r");
+			if (!file) {
+				printf("Could not open \"%s\" for reading!\n", filename);
+				free(filename);
+				return YES;
+			}
+
+			uint8_t *bytes = calloc(1, MAX_IMAGE_SIZE);
+			if (!bytes) {
+				printf("Could not allocate memory to restore \"%s\" into!\n", filename);
+				fclose(file);
+				free(filename);
+				return YES;
+			}
+			size_t length;
+			if (_isHexDumpName(filename)) {
+				uint16_t dumped;
+				length = v6502_scanMemoryBytes(file, &dumped, bytes);
+				if (!hasAddress) {
+					address = dumped;
+				}
+			}
+			else {
+				length = fread(bytes, 1, MAX_IMAGE_SIZE, file);
+			}
+			fclose(file);
+
+			size_t restored = address < cpu->memory->size ? v6502_writeBackingBytes(cpu->memory, address, bytes, length < cpu->memory->size - address ? length : cpu->memory->size - address) : 0;
+			printf("Restored %zu bytes to 0x%04x from \"%s\".\n", restored, address, filename);
+			if (restored < length) {
+				printf("The other %zu bytes didn't fit in memory.\n", length - restored);
+			}
+
+			free(bytes);
+			free(filename);
+			return YES;
+		}
+		case v6502_debuggerCommand_ppu: {
+			command = trimheadtospc(command, len);
+			if (!command[0]) {
+				printf("You must specify where the CHR data is.\n");
+				return YES;
+			}
+			command++;
+			uint16_t chr = as6502_valueForString(NULL, command, len - (_command - command));
+
+			command = trimheadtospc(command, len);
+			if (!command[0]) {
+				printf("You must specify where the nametable is.\n");
+				return YES;
+			}
+			command++;
+			uint16_t nametable = as6502_valueForString(NULL, command, len - (_command - command));
+
+			command = trimheadtospc(command, len);
+			if (!command[0]) {
+				printf("You must specify a file to render to.\n");
+				return YES;
+			}
+			command++;
+			size_t fLen = strnspc(command, len - (_command - command)) - command;
+			char *filename = strndup(command, fLen);
+
+			// One pattern table, or as much of it as there is below the top of memory
+			uint8_t tiles[ppu_tilesPerTable * ppu_bytesPerTile];
+			size_t size = v6502_readBackingBytes(cpu->memory, chr, tiles, sizeof(tiles));
+			v6502_ppu *ppu = ppu_create(cpu->memory, nametable, tiles, size);
+			if (!ppu) {
+				printf("There isn't a whole tile at 0x%04x.\n", chr);
+				free(filename);
+				return YES;
+			}
+			ppu_renderBackground(ppu);
+
+			FILE *file = fopen(filename, "w");
+			if (!file) {
+				printf("Could not open \"%s\" for writing!\n", filename);
+			}
+			else {
+				int written = ppu_writeImage(ppu, file);
+				if (fclose(file) || !written) {
+					printf("Could not write \"%s\"!\n", filename);
+				}
+				else {
+					printf("Rendered the nametable at 0x%04x with %zu tiles from 0x%04x to \"%s\".\n", nametable, ppu->tileCount, chr, filename);
+				}
+			}
+
+			ppu_destroy(ppu);
+			free(filename);
+			return YES;
+		}
 		case v6502_debuggerCommand_label: {
 			if (!table) {
 				return YES;
@@ -362,6 +741,31 @@ int v6502_handleDebuggerCommand(v6502_cpu *cpu, char *command, size_t len, v6502
 		case v6502_debuggerCommand_step: {
 			dis6502_printAnnotatedInstruction(stderr, cpu, cpu->pc, table);
 			v6502_step(cpu);
+			if (history) {
+				v6502_recordHistory(history, 1);
+			}
+			return YES;
+		}
+		case v6502_debuggerCommand_reverse_step: {
+			if (!history) {
+				printf("No history is being recorded.\n");
+			}
+			else if (!v6502_reverseStep(history)) {
+				printf("Reached the start of history.\n");
+			}
+			dis6502_printAnnotatedInstruction(stderr, cpu, cpu->pc, table);
+			return YES;
+		}
+		case v6502_debuggerCommand_reverse_continue: {
+			if (!history) {
+				printf("No history is being recorded.\n");
+			}
+			else if (v6502_reverseContinue(history, breakpoint_list)) {
+				printf("Hit breakpoint at %#02x.\n", cpu->pc);
+			}
+			else {
+				printf("Reached the start of history.\n");
+			}
 			return YES;
 		}
 		case v6502_debuggerCommand_disassemble: {
@@ -410,14 +814,136 @@ int v6502_handleDebuggerCommand(v6502_cpu *cpu, char *command, size_t len, v6502
 			filename[fLen] = '\0';
 
 			FILE *file = fopen(filename, "r");
+			if (!file) {
+				printf("Could not open \"%s\" for reading!\n", filename);
+				free(filename);
+				return YES;
+			}
 			free(filename);
-			v6502_runDebuggerScript(cpu, file, breakpoint_list, table, runCallback, verbose);
+			v6502_runDebuggerScript(cpu, file, breakpoint_list, table, history, runCallback, verbose);
 			fclose(file);
 
 			return YES;
 		}
 		case v6502_debuggerCommand_symbols: {
-			as6502_printSymbolTable(table);
+			command = trimheadtospc(command, len);
+
+			if (!command[0]) {
+				as6502_printSymbolTable(table);
+				return YES;
+			}
+			// Bump past space
+			command++;
+
+			size_t fLen = strnspc(command, len - (_command - command)) - command;
+			char *filename = malloc(fLen + 1);
+			memcpy(filename, command, fLen);
+			filename[fLen] = '\0';
+
+			if (as6502_loadSymbolFile(table, filename)) {
+				printf("Loaded %zu symbols from \"%s\".\n", table->file_count, filename);
+			}
+			else {
+				printf("Could not load \"%s\" as a symbol file!\n", filename);
+			}
+			free(filename);
+
+			return YES;
+		}
+		case v6502_debuggerCommand_search: {
+			search_pattern pattern;
+			command = trimheadtospc(command, len);
+			if (!search_parsePattern(command, &pattern)) {
+				printf("Invalid pattern; give up to %d hex bytes, or ?? for any byte.\n", search_maxPatternLength);
+				return YES;
+			}
+
+			// Searching looks at what is stored, so mapped hardware isn't disturbed
+			uint8_t image[search_trackedSize];
+			size_t size = v6502_readBackingBytes(cpu->memory, 0, image, sizeof(image));
+
+			size_t matches[MAX_LISTED_ADDRESSES];
+			size_t count = search_findPattern(image, size, &pattern, matches, MAX_LISTED_ADDRESSES);
+			printf("Found %zu match%s.\n", count, count == 1 ? "" : "es");
+			_printAddresses(matches, count < MAX_LISTED_ADDRESSES ? count : MAX_LISTED_ADDRESSES, count);
+			return YES;
+		}
+		case v6502_debuggerCommand_track: {
+			command = trimheadtospc(command, len);
+			while (isspace(CTYPE_CAST *command)) {
+				command++;
+			}
+
+			uint8_t image[search_trackedSize];
+			v6502_readBackingBytes(cpu->memory, 0, image, sizeof(image));
+
+			if (!strncmp(command, "stop", 4)) {
+				v6502_destroyDebuggerState();
+				printf("Stopped tracking.\n");
+				return YES;
+			}
+
+			if (!strncmp(command, "start", 5)) {
+				if (!_tracker) {
+					_tracker = malloc(sizeof(search_tracker));
+				}
+				if (_tracker) {
+					search_startTracking(_tracker, image);
+					printf("Tracking %zu addresses.\n", _tracker->count);
+				}
+				return YES;
+			}
+
+			if (!_tracker) {
+				printf("Nothing is being tracked; use 'track start' first.\n");
+				return YES;
+			}
+
+			if (command[0]) {
+				search_rule rule;
+				uint8_t value = 0;
+				if (!strncmp(command, "changed", 7)) {
+					rule = search_rule_changed;
+				}
+				else if (!strncmp(command, "unchanged", 9)) {
+					rule = search_rule_unchanged;
+				}
+				else if (!strncmp(command, "increased", 9)) {
+					rule = search_rule_increased;
+				}
+				else if (!strncmp(command, "decreased", 9)) {
+					rule = search_rule_decreased;
+				}
+				else if (!strncmp(command, "equal", 5)) {
+					rule = search_rule_equal;
+					command = trimheadtospc(command, len - (command - _command));
+					if (!command[0]) {
+						printf("You must specify a value to compare with.\n");
+						return YES;
+					}
+					command++;
+					value = as6502_valueForString(NULL, command, len - (command - _command));
+				}
+				else {
+					printf("Unknown rule; use changed, unchanged, increased, decreased, or equal.\n");
+					return YES;
+				}
+
+				search_filter(_tracker, image, rule, value);
+				printf("%zu address%s left.\n", _tracker->count, _tracker->count == 1 ? "" : "es");
+			}
+
+			// Listing is only worth it once there are few enough to look through
+			if (!command[0] || _tracker->count <= MAX_LISTED_ADDRESSES) {
+				size_t addresses[MAX_LISTED_ADDRESSES];
+				size_t listed = 0;
+				for (size_t i = 0; i < search_trackedSize && listed < MAX_LISTED_ADDRESSES; i++) {
+					if (_tracker->candidates[i]) {
+						addresses[listed++] = i;
+					}
+				}
+				_printAddresses(addresses, listed, _tracker->count);
+			}
 			return YES;
 		}
 		case v6502_debuggerCommand_peek: {
@@ -463,6 +989,7 @@ int v6502_handleDebuggerCommand(v6502_cpu *cpu, char *command, size_t len, v6502
 		}
 		// TODO: jmp
 		case v6502_debuggerCommand_quit: {
+			v6502_destroyDebuggerState();
 			v6502_destroyMemory(cpu->memory);
 			v6502_destroyCPU(cpu);
 
@@ -475,6 +1002,7 @@ int v6502_handleDebuggerCommand(v6502_cpu *cpu, char *command, size_t len, v6502
 		}
 		case v6502_debuggerCommand_reset: {
 			v6502_reset(cpu);
+			v6502_resetDevices(cpu);
 			return YES;
 		}
 		case v6502_debuggerCommand_register: {
@@ -532,7 +1060,7 @@ int v6502_handleDebuggerCommand(v6502_cpu *cpu, char *command, size_t len, v6502
 			return YES;
 		}
 		case v6502_debuggerCommand_mreset: {
-			memset(cpu->memory->bytes, 0, cpu->memory->size * sizeof(uint8_t));
+			v6502_clearMemory(cpu->memory);
 			return YES;
 		}
 		case v6502_debuggerCommand_verbose: {
@@ -544,3 +1072,110 @@ int v6502_handleDebuggerCommand(v6502_cpu *cpu, char *command, size_t len, v6502
 			return NO;
 	}
 }
+
+/** Returns YES if handled */
+int v6502_handleDebuggerCommand(v6502_cpu *cpu, char *command, size_t len, v6502_breakpoint_list *breakpoint_list, as6502_symbol_table *table, v6502_history *history, v6502_debuggerRunCallback runCallback, int *verbose) {
+	return _runDebuggerCommand(v6502_debuggerCommandParse(command, len), cpu, command, len, breakpoint_list, table, history, runCallback, verbose);
+}
+
+/**
+ *	Lines are split in place in one copy of the whole file, so compiling costs
+ *	two allocations no matter how long the script is. Blank lines, and lines
+ *	that aren't commands, are dropped, since running them did nothing.
+ */
+v6502_debuggerScript *v6502_compileDebuggerScript(FILE *file) {
+	assert(file);
+
+	v6502_debuggerScript *script = calloc(1, sizeof(v6502_debuggerScript));
+	if (!script) {
+		return NULL;
+	}
+
+	// Scripts can come from pipes, so the size isn't known up front
+	size_t capacity = 0;
+	for (;;) {
+		if (script->size == capacity) {
+			capacity = capacity ? capacity * 2 : 4096;
+			char *text = realloc(script->text, capacity);
+			if (!text) {
+				v6502_destroyDebuggerScript(script);
+				return NULL;
+			}
+			script->text = text;
+		}
+
+		size_t read = fread(script->text + script->size, 1, capacity - script->size, file);
+		if (!read) {
+			break;
+		}
+		script->size += read;
+	}
+
+	size_t lineCapacity = 0;
+	for (size_t start = 0; start < script->size;) {
+		const char *newline = memchr(script->text + start, '\n', script->size - start);
+		size_t length = newline ? (size_t)(newline - (script->text + start)) : script->size - start;
+		const char *line = script->text + start;
+
+		v6502_debuggerCommand cmd = v6502_debuggerCommand_NONE;
+		if (length && !isspace(CTYPE_CAST line[0])) {
+			cmd = v6502_debuggerCommandParse(line, length);
+		}
+
+		if (cmd != v6502_debuggerCommand_NONE) {
+			if (script->count == lineCapacity) {
+				lineCapacity = lineCapacity ? lineCapacity * 2 : 256;
+				v6502_debuggerScriptLine *lines = realloc(script->lines, lineCapacity * sizeof(v6502_debuggerScriptLine));
+				if (!lines) {
+					v6502_destroyDebuggerScript(script);
+					return NULL;
+				}
+				script->lines = lines;
+			}
+
+			script->lines[script->count++] = (v6502_debuggerScriptLine){ cmd, start, length };
+			if (length > script->longest) {
+				script->longest = length;
+			}
+		}
+
+		start += length + 1;
+	}
+
+	script->scratch = malloc(script->longest + 1);
+	if (!script->scratch) {
+		v6502_destroyDebuggerScript(script);
+		return NULL;
+	}
+
+	return script;
+}
+
+void v6502_destroyDebuggerScript(v6502_debuggerScript *script) {
+	if (!script) {
+		return;
+	}
+
+	free(script->scratch);
+	free(script->lines);
+	free(script->text);
+	free(script);
+}
+
+void v6502_destroyDebuggerState(void) {
+	free(_tracker);
+	_tracker = NULL;
+}
+
+void v6502_runCompiledDebuggerScript(v6502_cpu *cpu, v6502_debuggerScript *script, v6502_breakpoint_list *breakpoint_list, as6502_symbol_table *table, v6502_history *history, v6502_debuggerRunCallback runCallback, int *verbose) {
+	assert(script);
+
+	for (size_t i = 0; i < script->count; i++) {
+		const v6502_debuggerScriptLine *line = &script->lines[i];
+
+		// Some commands cut up the line they are given, so each run works on a copy, terminated as if it came from the prompt
+		memcpy(script->scratch, script->text + line->start, line->length);
+		script->scratch[line->length] = '\0';
+		_runDebuggerCommand(line->command, cpu, script->scratch, line->length + 1, breakpoint_list, table, history, runCallback, verbose);
+	}
+}
@@ -28,6 +28,7 @@
 
 #include <v6502/cpu.h>
 #include <v6502/breakpoint.h>
+#include <v6502/history.h>
 #include <histedit.h>
 
 /** @defgroup debugger Interactive Debugger */
@@ -35,20 +36,69 @@
 /** @brief This callback is used when v6502_handleDebuggerCommand recieves a run command */
 typedef void(v6502_debuggerRunCallback)(v6502_cpu *cpu);
 
+/** @struct */
+/** @brief A Line of a Compiled Debugger Script */
+typedef struct {
+	/** @brief Which command the line is, as parsed when the script was compiled */
+	int command;
+	/** @brief Offset of the line in v6502_debuggerScript::text */
+	size_t start;
+	/** @brief Byte-length of the line, without its newline */
+	size_t length;
+} v6502_debuggerScriptLine;
+
+/** @struct */
+/** @brief A Compiled Debugger Script */
+/** A script is read and parsed once, so that running it, however many times, doesn't look up any command names or allocate anything. */
+typedef struct {
+	/** @brief Every byte of the script */
+	char *text;
+	/** @brief Byte-length of v6502_debuggerScript::text */
+	size_t size;
+	/** @brief Lines that are commands, in order */
+	v6502_debuggerScriptLine *lines;
+	/** @brief Number of lines in v6502_debuggerScript::lines */
+	size_t count;
+	/** @brief Byte-length of the longest line */
+	size_t longest;
+	/** @brief Where each line is copied while it runs, since commands can write to their line */
+	char *scratch;
+} v6502_debuggerScript;
+
 /** @brief Loads the binary data from file at fname into memory mem at given starting address */
 int v6502_loadFileAtAddress(v6502_memory *mem, const char *fname, uint16_t address);
 /** @brief Runs all debugger commands contained in a FILE pointer */
 void v6502_runDebuggerScript(v6502_cpu *cpu, FILE *file,
                              v6502_breakpoint_list *breakpoint_list,
                              as6502_symbol_table *table,
+                             v6502_history *history,
                              v6502_debuggerRunCallback runCallback,
                              int *verbose);
-/** @brief This is the exact function used by v6502_handleDebuggerCommand to do fuzzy string comparisons. It is exposed for extending the debugger to support other commands outside the v6502_handleDebuggerCommand function. */
+/** @brief Reads and parses a script of debugger commands from a FILE pointer, returning NULL if allocation fails */
+v6502_debuggerScript *v6502_compileDebuggerScript(FILE *file);
+/** @brief Destroys a compiled debugger script */
+void v6502_destroyDebuggerScript(v6502_debuggerScript *script);
+/** @brief Frees what debugger commands keep between calls, such as the addresses being tracked */
+void v6502_destroyDebuggerState(void);
+/** @brief Runs every command in a compiled debugger script */
+void v6502_runCompiledDebuggerScript(v6502_cpu *cpu, v6502_debuggerScript *script,
+                                     v6502_breakpoint_list *breakpoint_list,
+                                     as6502_symbol_table *table,
+                                     v6502_history *history,
+                                     v6502_debuggerRunCallback runCallback,
+                                     int *verbose);
+/** @brief Whether the first word of a command is the start of a literal command name, which is how the debugger matches abbreviated commands */
+/** v6502_handleDebuggerCommand doesn't call this for its own commands, which it looks up a character at a time in a trie built by the same rule, with the first listed command winning when a prefix is shared. This is for extending the debugger to support other commands outside the v6502_handleDebuggerCommand function, and for arguments like interrupt types. */
 int v6502_compareDebuggerCommand(const char * command, size_t len, const char * literal);
+/** @brief The full name of the command that the first word of a line is taken as, the way v6502_handleDebuggerCommand parses it, or NULL if it isn't one */
+/** This is for front ends that handle some commands themselves, such as pause, so that they are abbreviated the same way as the rest. Hyphenated names are returned with their hyphens. */
+const char *v6502_debuggerCommandName(const char *command, size_t len);
 /** @brief Handle a command given by an external debugger line editor on a given v6502_cpu */
+/** Steps are recorded in history, which can be NULL, and the reverse-step and reverse-continue commands go back through it. */
 int v6502_handleDebuggerCommand(v6502_cpu *cpu, char *command, size_t len,
                                 v6502_breakpoint_list *breakpoint_list,
                                 as6502_symbol_table *table,
+                                v6502_history *history,
                                 v6502_debuggerRunCallback runCallback,
                                 int *verbose);
 /** @brief An editline compatible function for tab-completion */
@@ -0,0 +1,716 @@
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <assert.h>
+
+#include "gdbstub.h"
+
+/** Number of registers, in the order they appear in a 'g' packet */
+#define gdbStub_registerCount		6
+
+static const char _targetDescription[] =
+	"<?xml version=\"1.0\"?>"
+	"<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+	"<target version=\"1.0\">"
+	"<feature name=\"org.v6502.cpu\">"
+	"<reg name=\"a\" bitsize=\"8\" type=\"uint8\" regnum=\"0\"/>"
+	"<reg name=\"x\" bitsize=\"8\" type=\"uint8\"/>"
+	"<reg name=\"y\" bitsize=\"8\" type=\"uint8\"/>"
+	"<reg name=\"sp\" bitsize=\"8\" type=\"uint8\"/>"
+	"<reg name=\"sr\" bitsize=\"8\" type=\"uint8\"/>"
+	"<reg name=\"pc\" bitsize=\"16\" type=\"code_ptr\"/>"
+	"</feature>"
+	"</target>";
+
+static const char _hexDigits[] = "0123456789abcdef";
+
+#pragma mark Sockets
+
+int gdbStub_listen(const char *address) {
+	int fd;
+	const char *colon = strrchr(address, ':');
+
+	if (colon) {
+		struct sockaddr_in in = { .sin_family = AF_INET };
+		in.sin_port = htons((uint16_t)strtoul(colon + 1, NULL, 10));
+		in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		int reuse = 1;
+		if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) || bind(fd, (struct sockaddr *)&in, sizeof(in))) {
+			goto fail;
+		}
+	}
+	else {
+		struct sockaddr_un un = { .sun_family = AF_UNIX };
+		if (strlen(address) >= sizeof(un.sun_path)) {
+			return -1;
+		}
+		strcpy(un.sun_path, address);
+		unlink(address);
+
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0 || bind(fd, (struct sockaddr *)&un, sizeof(un))) {
+			goto fail;
+		}
+	}
+
+	if (listen(fd, 1)) {
+		goto fail;
+	}
+	return fd;
+
+fail:
+	if (fd >= 0) {
+		close(fd);
+	}
+	return -1;
+}
+
+#pragma mark - Packets
+
+/** Returns the next byte from the debugger, or -1 if it has gone */
+static int _readByte(v6502_gdbStub *stub) {
+	if (stub->inputStart == stub->inputEnd) {
+		ssize_t length;
+		do {
+			length = read(stub->fd, stub->input, sizeof(stub->input));
+		} while (length < 0 && errno == EINTR);
+
+		if (length <= 0) {
+			return -1;
+		}
+		stub->inputStart = 0;
+		stub->inputEnd = length;
+	}
+
+	return stub->input[stub->inputStart++];
+}
+
+static int _writeAll(int fd, const char *bytes, size_t length) {
+	while (length) {
+		ssize_t written = write(fd, bytes, length);
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+		if (written <= 0) {
+			return NO;
+		}
+		bytes += written;
+		length -= written;
+	}
+	return YES;
+}
+
+/** Sends a packet, without waiting for an acknowledgement, since a reliable stream doesn't need retransmission */
+static int _sendPacket(v6502_gdbStub *stub, const char *payload, size_t length) {
+	char *packet = malloc(length + 4);
+	if (!packet) {
+		return NO;
+	}
+
+	uint8_t checksum = 0;
+	packet[0] = '$';
+	for (size_t i = 0; i < length; i++) {
+		packet[i + 1] = payload[i];
+		checksum += (uint8_t)payload[i];
+	}
+	packet[length + 1] = '#';
+	packet[length + 2] = _hexDigits[checksum >> 4];
+	packet[length + 3] = _hexDigits[checksum & 0x0F];
+
+	int sent = _writeAll(stub->fd, packet, length + 4);
+	free(packet);
+	return sent;
+}
+
+static int _sendString(v6502_gdbStub *stub, const char *payload) {
+	return _sendPacket(stub, payload, strlen(payload));
+}
+
+static int _hexValue(int c) {
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+/**
+ *	Reads the next packet into buffer, skipping acknowledgements, and returns
+ *	its length. Returns -1 if the debugger has gone, and 0 with buffer holding
+ *	a single 0x03 if it sent an interrupt outside of a packet.
+ */
+static ssize_t _readPacket(v6502_gdbStub *stub, char *buffer, size_t size) {
+	for (;;) {
+		int c = _readByte(stub);
+		if (c < 0) {
+			return -1;
+		}
+		if (c == 0x03) {
+			buffer[0] = 0x03;
+			return 0;
+		}
+		if (c != '$') {
+			continue;
+		}
+
+		size_t length = 0;
+		uint8_t checksum = 0;
+		while ((c = _readByte(stub)) >= 0 && c != '#') {
+			// Packets that don't fit are truncated, and fail the checksum
+			if (length < size - 1) {
+				buffer[length++] = (char)c;
+			}
+			checksum += (uint8_t)c;
+		}
+
+		int high = _readByte(stub);
+		int low = _readByte(stub);
+		if (c < 0 || high < 0 || low < 0) {
+			return -1;
+		}
+
+		int valid = (_hexValue(high) << 4 | _hexValue(low)) == checksum;
+		if (!stub->noAck) {
+			_writeAll(stub->fd, valid ? "+" : "-", 1);
+		}
+		if (valid) {
+			buffer[length] = '\0';
+			return length;
+		}
+	}
+}
+
+/** Parses a hex number, leaving cursor after it */
+static unsigned long _parseHex(const char **cursor) {
+	unsigned long value = 0;
+	int digit;
+	while ((digit = _hexValue(**cursor)) >= 0) {
+		value = (value << 4) | digit;
+		(*cursor)++;
+	}
+	return value;
+}
+
+static void _appendHexByte(char *out, uint8_t byte) {
+	out[0] = _hexDigits[byte >> 4];
+	out[1] = _hexDigits[byte & 0x0F];
+}
+
+#pragma mark - Registers
+
+static unsigned _registerSize(int reg) {
+	return reg == 5 ? 2 : 1;
+}
+
+static uint16_t _readRegister(v6502_cpu *cpu, int reg) {
+	switch (reg) {
+		case 0: return cpu->ac;
+		case 1: return cpu->x;
+		case 2: return cpu->y;
+		case 3: return cpu->sp;
+		case 4: return cpu->sr;
+		default: return cpu->pc;
+	}
+}
+
+static void _writeRegister(v6502_cpu *cpu, int reg, uint16_t value) {
+	switch (reg) {
+		case 0: cpu->ac = (uint8_t)value; break;
+		case 1: cpu->x = (uint8_t)value; break;
+		case 2: cpu->y = (uint8_t)value; break;
+		case 3: cpu->sp = (uint8_t)value; break;
+		case 4: cpu->sr = (uint8_t)value; break;
+		default: cpu->pc = value; break;
+	}
+}
+
+/** Appends a register in target byte order, which is little endian */
+static size_t _appendRegister(char *out, v6502_cpu *cpu, int reg) {
+	uint16_t value = _readRegister(cpu, reg);
+	for (unsigned i = 0; i < _registerSize(reg); i++) {
+		_appendHexByte(out + (i * 2), (uint8_t)(value >> (i * 8)));
+	}
+	return _registerSize(reg) * 2;
+}
+
+/** Parses two hex digits, returning NO if either isn't one */
+static int _parseHexByte(const char **cursor, uint8_t *byte) {
+	int high = _hexValue((*cursor)[0]);
+	int low = high < 0 ? -1 : _hexValue((*cursor)[1]);
+	if (low < 0) {
+		return NO;
+	}
+
+	*byte = (uint8_t)((high << 4) | low);
+	*cursor += 2;
+	return YES;
+}
+
+/** Parses a register in target byte order, returning NO if there aren't enough digits */
+static int _parseRegister(const char **cursor, v6502_cpu *cpu, int reg) {
+	uint16_t value = 0;
+	for (unsigned i = 0; i < _registerSize(reg); i++) {
+		uint8_t byte;
+		if (!_parseHexByte(cursor, &byte)) {
+			return NO;
+		}
+		value |= (uint16_t)byte << (i * 8);
+	}
+	_writeRegister(cpu, reg, value);
+	return YES;
+}
+
+#pragma mark - Watchpoints
+
+static int _hasWatchpoints(v6502_gdbStub *stub) {
+	for (int i = 0; i < gdbStub_watchpointCount; i++) {
+		if (stub->watchpoints[i].length) {
+			return YES;
+		}
+	}
+	return NO;
+}
+
+/** Returns the address of the first watched byte that changed, or -1, and remembers the new values */
+static long _checkWatchpoints(v6502_gdbStub *stub) {
+	long changed = -1;
+
+	for (int i = 0; i < gdbStub_watchpointCount; i++) {
+		gdbStub_watchpoint *watch = &stub->watchpoints[i];
+		for (size_t j = 0; j < watch->length; j++) {
+			uint8_t value = v6502_read(stub->cpu->memory, (uint16_t)(watch->address + j), NO);
+			if (value != watch->values[j]) {
+				watch->values[j] = value;
+				if (changed < 0) {
+					changed = (uint16_t)(watch->address + j);
+				}
+			}
+		}
+	}
+
+	return changed;
+}
+
+static int _setWatchpoint(v6502_gdbStub *stub, uint16_t address, size_t length) {
+	if (!length || length > gdbStub_watchpointLength) {
+		return NO;
+	}
+
+	for (int i = 0; i < gdbStub_watchpointCount; i++) {
+		gdbStub_watchpoint *watch = &stub->watchpoints[i];
+		if (!watch->length) {
+			watch->address = address;
+			watch->length = length;
+			for (size_t j = 0; j < length; j++) {
+				watch->values[j] = v6502_read(stub->cpu->memory, (uint16_t)(address + j), NO);
+			}
+			return YES;
+		}
+	}
+	return NO;
+}
+
+static int _removeWatchpoint(v6502_gdbStub *stub, uint16_t address, size_t length) {
+	for (int i = 0; i < gdbStub_watchpointCount; i++) {
+		gdbStub_watchpoint *watch = &stub->watchpoints[i];
+		if (watch->length == length && watch->address == address) {
+			watch->length = 0;
+			return YES;
+		}
+	}
+	return NO;
+}
+
+#pragma mark - Execution
+
+/** Returns YES if the debugger has sent an interrupt, without waiting for one */
+static int _interrupted(v6502_gdbStub *stub) {
+	if (stub->inputStart == stub->inputEnd) {
+		struct pollfd pfd = { .fd = stub->fd, .events = POLLIN };
+		if (poll(&pfd, 1, 0) <= 0) {
+			return NO;
+		}
+	}
+
+	// Anything but an interrupt while running is out of turn, so it is dropped
+	int c = _readByte(stub);
+	return c == 0x03 || c < 0;
+}
+
+/** Steps once, and reports why the CPU should stop, if it should, in reply */
+static int _stepAndCheck(v6502_gdbStub *stub, char *reply) {
+	v6502_cpu *cpu = stub->cpu;
+
+	v6502_step(cpu);
+
+	long watched = _checkWatchpoints(stub);
+	if (watched >= 0) {
+		sprintf(reply, "T05watch:%04lx;", watched);
+		return YES;
+	}
+	if (cpu->sr & v6502_cpu_status_break) {
+		strcpy(reply, "S05");
+		return YES;
+	}
+	if (v6502_breakpointIsInList(stub->breakpoints, cpu->pc) && v6502_hitBreakpoint(stub->breakpoints, cpu)) {
+		strcpy(reply, "S05");
+		return YES;
+	}
+	return NO;
+}
+
+static void _continue(v6502_gdbStub *stub, char *reply) {
+	v6502_cpu *cpu = stub->cpu;
+	cpu->sr &= ~v6502_cpu_status_break;
+
+	// Leave the breakpoint being continued from without stopping at it again
+	if (_stepAndCheck(stub, reply)) {
+		v6502_flushMemory(cpu->memory);
+		return;
+	}
+
+	for (;;) {
+		if (!stub->breakpoints->count && !_hasWatchpoints(stub)) {
+			v6502_run(cpu, gdbStub_runBudget);
+			if (cpu->sr & v6502_cpu_status_break) {
+				strcpy(reply, "S05");
+				return;
+			}
+		}
+		else {
+			for (unsigned long i = 0; i < gdbStub_runBudget; i++) {
+				if (_stepAndCheck(stub, reply)) {
+					v6502_flushMemory(cpu->memory);
+					return;
+				}
+			}
+			v6502_flushMemory(cpu->memory);
+		}
+
+		if (stub->batchCallback) {
+			stub->batchCallback(cpu);
+		}
+
+		if (_interrupted(stub)) {
+			strcpy(reply, "S02");
+			return;
+		}
+	}
+}
+
+#pragma mark - Commands
+
+/** Handles a breakpoint or watchpoint packet, which is Z or z, then type,address,kind */
+static void _handleStopPoint(v6502_gdbStub *stub, const char *packet, char *reply) {
+	int insert = packet[0] == 'Z';
+	const char *cursor = packet + 1;
+	unsigned long type = _parseHex(&cursor);
+	if (*cursor++ != ',') {
+		strcpy(reply, "E01");
+		return;
+	}
+	uint16_t address = (uint16_t)_parseHex(&cursor);
+	if (*cursor++ != ',') {
+		strcpy(reply, "E01");
+		return;
+	}
+	size_t kind = _parseHex(&cursor);
+
+	switch (type) {
+		// Software and hardware breakpoints are the same thing here
+		case 0:
+		case 1:
+			if (insert) {
+				v6502_addBreakpointToList(stub->breakpoints, address);
+			}
+			else {
+				v6502_removeBreakpointFromList(stub->breakpoints, address);
+			}
+			strcpy(reply, "OK");
+			return;
+		case 2:
+			strcpy(reply, (insert ? _setWatchpoint(stub, address, kind) : _removeWatchpoint(stub, address, kind)) ? "OK" : "E02");
+			return;
+		default:
+			// Read and access watchpoints are unsupported
+			reply[0] = '\0';
+			return;
+	}
+}
+
+static void _handleQuery(v6502_gdbStub *stub, const char *packet, char *reply) {
+	static const char features[] = "qXfer:features:read:target.xml:";
+
+	if (!strncmp(packet, "qSupported", 10)) {
+		sprintf(reply, "PacketSize=%x;qXfer:features:read+;QStartNoAckMode+", gdbStub_packetSize);
+	}
+	else if (!strcmp(packet, "qAttached")) {
+		strcpy(reply, "1");
+	}
+	else if (!strcmp(packet, "qC")) {
+		strcpy(reply, "QC1");
+	}
+	else if (!strcmp(packet, "qfThreadInfo")) {
+		strcpy(reply, "m1");
+	}
+	else if (!strcmp(packet, "qsThreadInfo")) {
+		strcpy(reply, "l");
+	}
+	else if (!strncmp(packet, features, sizeof(features) - 1)) {
+		const char *cursor = packet + sizeof(features) - 1;
+		size_t offset = _parseHex(&cursor);
+		cursor++;
+		size_t length = _parseHex(&cursor);
+
+		size_t total = sizeof(_targetDescription) - 1;
+		if (offset >= total) {
+			strcpy(reply, "l");
+			return;
+		}
+		if (length > gdbStub_packetSize - 2) {
+			length = gdbStub_packetSize - 2;
+		}
+		size_t remaining = total - offset;
+		size_t chunk = remaining < length ? remaining : length;
+		reply[0] = chunk == remaining ? 'l' : 'm';
+		memcpy(reply + 1, _targetDescription + offset, chunk);
+		reply[chunk + 1] = '\0';
+	}
+	else {
+		reply[0] = '\0';
+	}
+}
+
+/** Handles one packet, writing the reply into reply, and returns NO when the session is over */
+static int _handlePacket(v6502_gdbStub *stub, const char *packet, char *reply, int *killed) {
+	v6502_cpu *cpu = stub->cpu;
+	const char *cursor = packet + 1;
+	reply[0] = '\0';
+
+	switch (packet[0]) {
+		case '?':
+			strcpy(reply, "S05");
+			break;
+		case 'g': {
+			size_t length = 0;
+			for (int reg = 0; reg < gdbStub_registerCount; reg++) {
+				length += _appendRegister(reply + length, cpu, reg);
+			}
+			reply[length] = '\0';
+		} break;
+		case 'G': {
+			int ok = YES;
+			for (int reg = 0; reg < gdbStub_registerCount && ok; reg++) {
+				ok = _parseRegister(&cursor, cpu, reg);
+			}
+			strcpy(reply, ok ? "OK" : "E01");
+		} break;
+		case 'p': {
+			unsigned long reg = _parseHex(&cursor);
+			if (reg >= gdbStub_registerCount) {
+				strcpy(reply, "E01");
+				break;
+			}
+			reply[_appendRegister(reply, cpu, (int)reg)] = '\0';
+		} break;
+		case 'P': {
+			unsigned long reg = _parseHex(&cursor);
+			if (reg >= gdbStub_registerCount || *cursor++ != '=' || !_parseRegister(&cursor, cpu, (int)reg)) {
+				strcpy(reply, "E01");
+				break;
+			}
+			strcpy(reply, "OK");
+		} break;
+		case 'm': {
+			uint16_t address = (uint16_t)_parseHex(&cursor);
+			if (*cursor++ != ',') {
+				strcpy(reply, "E01");
+				break;
+			}
+			size_t length = _parseHex(&cursor);
+			if (length > (gdbStub_packetSize - 1) / 2) {
+				length = (gdbStub_packetSize - 1) / 2;
+			}
+
+			// The debugger looking at memory mustn't disturb any hardware mapped there
+			for (size_t i = 0; i < length; i++) {
+				_appendHexByte(reply + (i * 2), v6502_read(cpu->memory, (uint16_t)(address + i), NO));
+			}
+			reply[length * 2] = '\0';
+		} break;
+		case 'M': {
+			uint16_t address = (uint16_t)_parseHex(&cursor);
+			if (*cursor++ != ',') {
+				strcpy(reply, "E01");
+				break;
+			}
+			size_t length = _parseHex(&cursor);
+			if (*cursor++ != ':' || strlen(cursor) < length * 2) {
+				strcpy(reply, "E01");
+				break;
+			}
+
+			// Nothing is written unless every byte is valid
+			const char *bytes = cursor;
+			size_t valid = 0;
+			for (uint8_t byte; valid < length && _parseHexByte(&cursor, &byte); valid++);
+			if (valid < length) {
+				strcpy(reply, "E01");
+				break;
+			}
+
+			for (size_t i = 0; i < length; i++) {
+				uint8_t byte;
+				_parseHexByte(&bytes, &byte);
+				v6502_write(cpu->memory, (uint16_t)(address + i), byte);
+			}
+			v6502_flushMemory(cpu->memory);
+
+			// Writes by the debugger aren't changes to report
+			_checkWatchpoints(stub);
+			strcpy(reply, "OK");
+		} break;
+		case 'c':
+			if (*cursor) {
+				cpu->pc = (uint16_t)_parseHex(&cursor);
+			}
+			_continue(stub, reply);
+			break;
+		case 's': {
+			if (*cursor) {
+				cpu->pc = (uint16_t)_parseHex(&cursor);
+			}
+			cpu->sr &= ~v6502_cpu_status_break;
+			v6502_step(cpu);
+			v6502_flushMemory(cpu->memory);
+
+			// Stepping stops anyway, but the debugger still wants to know about the watchpoint
+			long watched = _checkWatchpoints(stub);
+			if (watched >= 0) {
+				sprintf(reply, "T05watch:%04lx;", watched);
+			}
+			else {
+				strcpy(reply, "S05");
+			}
+		} break;
+		case 'Z':
+		case 'z':
+			_handleStopPoint(stub, packet, reply);
+			break;
+		case 'H':
+			strcpy(reply, "OK");
+			break;
+		case 'T':
+			strcpy(reply, "OK");
+			break;
+		case 'q':
+			_handleQuery(stub, packet, reply);
+			break;
+		case 'Q':
+			if (!strcmp(packet, "QStartNoAckMode")) {
+				_sendString(stub, "OK");
+				stub->noAck = YES;
+				return YES;
+			}
+			break;
+		case 'D':
+			_sendString(stub, "OK");
+			return NO;
+		case 'k':
+			*killed = YES;
+			return NO;
+		default:
+			// An empty reply means the packet isn't supported
+			break;
+	}
+
+	_sendString(stub, reply);
+	return YES;
+}
+
+#pragma mark - Lifecycle
+
+v6502_gdbStub *gdbStub_create(v6502_cpu *cpu, v6502_breakpoint_list *breakpoints) {
+	assert(cpu && breakpoints);
+
+	v6502_gdbStub *stub = calloc(1, sizeof(v6502_gdbStub));
+	if (!stub) {
+		return NULL;
+	}
+
+	stub->cpu = cpu;
+	stub->breakpoints = breakpoints;
+	stub->fd = -1;
+	return stub;
+}
+
+void gdbStub_destroy(v6502_gdbStub *stub) {
+	free(stub);
+}
+
+int gdbStub_serve(v6502_gdbStub *stub, int fd) {
+	assert(stub && fd >= 0);
+
+	stub->fd = fd;
+	stub->noAck = NO;
+	stub->inputStart = stub->inputEnd = 0;
+
+	char *packet = malloc(gdbStub_packetSize);
+	char *reply = malloc(gdbStub_packetSize);
+	int killed = NO;
+
+	if (packet && reply) {
+		ssize_t length;
+		while ((length = _readPacket(stub, packet, gdbStub_packetSize)) >= 0) {
+			// An interrupt while stopped has nothing to interrupt, but still gets a stop reply
+			if (!length && packet[0] == 0x03) {
+				_sendString(stub, "S02");
+				continue;
+			}
+			if (!_handlePacket(stub, packet, reply, &killed)) {
+				break;
+			}
+		}
+	}
+
+	free(packet);
+	free(reply);
+	stub->fd = -1;
+	return killed;
+}
@@ -0,0 +1,97 @@
+/** @brief GDB Remote Serial Protocol Stub */
+/** @file gdbstub.h */
+
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef v6502_gdbstub_h
+#define v6502_gdbstub_h
+
+#include <v6502/cpu.h>
+#include <v6502/breakpoint.h>
+
+/** @brief Largest packet the stub accepts, in bytes */
+#define gdbStub_packetSize			0x1000
+/** @brief Number of watchpoints that can be set at once */
+#define gdbStub_watchpointCount		8
+/** @brief Largest range one watchpoint can cover, in bytes */
+#define gdbStub_watchpointLength	16
+/** @brief Instructions run between checks for an interrupt from the debugger */
+#define gdbStub_runBudget			10000
+
+/** The stub serves one debugger at a time, over a connected socket. The registers are a, x, y, sp and sr (8 bits each), then pc (16 bits, little endian), which is described to the debugger in target.xml.
+
+	Breakpoints set by the debugger go in the same v6502_breakpoint_list as those set at the v6502 prompt, so they honor ignore counts and conditions. Write watchpoints are supported, and stop after the instruction that changes a watched byte. Read and access watchpoints aren't, since reads can't be watched without slowing every one down.
+
+	While the CPU is continuing with no breakpoints or watchpoints, it runs in v6502_run, and the connection is only checked for an interrupt between batches.
+ */
+
+/** @defgroup gdbstub GDB Remote Stub */
+/**@{*/
+/** @brief Called after every batch of instructions while continuing, so that devices can catch up */
+typedef void (gdbStub_batchFunction)(v6502_cpu *cpu);
+
+/** @struct */
+/** @brief A Watched Range of Memory */
+typedef struct {
+	/** @brief First address watched */
+	uint16_t address;
+	/** @brief Number of bytes watched, or 0 if the watchpoint isn't in use */
+	size_t length;
+	/** @brief What the bytes held when last checked */
+	uint8_t values[gdbStub_watchpointLength];
+} gdbStub_watchpoint;
+
+/** @struct */
+/** @brief GDB Remote Stub Object */
+typedef struct {
+	/** @brief The v6502_cpu being debugged */
+	v6502_cpu *cpu;
+	/** @brief Where the debugger's breakpoints go */
+	v6502_breakpoint_list *breakpoints;
+	/** @brief Called after every batch of instructions while continuing, or NULL */
+	gdbStub_batchFunction *batchCallback;
+	/** @brief Write watchpoints */
+	gdbStub_watchpoint watchpoints[gdbStub_watchpointCount];
+	/** @brief Connected socket, or -1 between sessions */
+	int fd;
+	/** @brief Whether the debugger turned acknowledgements off */
+	int noAck;
+	/** @brief Bytes received, but not yet parsed */
+	uint8_t input[gdbStub_packetSize];
+	/** @brief Offset of the next unparsed byte in gdbStub::input */
+	size_t inputStart;
+	/** @brief Number of bytes in gdbStub::input */
+	size_t inputEnd;
+} v6502_gdbStub;
+
+/** @brief Open a socket for a debugger to connect to, returning its descriptor, or -1 on failure */
+/** An address containing a colon, like ":2159" or "localhost:2159", is a TCP port, which only listens on the loopback interface. Anything else is the path of a Unix socket, which is replaced if it exists. */
+int gdbStub_listen(const char *address);
+/** @brief Create a v6502_gdbStub for a v6502_cpu, using a v6502_breakpoint_list for the debugger's breakpoints */
+v6502_gdbStub *gdbStub_create(v6502_cpu *cpu, v6502_breakpoint_list *breakpoints);
+/** @brief Destroy a v6502_gdbStub */
+void gdbStub_destroy(v6502_gdbStub *stub);
+/** @brief Serve a debugger on a connected socket until it detaches or disconnects, returning YES if it asked to kill the program */
+int gdbStub_serve(v6502_gdbStub *stub, int fd);
+/**@}*/
+
+#endif
@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "history.h"
+
+#pragma mark Snapshots
+
+static void _dropOldestSnapshot(v6502_history *history) {
+	v6502_destroyMemorySnapshot(history->cpu->memory, history->snapshots[0].memory);
+	v6502_destroyDeviceSnapshot(history->snapshots[0].devices);
+	history->snapshotCount--;
+	memmove(&history->snapshots[0], &history->snapshots[1], sizeof(history_snapshot) * history->snapshotCount);
+
+	// Nothing can replay from before the oldest snapshot anymore, so that much of the log can go
+	v6502_replayLog *log = history->log;
+	size_t unused = history->snapshots[0].logPosition;
+	memmove(log->entries, log->entries + unused, sizeof(v6502_replayEntry) * (log->count - unused));
+	log->count -= unused;
+	log->position -= unused;
+	for (size_t i = 0; i < history->snapshotCount; i++) {
+		history->snapshots[i].logPosition -= unused;
+	}
+}
+
+static void _takeSnapshot(v6502_history *history) {
+	v6502_cpu *cpu = history->cpu;
+
+	if (history->snapshotCount == history_maxSnapshots) {
+		_dropOldestSnapshot(history);
+	}
+
+	v6502_memorySnapshot *memory = v6502_snapshotMemory(cpu->memory);
+	if (!memory) {
+		return;
+	}
+
+	v6502_deviceSnapshot *devices = v6502_snapshotDevices(cpu);
+	if (!devices) {
+		v6502_destroyMemorySnapshot(cpu->memory, memory);
+		return;
+	}
+
+	history_snapshot *snapshot = &history->snapshots[history->snapshotCount++];
+	snapshot->memory = memory;
+	snapshot->devices = devices;
+	snapshot->pc = cpu->pc;
+	snapshot->ac = cpu->ac;
+	snapshot->x = cpu->x;
+	snapshot->y = cpu->y;
+	snapshot->sr = cpu->sr;
+	snapshot->sp = cpu->sp;
+	snapshot->cycles = cpu->cycles;
+	snapshot->instruction = history->instruction;
+	snapshot->logPosition = history->log->count;
+}
+
+/** Puts the CPU, memory and devices back to a snapshot, forgetting every newer one */
+static void _restoreSnapshot(v6502_history *history, size_t index) {
+	v6502_cpu *cpu = history->cpu;
+	history_snapshot *snapshot = &history->snapshots[index];
+
+	v6502_restoreMemorySnapshot(cpu->memory, snapshot->memory);
+	while (history->snapshotCount > index + 1) {
+		v6502_destroyDeviceSnapshot(history->snapshots[--history->snapshotCount].devices);
+	}
+
+	cpu->pc = snapshot->pc;
+	cpu->ac = snapshot->ac;
+	cpu->x = snapshot->x;
+	cpu->y = snapshot->y;
+	cpu->sr = snapshot->sr;
+	cpu->sp = snapshot->sp;
+	cpu->cycles = snapshot->cycles;
+	history->instruction = snapshot->instruction;
+	history->log->position = snapshot->logPosition;
+
+	// Last, so that devices scheduling their events again see the cycle count they were saved at
+	v6502_restoreDevices(cpu, snapshot->devices);
+}
+
+#pragma mark - Replay
+
+static int _stopsAtBreakpoint(v6502_breakpoint_list *breakpoints, v6502_cpu *cpu) {
+	if (!v6502_breakpointIsInList(breakpoints, cpu->pc)) {
+		return NO;
+	}
+
+	v6502_breakpoint *breakpoint = v6502_breakpointAtAddress(breakpoints, cpu->pc);
+	return !breakpoint->condition || v6502_evaluateCondition(breakpoint->condition, cpu);
+}
+
+/**
+ *	Replays from the last restored snapshot up to an instruction, and returns
+ *	the last instruction before it at which the CPU was at a breakpoint, or -1.
+ */
+static int64_t _replay(v6502_history *history, uint64_t target, v6502_breakpoint_list *breakpoints) {
+	v6502_cpu *cpu = history->cpu;
+	int64_t hit = -1;
+
+	history->log->replaying = YES;
+
+	// The CPU has to look at the log for interrupts after every instruction
+	cpu->nextEvent = 0;
+
+	while (history->instruction < target) {
+		if (breakpoints && _stopsAtBreakpoint(breakpoints, cpu)) {
+			hit = (int64_t)history->instruction;
+		}
+		v6502_step(cpu);
+		history->instruction++;
+	}
+
+	history->log->replaying = NO;
+	cpu->nextEvent = 0;
+	v6502_flushMemory(cpu->memory);
+	return hit;
+}
+
+/** Whatever happened after this point is forgotten, and recording carries on from here */
+static void _forgetFuture(v6502_history *history) {
+	history->log->count = history->log->position;
+}
+
+#pragma mark - Public API
+
+/**
+ *	If there are allocation problems, v6502_createHistory will return NULL.
+ */
+v6502_history *v6502_createHistory(v6502_cpu *cpu, unsigned long interval) {
+	assert(cpu && cpu->memory && !cpu->memory->replayLog && interval);
+
+	v6502_history *history = calloc(1, sizeof(v6502_history));
+	if (!history) {
+		return NULL;
+	}
+
+	history->log = v6502_createReplayLog();
+	if (!history->log) {
+		free(history);
+		return NULL;
+	}
+
+	history->cpu = cpu;
+	history->interval = interval;
+	cpu->memory->replayLog = history->log;
+
+	_takeSnapshot(history);
+	return history;
+}
+
+void v6502_destroyHistory(v6502_history *history) {
+	if (!history) {
+		return;
+	}
+
+	// Oldest first, so that no pages are handed down to snapshots that are about to go too
+	v6502_memory *memory = history->cpu->memory;
+	for (size_t i = 0; i < history->snapshotCount; i++) {
+		v6502_destroyMemorySnapshot(memory, history->snapshots[i].memory);
+		v6502_destroyDeviceSnapshot(history->snapshots[i].devices);
+	}
+
+	memory->replayLog = NULL;
+	v6502_destroyReplayLog(history->log);
+	free(history);
+}
+
+void v6502_recordHistory(v6502_history *history, unsigned long executed) {
+	assert(history);
+
+	history->instruction += executed;
+
+	if (!history->snapshotCount || history->instruction - history->snapshots[history->snapshotCount - 1].instruction >= history->interval) {
+		_takeSnapshot(history);
+	}
+}
+
+void v6502_markHistory(v6502_history *history) {
+	assert(history);
+
+	// A snapshot of the same instruction would never be restored, so it is replaced
+	if (history->snapshotCount && history->snapshots[history->snapshotCount - 1].instruction == history->instruction) {
+		history_snapshot *replaced = &history->snapshots[--history->snapshotCount];
+		v6502_destroyMemorySnapshot(history->cpu->memory, replaced->memory);
+		v6502_destroyDeviceSnapshot(replaced->devices);
+	}
+
+	_takeSnapshot(history);
+}
+
+int v6502_reverseStep(v6502_history *history) {
+	assert(history);
+
+	if (!history->snapshotCount || history->instruction <= history->snapshots[0].instruction) {
+		return NO;
+	}
+
+	uint64_t target = history->instruction - 1;
+	size_t index = history->snapshotCount - 1;
+	while (history->snapshots[index].instruction > target) {
+		index--;
+	}
+
+	_restoreSnapshot(history, index);
+	_replay(history, target, NULL);
+	_forgetFuture(history);
+	return YES;
+}
+
+int v6502_reverseContinue(v6502_history *history, v6502_breakpoint_list *breakpoints) {
+	assert(history && breakpoints);
+
+	if (!history->snapshotCount) {
+		return NO;
+	}
+
+	// Each stretch between snapshots is searched, newest first, for the last breakpoint before where the search started
+	uint64_t end = history->instruction;
+	for (size_t index = history->snapshotCount; index-- > 0;) {
+		if (history->snapshots[index].instruction >= end) {
+			continue;
+		}
+
+		_restoreSnapshot(history, index);
+		int64_t hit = _replay(history, end, breakpoints);
+		if (hit >= 0) {
+			_restoreSnapshot(history, index);
+			_replay(history, (uint64_t)hit, NULL);
+			_forgetFuture(history);
+			return YES;
+		}
+		end = history->snapshots[index].instruction;
+	}
+
+	_restoreSnapshot(history, 0);
+	_forgetFuture(history);
+	return NO;
+}
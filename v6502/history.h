@@ -0,0 +1,106 @@
+/** @brief Reverse Execution */
+/** @file history.h */
+
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef v6502_history_h
+#define v6502_history_h
+
+#include <v6502/cpu.h>
+#include <v6502/breakpoint.h>
+#include <v6502/plugin.h>
+
+/** @brief Default number of instructions between snapshots */
+#define history_defaultInterval		10000
+/** @brief Most snapshots kept, after which the oldest is dropped */
+#define history_maxSnapshots		256
+
+/** History goes back by restoring the nearest v6502_memorySnapshot and registers from before the point being gone back to, and replaying forward from there. Everything the CPU read from hardware, every interrupt it took, and everything hardware wrote to memory, such as by DMA, is kept in a v6502_replayLog, so replaying does exactly what happened the first time, without the hardware being involved.
+
+	Device plugins with snapshot and restore hooks are rewound along with memory (See: @ref plugin), but other hardware isn't, so after going back, running forward again starts a new future, in which the hardware is still where it was before going back. The old future is forgotten.
+
+	Changes made to the machine from outside, like those made at the debugger prompt, aren't replayed, so v6502_markHistory has to be called after making them.
+ */
+
+/** @defgroup history Reverse Execution */
+/**@{*/
+/** @struct */
+/** @brief Machine State at One Point in History */
+typedef struct {
+	/** @brief Memory at this point */
+	v6502_memorySnapshot *memory;
+	/** @brief Devices at this point */
+	v6502_deviceSnapshot *devices;
+	/** @brief Program counter */
+	uint16_t pc;
+	/** @brief Accumulator */
+	uint8_t ac;
+	/** @brief X register */
+	uint8_t x;
+	/** @brief Y register */
+	uint8_t y;
+	/** @brief Status register */
+	uint8_t sr;
+	/** @brief Stack pointer */
+	uint8_t sp;
+	/** @brief v6502_cpu::cycles */
+	uint64_t cycles;
+	/** @brief Number of instructions executed before this point */
+	uint64_t instruction;
+	/** @brief Position in the v6502_replayLog at this point */
+	size_t logPosition;
+} history_snapshot;
+
+/** @struct */
+/** @brief Execution History Object */
+typedef struct {
+	/** @brief The v6502_cpu being recorded */
+	v6502_cpu *cpu;
+	/** @brief Hardware input, attached to the CPU's v6502_memory */
+	v6502_replayLog *log;
+	/** @brief Snapshots, oldest first */
+	history_snapshot snapshots[history_maxSnapshots];
+	/** @brief Number of snapshots */
+	size_t snapshotCount;
+	/** @brief Number of instructions between snapshots */
+	unsigned long interval;
+	/** @brief Number of instructions executed since recording started */
+	uint64_t instruction;
+} v6502_history;
+
+/** @brief Start recording the history of a v6502_cpu, taking a snapshot every interval instructions, or return NULL on failure */
+v6502_history *v6502_createHistory(v6502_cpu *cpu, unsigned long interval);
+/** @brief Stop recording, and destroy a v6502_history */
+void v6502_destroyHistory(v6502_history *history);
+/** @brief Count instructions executed, taking a snapshot if one is due */
+/** This should be called after every v6502_step or v6502_run while recording. */
+void v6502_recordHistory(v6502_history *history, unsigned long executed);
+/** @brief Take a snapshot now, because the machine was changed by something other than the CPU */
+void v6502_markHistory(v6502_history *history);
+/** @brief Go back one instruction, returning NO if that is before the oldest snapshot */
+int v6502_reverseStep(v6502_history *history);
+/** @brief Go back to the last time the CPU was at a breakpoint, returning NO, and stopping at the oldest snapshot, if it never was */
+/** Breakpoints stop if their conditions are true, but ignore counts and hit counts aren't used, since going back doesn't hit anything. */
+int v6502_reverseContinue(v6502_history *history, v6502_breakpoint_list *breakpoints);
+/**@}*/
+
+#endif
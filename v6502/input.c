@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+
+#include "input.h"
+#include "mem.h"
+
+/** How long the input thread waits for input, or for room in the ring, before checking whether it should stop, in milliseconds */
+#define input_threadTimeout			50
+/** The most the input thread reads in one go */
+#define input_chunkSize				4096
+
+static void *input_thread(void *context) {
+	v6502_input *input = context;
+	struct pollfd pfd = { .fd = input->fd, .events = POLLIN };
+	uint8_t chunk[input_chunkSize];
+
+	while (!__atomic_load_n(&input->stopping, __ATOMIC_ACQUIRE)) {
+		// Leave the file descriptor alone for whoever else is reading it
+		if (!__atomic_load_n(&input->listening, __ATOMIC_ACQUIRE)) {
+			usleep(input_threadTimeout * 1000);
+			continue;
+		}
+
+		if (poll(&pfd, 1, input_threadTimeout) <= 0 || !__atomic_load_n(&input->listening, __ATOMIC_ACQUIRE)) {
+			continue;
+		}
+
+		ssize_t length = read(input->fd, chunk, sizeof(chunk));
+		if (length < 0 && (errno == EINTR || errno == EAGAIN)) {
+			continue;
+		}
+		if (length <= 0) {
+			__atomic_store_n(&input->ended, YES, __ATOMIC_RELEASE);
+			break;
+		}
+
+		for (ssize_t i = 0; i < length && !__atomic_load_n(&input->stopping, __ATOMIC_ACQUIRE);) {
+			if (v6502_ringPush(input->ring, chunk[i]) || !input->lossless) {
+				i++;
+			}
+			else {
+				usleep(1000);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+int v6502_startInput(v6502_input *input, v6502_ring *ring, int fd, int lossless) {
+	input->ring = ring;
+	input->fd = fd;
+	input->lossless = lossless;
+	input->listening = NO;
+	input->stopping = NO;
+	input->ended = NO;
+
+	if (fd < 0 || pthread_create(&input->thread, NULL, input_thread, input)) {
+		input->fd = -1;
+		input->ended = YES;
+		return NO;
+	}
+	return YES;
+}
+
+void v6502_stopInput(v6502_input *input) {
+	if (input->fd < 0) {
+		return;
+	}
+
+	__atomic_store_n(&input->stopping, YES, __ATOMIC_RELEASE);
+	pthread_join(input->thread, NULL);
+	input->fd = -1;
+}
+
+void v6502_listenInput(v6502_input *input) {
+	__atomic_store_n(&input->listening, YES, __ATOMIC_RELEASE);
+}
+
+void v6502_restInput(v6502_input *input) {
+	__atomic_store_n(&input->listening, NO, __ATOMIC_RELEASE);
+}
+
+int v6502_inputEnded(v6502_input *input) {
+	return __atomic_load_n(&input->ended, __ATOMIC_ACQUIRE);
+}
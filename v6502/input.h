@@ -0,0 +1,68 @@
+/** @brief Host Input Thread */
+/** @file input.h */
+
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef v6502_input_h
+#define v6502_input_h
+
+#include <pthread.h>
+
+#include <v6502/ring.h>
+
+/** @defgroup input Host Input Thread */
+/**@{*/
+/** @struct */
+/** @brief Host Input Thread Object */
+/** An input thread reads a host file descriptor, in as large chunks as are available, and pushes what it reads into a v6502_ring for the CPU's thread to pop. It only reads while listening, so that something else (such as the debugger) can share the file descriptor. Hardware embeds one of these, rather than each running its own thread. */
+typedef struct {
+	/** @brief Ring that bytes are pushed into */
+	v6502_ring *ring;
+	/** @brief Host file descriptor bytes are read from, or -1 if there is no thread */
+	int fd;
+	/** @brief Whether bytes that don't fit in the ring wait for room, rather than being dropped */
+	int lossless;
+	/** @brief Input thread */
+	pthread_t thread;
+	/** @brief Whether the thread should be reading, which is shared with the thread */
+	int listening;
+	/** @brief Whether the thread should exit, which is shared with the thread */
+	int stopping;
+	/** @brief Whether the thread has reached the end of its input, which is shared with the thread */
+	int ended;
+} v6502_input;
+
+/** @brief Start an input thread reading fd into ring, which doesn't read until v6502_listenInput is called */
+/** If fd is -1, or the thread can't be started, the input is ended from the start, and NO is returned. */
+int v6502_startInput(v6502_input *input, v6502_ring *ring, int fd, int lossless);
+/** @brief Stop an input thread, waiting for it to exit, after which nothing more is pushed into its ring */
+void v6502_stopInput(v6502_input *input);
+/** @brief Let an input thread start reading */
+void v6502_listenInput(v6502_input *input);
+/** @brief Stop an input thread from reading, so that something else can read its file descriptor */
+void v6502_restInput(v6502_input *input);
+/** @brief Whether an input thread has reached the end of its input, which it only does after pushing everything it read */
+int v6502_inputEnded(v6502_input *input);
+/**@}*/
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "keyboard.h"
+
+/** Moves the next key from the ring into the data register, once the last one has been read */
+static void keyboard_poll(v6502_cpu *cpu, void *context) {
+	v6502_keyboard *kbd = context;
+
+	if (!(kbd->status & keyboard_status_ready) && v6502_ringPop(kbd->ring, &kbd->data)) {
+		kbd->status |= keyboard_status_ready;
+		if (kbd->status & keyboard_status_interruptEnable) {
+			v6502_raiseIRQ(cpu, keyboard_irqLine);
+		}
+	}
+
+	v6502_schedule(cpu, cpu->cycles + kbd->pollInterval, keyboard_poll, kbd);
+}
+
+static uint8_t keyboard_read(v6502_memory *memory, uint16_t offset, int trap, void *context) {
+	v6502_keyboard *kbd = context;
+
+	if (offset == keyboard_statusRegister) {
+		return kbd->status;
+	}
+
+	// Only the CPU reading the key consumes it, not the debugger looking at it
+	if (trap) {
+		kbd->status &= ~keyboard_status_ready;
+		v6502_clearIRQ(kbd->cpu, keyboard_irqLine);
+	}
+	return kbd->data;
+}
+
+static void keyboard_write(v6502_memory *memory, uint16_t offset, uint8_t value, void *context) {
+	v6502_keyboard *kbd = context;
+
+	if (offset != keyboard_statusRegister) {
+		return;
+	}
+
+	kbd->status = (kbd->status & ~keyboard_status_interruptEnable) | (value & keyboard_status_interruptEnable);
+	if ((kbd->status & keyboard_status_interruptEnable) && (kbd->status & keyboard_status_ready)) {
+		v6502_raiseIRQ(kbd->cpu, keyboard_irqLine);
+	}
+	else {
+		v6502_clearIRQ(kbd->cpu, keyboard_irqLine);
+	}
+}
+
+v6502_keyboard *keyboard_create(v6502_cpu *cpu, int fd) {
+	assert(cpu && cpu->memory);
+
+	v6502_keyboard *kbd = calloc(1, sizeof(v6502_keyboard));
+	if (!kbd) {
+		return NULL;
+	}
+
+	kbd->cpu = cpu;
+	kbd->pollInterval = keyboard_defaultPollInterval;
+	kbd->ring = v6502_createRing(keyboard_bufferSize);
+	if (!kbd->ring || !v6502_map(cpu->memory, keyboard_statusRegister, 2, keyboard_read, keyboard_write, kbd)) {
+		v6502_destroyRing(kbd->ring);
+		free(kbd);
+		return NULL;
+	}
+
+	// Keys typed too far ahead of the guest are dropped, like a real keyboard buffer
+	v6502_startInput(&kbd->input, kbd->ring, fd, NO);
+
+	v6502_schedule(cpu, cpu->cycles + kbd->pollInterval, keyboard_poll, kbd);
+	return kbd;
+}
+
+/**
+ *	The input thread is stopped before anything is freed, since it pushes
+ *	into the ring.
+ */
+void keyboard_destroy(v6502_keyboard *kbd) {
+	if (!kbd) {
+		return;
+	}
+
+	v6502_stopInput(&kbd->input);
+
+	v6502_cancelEvents(kbd->cpu, keyboard_poll, kbd);
+	v6502_clearIRQ(kbd->cpu, keyboard_irqLine);
+	v6502_destroyRing(kbd->ring);
+	free(kbd);
+}
+
+void keyboard_listen(v6502_keyboard *kbd) {
+	v6502_listenInput(&kbd->input);
+}
+
+void keyboard_rest(v6502_keyboard *kbd) {
+	v6502_restInput(&kbd->input);
+}
+
+int keyboard_type(v6502_keyboard *kbd, uint8_t key) {
+	return v6502_ringPush(kbd->ring, key);
+}
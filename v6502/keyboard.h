@@ -0,0 +1,92 @@
+/** @brief 6502 Reference Platform Virtual Keyboard */
+/** @file keyboard.h */
+
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef v6502_keyboard_h
+#define v6502_keyboard_h
+
+#include <v6502/cpu.h>
+#include <v6502/ring.h>
+#include <v6502/input.h>
+#include <v6502/textmode.h>
+
+/** @brief Address of the keyboard status register */
+#define keyboard_statusRegister			(textMode_registerStart + 0)
+/** @brief Address of the keyboard data register */
+#define keyboard_dataRegister			(textMode_registerStart + 1)
+/** @brief The v6502_cpu::irqLines bit used by the keyboard */
+#define keyboard_irqLine				(1 << 0)
+/** @brief Emulated cycles between checks for new keys (about a millisecond at 1MHz) */
+#define keyboard_defaultPollInterval	1000
+/** @brief Number of keys that can be typed ahead of the guest */
+#define keyboard_bufferSize				256
+
+/** The keyboard has two registers, in the gap between character and attribute data.
+
+	Reading the data register returns the last key received, clears keyboard_status_ready, and acknowledges the IRQ. Writing the status register sets keyboard_status_interruptEnable; the other bits are read only. Since ready is the high bit, a guest can test it with bit/bmi, although with interrupts enabled it never needs to poll.
+ */
+
+/** @defgroup keyboard Reference Platform Keyboard */
+/**@{*/
+/** @enum */
+/** @brief Keyboard Status Register Bits */
+typedef enum {
+	/** @brief Raise an IRQ when a key arrives (read/write) */
+	keyboard_status_interruptEnable = 1 << 0,
+	/** @brief The data register holds a key that hasn't been read yet (read only) */
+	keyboard_status_ready           = 1 << 7,
+} keyboard_status;
+
+/** @struct */
+/** @brief Virtual Keyboard Hardware Object */
+/** Keys are read from a host file descriptor by an input thread, and passed to the CPU's thread through a v6502_ring, so neither thread ever waits on the other. A scheduled event moves keys from the ring into the data register, so the keyboard costs nothing per instruction. */
+typedef struct {
+	/** @brief The v6502_cpu that keys are delivered to */
+	v6502_cpu *cpu;
+	/** @brief Keys read by the input thread, waiting for the CPU */
+	v6502_ring *ring;
+	/** @brief Input thread, which drops keys when the ring is full */
+	v6502_input input;
+	/** @brief Status register */
+	uint8_t status;
+	/** @brief Data register */
+	uint8_t data;
+	/** @brief Emulated cycles between checks of the ring */
+	uint64_t pollInterval;
+} v6502_keyboard;
+
+/** @brief Create v6502_keyboard, mapping its registers into the v6502_cpu's memory */
+/** If fd is -1, no input thread is started, and keys can only arrive through keyboard_type. The input thread doesn't read until keyboard_listen is called. Returns NULL if the registers can't be mapped, or allocation fails. */
+v6502_keyboard *keyboard_create(v6502_cpu *cpu, int fd);
+/** @brief Destroy v6502_keyboard, stopping its input thread */
+void keyboard_destroy(v6502_keyboard *kbd);
+/** @brief Let the input thread start reading keys, such as when the CPU starts running */
+void keyboard_listen(v6502_keyboard *kbd);
+/** @brief Stop the input thread from reading keys, so that something else (such as the debugger) can read the file descriptor */
+void keyboard_rest(v6502_keyboard *kbd);
+/** @brief Queue a key as if it had been typed, from the thread that would otherwise be the input thread. Returns NO if the buffer is full. */
+int keyboard_type(v6502_keyboard *kbd, uint8_t key);
+/**@}*/
+
+#endif
@@ -26,6 +26,25 @@
 
 #include "log.h"
 
+#define MEMORY_ROW_LEN			54
+#define MEMORY_BUFFERED_ROWS	64
+
+static const char _memoryHeader[] = "      0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F\n";
+static const char _hexDigits[] = "0123456789abcdef";
+
+static int _hexValue(char c) {
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
 void v6502_printCpuState(FILE *out, v6502_cpu *cpu) {
 	fprintf(out, "CPU %p: pc = %#04x, ac = %#02x, x = %#02x, y = %#02x, sp = %#02x, sr = %#02x (%c%c%c%c%c%c%c%c)\n",
 			cpu, cpu->pc, cpu->ac, cpu->x, cpu->y, cpu->sp, cpu->sr,
@@ -46,15 +65,112 @@ void v6502_printMemoryRange(v6502_memory *memory, uint16_t start, uint16_t len)
 	// Make sure we go to at least the same range specified, but then also round up to the nearest 0x0F
 	start &= ~15;
 	end |= 15;
+	if (end < start) {
+		end = 0xFFFF;
+	}
+
+	// Reads still go through the memory map, so that mapped hardware shows what it would read as
+	size_t count = (size_t)end - start + 1;
+	uint8_t *bytes = malloc(count);
+	if (!bytes) {
+		return;
+	}
+	for (size_t i = 0; i < count; i++) {
+		bytes[i] = v6502_read(memory, start + i, NO);
+	}
+
+	v6502_printMemoryBytes(stdout, start, bytes, count);
+	free(bytes);
+}
 
-	printf("      0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F\n");
-	for (uint16_t y = start; y <= end - 0x0F && y >= start; y += 0x10) {
-		printf("%04x ", y);
-		for (uint16_t x = y; x <= y + 0x0F && x >= start; x++) {
-			printf("%02x ", v6502_read(memory, x, NO));
+void v6502_printMemoryBytes(FILE *out, uint16_t start, const uint8_t *bytes, size_t len) {
+	char buffer[MEMORY_ROW_LEN * MEMORY_BUFFERED_ROWS];
+	size_t used = 0;
+	size_t end = (size_t)start + len;
+
+	fputs(_memoryHeader, out);
+	for (size_t row = start & ~15; row < end; row += 16) {
+		char *line = buffer + used;
+		for (int i = 0; i < 4; i++) {
+			line[i] = _hexDigits[(row >> (12 - 4 * i)) & 15];
+		}
+		line[4] = ' ';
+
+		for (size_t i = 0; i < 16; i++) {
+			char *column = line + 5 + 3 * i;
+			if (row + i >= start && row + i < end) {
+				uint8_t byte = bytes[row + i - start];
+				column[0] = _hexDigits[byte >> 4];
+				column[1] = _hexDigits[byte & 15];
+			}
+			else {
+				column[0] = column[1] = ' ';
+			}
+			column[2] = ' ';
+		}
+		line[MEMORY_ROW_LEN - 1] = '\n';
+
+		used += MEMORY_ROW_LEN;
+		if (used == sizeof(buffer)) {
+			fwrite(buffer, 1, used, out);
+			used = 0;
+		}
+	}
+	fwrite(buffer, 1, used, out);
+}
+
+size_t v6502_scanMemoryBytes(FILE *in, uint16_t *start, uint8_t *bytes) {
+	char line[MEMORY_ROW_LEN + 2];
+	size_t first = 0, last = 0;
+	int found = NO;
+
+	while (fgets(line, sizeof(line), in)) {
+		// Anything longer than a row isn't one, so the rest of it is skipped
+		size_t length = strlen(line);
+		if (length && line[length - 1] != '\n' && !feof(in)) {
+			int c;
+			while ((c = fgetc(in)) != EOF && c != '\n');
+			continue;
+		}
+
+		// Rows begin with a four digit address, which the header doesn't
+		int address = 0;
+		for (int i = 0; i < 4; i++) {
+			int digit = _hexValue(line[i]);
+			address = digit < 0 || address < 0 ? -1 : (address << 4) | digit;
+		}
+		if (address < 0 || line[4] != ' ') {
+			continue;
+		}
+
+		// Bytes are found by their column, so that the blanks around a range are skipped
+		for (size_t i = 0; i < 16 && 5 + 3 * i + 1 < length; i++) {
+			int high = _hexValue(line[5 + 3 * i]);
+			int low = _hexValue(line[5 + 3 * i + 1]);
+			if (high < 0 || low < 0) {
+				continue;
+			}
+
+			size_t byteAddress = address + i;
+			if (!found) {
+				first = byteAddress;
+				found = YES;
+			}
+			if (byteAddress < first) {
+				continue;
+			}
+			bytes[byteAddress - first] = (uint8_t)((high << 4) | low);
+			if (byteAddress > last) {
+				last = byteAddress;
+			}
 		}
-		printf("\n");
 	}
+
+	if (!found) {
+		return 0;
+	}
+	*start = (uint16_t)first;
+	return last - first + 1;
 }
 
 void v6502_printBreakpointList(v6502_breakpoint_list *list) {
@@ -65,6 +181,14 @@ void v6502_printBreakpointList(v6502_breakpoint_list *list) {
 
 	printf("Breakpoints set:\n");
 	for (size_t i = 0; i < list->count; i++) {
-		printf("Breakpoint #%zu: %#04x\n", i, list->breakpoints[i]);
+		v6502_breakpoint *breakpoint = &list->breakpoints[i];
+		printf("Breakpoint #%zu: %#04x, hit %lu time%s", i, breakpoint->address, breakpoint->hits, breakpoint->hits == 1 ? "" : "s");
+		if (breakpoint->ignoreCount) {
+			printf(", ignoring the next %lu", breakpoint->ignoreCount);
+		}
+		if (breakpoint->condition) {
+			printf(", if %s", breakpoint->condition->source);
+		}
+		printf("\n");
 	}
 }
@@ -35,6 +35,12 @@
 void v6502_printCpuState(FILE *out, v6502_cpu *cpu);
 /** @brief Neatly prints a 52 column wide hex dump of a specified memory range. */
 void v6502_printMemoryRange(v6502_memory *memory, uint16_t start, uint16_t len);
+/** @brief Prints a hex dump of bytes that were read starting at a given address, in the same layout as v6502_printMemoryRange. */
+/** Rows are aligned to 16 bytes, with blank columns for addresses outside of the range given. Rows are formatted into a buffer that is written a block at a time, so that a dump of all of memory doesn't cost a printf per byte. */
+void v6502_printMemoryBytes(FILE *out, uint16_t start, const uint8_t *bytes, size_t len);
+/** @brief Reads a hex dump printed by v6502_printMemoryBytes back into an image of up to 64K bytes. */
+/** The first byte of the dump is put at the start of the image, and its address is returned through start. Returns the number of bytes from the first in the dump to the last, or zero if no bytes were found. Lines that aren't rows, such as the column header, are skipped. */
+size_t v6502_scanMemoryBytes(FILE *in, uint16_t *start, uint8_t *bytes);
 /** @brief Neatly prints the contents of a v6502_breakpoint_list. */
 void v6502_printBreakpointList(v6502_breakpoint_list *list);
 /**@}*/
@@ -21,11 +21,17 @@
  */
 
 #include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <time.h>
 #include <string.h>
 #include <strings.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <signal.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <histedit.h>
 
 #include <as6502/parser.h>
@@ -38,18 +44,56 @@
 #include "log.h"
 #include "breakpoint.h"
 #include "textmode.h"
+#include "keyboard.h"
+#include "timer.h"
+#include "block.h"
+#include "uart.h"
+#include "plugin.h"
+#include "gdbstub.h"
+#include "history.h"
+#include "worker.h"
 #include "debugger.h"
 
-#define MEMORY_SIZE				0xFFFF
+#define MEMORY_SIZE				0x10000
 #define DEFAULT_RESET_VECTOR	0x0600
+#define RUN_BUDGET				10000
+/** Exit status of a batch run that used up its budget, which is what timeout(1) uses */
+#define BATCH_TIMEOUT_STATUS	124
+
+/** How a batch run ended */
+typedef enum {
+	batch_stop_brk,
+	batch_stop_budget,
+	batch_stop_interrupt
+} batch_stop;
 
 static int verbose;
+static int batch;
+static int background;
 static volatile sig_atomic_t interrupt;
 static int resist;
 static v6502_cpu *cpu;
 static v6502_breakpoint_list *breakpoint_list;
 static v6502_textmode_video *video;
+static v6502_keyboard *keyboard;
+static v6502_intervalTimer *timer;
+static v6502_blockDevice *disk;
+static v6502_uart *serial;
 static as6502_symbol_table *table;
+static v6502_history *cpuHistory;
+static v6502_worker *worker;
+
+/** Startup messages are left out of batch runs, so that their only output is the program's and the timing */
+static void progress(const char *format, ...) {
+	if (batch) {
+		return;
+	}
+
+	va_list ap;
+	va_start(ap, format);
+	vprintf(format, ap);
+	va_end(ap);
+}
 
 static void fault(void *ctx, const char *error) {
 	(void)ctx;
@@ -61,42 +105,129 @@ static void fault(void *ctx, const char *error) {
 	}
 }
 
-static void run(v6502_cpu *cpu) {
+/* Breakpoints and verbose mode need to look at every instruction, so they
+ * take this path, which still flushes deferred writes at the same interval.
+ * Returns YES if a breakpoint was hit, and the number of instructions
+ * executed in executed.
+ */
+static int runSlowly(v6502_cpu *cpu, unsigned long budget, unsigned long *executed) {
+	unsigned long i;
+	for (i = 0; i < budget && !(cpu->sr & v6502_cpu_status_break); i++) {
+		if (v6502_breakpointIsInList(breakpoint_list, cpu->pc) && v6502_hitBreakpoint(breakpoint_list, cpu)) {
+			v6502_flushMemory(cpu->memory);
+			*executed = i;
+			return YES;
+		}
+
+		if (verbose) {
+			dis6502_printAnnotatedInstruction(stderr, cpu, cpu->pc, table);
+		}
+		v6502_step(cpu);
+	}
+
+	v6502_flushMemory(cpu->memory);
+	*executed = i;
+	return NO;
+}
+
+/** Runs one batch on the worker thread, for as long as the CPU is running */
+static worker_stop runOnWorker(v6502_cpu *cpu, void *context) {
+	unsigned long executed;
+	int hitBreakpoint = NO;
+	if (verbose || breakpoint_list->count) {
+		hitBreakpoint = runSlowly(cpu, RUN_BUDGET, &executed);
+	}
+	else {
+		executed = v6502_run(cpu, RUN_BUDGET);
+	}
+
+	if (cpuHistory) {
+		v6502_recordHistory(cpuHistory, executed);
+	}
+
+	textMode_updateVideo(video);
+	if (serial) {
+		uart_flush(serial);
+	}
+
+	if (hitBreakpoint) {
+		return worker_stop_breakpoint;
+	}
+	if (cpu->sr & v6502_cpu_status_break) {
+		return worker_stop_brk;
+	}
+	return interrupt ? worker_stop_interrupt : worker_stop_none;
+}
+
+/** Hands the CPU to the worker, and the devices to the guest */
+static void start(v6502_cpu *cpu) {
 	cpu->sr &= ~v6502_cpu_status_break;
 	interrupt = 0;
 
+	// Clearing the break flag isn't something the CPU did, so replaying has to start after it
+	if (cpuHistory) {
+		v6502_markHistory(cpuHistory);
+	}
+
 	// Step once if we are starting from a breakpoint, so that we don't hit it again
 	if (v6502_breakpointIsInList(breakpoint_list, cpu->pc)) {
 		if (verbose) {
 			dis6502_printAnnotatedInstruction(stderr, cpu, cpu->pc, table);
 		}
 		v6502_step(cpu);
+		if (cpuHistory) {
+			v6502_recordHistory(cpuHistory, 1);
+		}
 	}
 
 	textMode_refreshVideo(video);
+	keyboard_listen(keyboard);
+	if (serial) {
+		// The serial port writes around stdio, so anything printed so far has to come out first
+		fflush(stdout);
+		uart_listen(serial);
+	}
 	resist = YES;
-	do {
-		if (v6502_breakpointIsInList(breakpoint_list, cpu->pc)) {
-			printf("Hit breakpoint at %#02x.\n", cpu->pc);
-			return;
-		}
+	worker_resume(worker);
+}
 
-		if (verbose) {
-			dis6502_printAnnotatedInstruction(stderr, cpu, cpu->pc, table);
-		}
-		v6502_step(cpu);
-	} while (!(cpu->sr & v6502_cpu_status_break) && !interrupt);
+/** Gives the devices back to the debugger, once the worker has given back the CPU, and says why it stopped */
+static void stopped(v6502_cpu *cpu, worker_stop stop) {
 	resist = NO;
 
+	keyboard_rest(keyboard);
+	if (serial) {
+		uart_rest(serial);
+	}
 	textMode_rest(video);
 
-	if (cpu->sr & v6502_cpu_status_break) {
-		printf("Encountered 'brk' at %#02x.\n", cpu->pc - 1);
+	switch (stop) {
+		case worker_stop_breakpoint:
+			printf("Hit breakpoint at %#02x.\n", cpu->pc);
+			break;
+		case worker_stop_brk:
+			printf("Encountered 'brk' at %#02x.\n", cpu->pc - 1);
+			break;
+		case worker_stop_interrupt:
+			printf("Received interrupt, CPU halted.\n");
+			break;
+		case worker_stop_pause:
+			printf("Paused at %#02x.\n", cpu->pc);
+			break;
+		default:
+			break;
 	}
+}
 
-	if (interrupt) {
-		printf("Received interrupt, CPU halted.\n");
+static void run(v6502_cpu *cpu) {
+	// Commands given while the CPU runs in the background are called from the worker, which is busy running it
+	if (worker->running) {
+		printf("The CPU is already running.\n");
+		return;
 	}
+
+	start(cpu);
+	stopped(cpu, worker_waitForStop(worker));
 }
 
 static void handleSignal(int signal) {
@@ -109,53 +240,208 @@ static void handleSignal(int signal) {
 	}
 }
 
-static const char * prompt() {
-	static char prompt[10];
-	snprintf(prompt, 10, "(%#04x) ", cpu->pc);
-	return prompt;
+/** Runs without a debugger until a brk, an interrupt, or either budget runs out, where a budget of 0 is unlimited, counting instructions in executed */
+static batch_stop runBatch(v6502_cpu *cpu, unsigned long long instructions, uint64_t cycles, unsigned long long *executedOut) {
+	unsigned long long executed = 0;
+	uint64_t cycleLimit = cpu->cycles + cycles;
+
+	cpu->sr &= ~v6502_cpu_status_break;
+	interrupt = 0;
+	resist = YES;
+
+	if (serial) {
+		uart_listen(serial);
+	}
+
+	while (!(cpu->sr & v6502_cpu_status_break) && !interrupt) {
+		unsigned long chunk = RUN_BUDGET;
+		if (instructions) {
+			if (executed >= instructions) {
+				break;
+			}
+			if (instructions - executed < chunk) {
+				chunk = (unsigned long)(instructions - executed);
+			}
+		}
+
+		if (cycles) {
+			// A cycle budget is checked after every instruction, so it isn't overshot by a whole chunk
+			if (cpu->cycles >= cycleLimit) {
+				break;
+			}
+			unsigned long i;
+			for (i = 0; i < chunk && cpu->cycles < cycleLimit && !(cpu->sr & v6502_cpu_status_break); i++) {
+				v6502_step(cpu);
+			}
+			v6502_flushMemory(cpu->memory);
+			executed += i;
+		}
+		else {
+			executed += v6502_run(cpu, chunk);
+		}
+
+		if (serial) {
+			uart_flush(serial);
+		}
+	}
+	resist = NO;
+	*executedOut = executed;
+
+	if (serial) {
+		uart_rest(serial);
+	}
+
+	if (cpu->sr & v6502_cpu_status_break) {
+		return batch_stop_brk;
+	}
+	return interrupt ? batch_stop_interrupt : batch_stop_budget;
 }
 
-int main(int argc, const char * argv[])
-{
-	currentFileName = "v6502";
+/** Runs a batch, prints its timing as JSON, and returns the exit status */
+/** The status is the byte at statusAddress, or the accumulator if statusAddress is negative, once the program reaches a brk. Running out of budget exits with BATCH_TIMEOUT_STATUS, and an interrupt with the usual status for SIGINT. */
+static int batchRun(unsigned long long instructions, uint64_t cycles, long statusAddress) {
+	const char * const reasons[] = { "brk", "budget", "interrupt" };
+
+	uint64_t startCycles = cpu->cycles;
+	unsigned long long executed;
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	batch_stop stop = runBatch(cpu, instructions, cycles, &executed);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double seconds = (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	int status;
+	switch (stop) {
+		case batch_stop_brk:
+			status = statusAddress < 0 ? cpu->ac : v6502_read(cpu->memory, (uint16_t)statusAddress, NO);
+			break;
+		case batch_stop_budget:
+			status = BATCH_TIMEOUT_STATUS;
+			break;
+		default:
+			status = 128 + SIGINT;
+			break;
+	}
 
-	signal(SIGINT, handleSignal);
+	printf("{\"stop\": \"%s\", \"status\": %d, \"pc\": %u, \"instructions\": %llu, \"cycles\": %llu, \"seconds\": %.6f, \"mips\": %.3f}\n",
+		   reasons[stop], status, cpu->pc, executed, (unsigned long long)(cpu->cycles - startCycles), seconds, seconds > 0 ? executed / seconds / 1e6 : 0.0);
+	return status;
+}
 
-	printf("Creating 1 virtual CPU...\n");
-	cpu = v6502_createCPU();
-	cpu->fault_callback = fault;
+/** Opens a serial line, which is either a Unix socket to connect to, or anything else that can be opened, like a FIFO or a terminal */
+static int openSerialLine(const char *path) {
+	struct sockaddr_un address = { .sun_family = AF_UNIX };
+	if (strlen(path) < sizeof(address.sun_path)) {
+		strcpy(address.sun_path, path);
 
-	printf("Allocating %dk of virtual memory...\n", (MEMORY_SIZE + 1) / 1024);
-	cpu->memory = v6502_createMemory(MEMORY_SIZE);
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd >= 0 && !connect(fd, (struct sockaddr *)&address, sizeof(address))) {
+			return fd;
+		}
+		if (fd >= 0) {
+			close(fd);
+		}
+	}
 
-	// Check for a binary as an argument; if so, load and run it
-	if (argc > 1) {
-		const char *filename = argv[argc - 1];
-		printf("Loading binary image \"%s\" into memory...\n", filename);
-		v6502_loadFileAtAddress(cpu->memory, filename, DEFAULT_RESET_VECTOR);
+	return open(path, O_RDWR);
+}
+
+/** Keeps devices that are normally updated by run() going while a remote debugger has the CPU running */
+static void updateDevicesForDebugger(v6502_cpu *cpu) {
+	textMode_updateVideo(video);
+	if (serial) {
+		uart_flush(serial);
 	}
+}
 
-	// Set the reset vector
-	v6502_write(cpu->memory, v6502_memoryVectorResetLow, DEFAULT_RESET_VECTOR & 0xFF);
-	v6502_write(cpu->memory, v6502_memoryVectorResetHigh, DEFAULT_RESET_VECTOR >> 8);
+/** Serves one remote debugger, instead of the interactive debugger, returning YES if it ran to completion */
+static int serveDebugger(const char *address) {
+	int listener = gdbStub_listen(address);
+	if (listener < 0) {
+		fprintf(stderr, "Could not listen for a debugger on \"%s\"!\n", address);
+		return NO;
+	}
 
-	printf("Resetting CPU...\n");
-	v6502_reset(cpu);
+	printf("Waiting for a debugger on \"%s\"...\n", address);
+	int fd = accept(listener, NULL, NULL);
+	close(listener);
+	if (!strchr(address, ':')) {
+		unlink(address);
+	}
+	if (fd < 0) {
+		fprintf(stderr, "Could not accept a debugger!\n");
+		return NO;
+	}
 
-	/* An empty breakpoint list must be created even before first run, since 
-	 * breakpoint checks are made during all calls to run()
-	 */
-	breakpoint_list = v6502_createBreakpointList();
+	// A debugger that goes away mid-reply shouldn't take the emulator with it
+	signal(SIGPIPE, SIG_IGN);
 
-	// An empty symbol table is allocated, since they are dynamically created
-	table = as6502_createSymbolTable();
+	v6502_gdbStub *stub = gdbStub_create(cpu, breakpoint_list);
+	stub->batchCallback = updateDevicesForDebugger;
 
-	printf("Starting Text Mode Video...\n");
-	video = textMode_create(cpu->memory);
+	textMode_refreshVideo(video);
+	keyboard_listen(keyboard);
+	if (serial) {
+		fflush(stdout);
+		uart_listen(serial);
+	}
 
-	printf("Running...\n");
-	run(cpu);
+	gdbStub_serve(stub, fd);
 
+	keyboard_rest(keyboard);
+	if (serial) {
+		uart_rest(serial);
+	}
+	textMode_rest(video);
+
+	gdbStub_destroy(stub);
+	close(fd);
+	return YES;
+}
+
+static void usage() {
+	fprintf(stderr, "usage: v6502 -b [-c cycles] [-e address] [-n instructions] [-d disk] [-l plugin[:args]] [-u serial] [image]\n");
+	fprintf(stderr, "       v6502 [-a] [-d disk] [-g address] [-l plugin[:args]] [-r recording] [-u serial] [image]\n");
+	fprintf(stderr, "       v6502 -p recording [-s speed]\n");
+}
+
+static const char * prompt() {
+	static char prompt[10];
+
+	// The program counter of a running CPU belongs to the worker
+	if (worker->running) {
+		return "(running) ";
+	}
+
+	snprintf(prompt, 10, "(%#04x) ", cpu->pc);
+	return prompt;
+}
+
+/** A line typed at the debugger prompt */
+typedef struct {
+	char *command;
+	int length;
+} debuggerLine;
+
+/** Handles a line as a debugger command, or else an instruction to execute in place, on whichever thread has the CPU */
+static void handleLine(v6502_cpu *cpu, void *context) {
+	debuggerLine *line = context;
+
+	if (!v6502_handleDebuggerCommand(cpu, line->command, line->length, breakpoint_list, table, cpuHistory, run, &verbose) && line->command[0] != ';') {
+		as6502_executeAsmLineOnCPU(cpu, line->command, strlen(line->command));
+	}
+
+	// Commands and in-place instructions can write to deferred ranges
+	v6502_flushMemory(cpu->memory);
+
+	// They can also change the machine, which going back mustn't undo
+	if (cpuHistory) {
+		v6502_markHistory(cpuHistory);
+	}
+}
+
+/** Runs the interactive debugger until the end of its input */
+static void interact(void) {
 	int commandLen;
 	HistEvent ev;
 	History *hist = history_init();
@@ -178,6 +464,12 @@ int main(int argc, const char * argv[])
 			break;
 		}
 
+		// A CPU running in the background may have stopped while the line was being typed, which should be said before anything else
+		worker_stop stop;
+		if (worker_pollStop(worker, &stop)) {
+			stopped(cpu, stop);
+		}
+
 		history(hist, &ev, H_ENTER, in);
 		command = realloc(command, commandLen + 1);
 		memcpy(command, in, commandLen);
@@ -189,22 +481,275 @@ int main(int argc, const char * argv[])
 			continue;
 		}
 
-		if (v6502_handleDebuggerCommand(cpu, command, commandLen, breakpoint_list, table, run, &verbose)) {
+		// Pausing is handled here, since it is the one command that has to reach the worker instead of the CPU
+		const char *name = v6502_debuggerCommandName(command, commandLen);
+		if (name && !strcmp(name, "pause")) {
+			if (worker->running) {
+				stopped(cpu, worker_pause(worker));
+			}
+			else {
+				printf("The CPU isn't running.\n");
+			}
+			continue;
+		}
+
+		// A run typed at the prompt leaves it responsive in the background, but one in a script still finishes before the next line
+		if (background && name && !strcmp(name, "run") && !worker->running) {
+			start(cpu);
 			continue;
 		}
-		else if (command[0] != ';') {
-			currentLineText = in;
-			as6502_executeAsmLineOnCPU(cpu, command, strlen(command));
+
+		currentLineText = in;
+		debuggerLine line = { command, commandLen };
+		worker_call(worker, handleLine, &line);
+
+		if (worker_pollStop(worker, &stop)) {
+			stopped(cpu, stop);
 		}
 	}
 
-	textMode_destroy(video);
-	as6502_destroySymbolTable(table);
-	v6502_destroyBreakpointList(breakpoint_list);
+	if (worker->running) {
+		stopped(cpu, worker_pause(worker));
+	}
+
 	history_end(hist);
 	el_end(el);
 	free(command);
-	printf("\n");
-    return EXIT_SUCCESS;
+}
+
+int main(int argc, char * const argv[])
+{
+	currentFileName = "v6502";
+
+	FILE *recording = NULL;
+	const char *diskImage = NULL;
+	const char *serialLine = NULL;
+	const char *debuggerAddress = NULL;
+	unsigned long long instructionBudget = 0;
+	uint64_t cycleBudget = 0;
+	long statusAddress = -1;
+	const char *plugins[argc];
+	int pluginCount = 0;
+	const char *playback = NULL;
+	double speed = 1.0;
+
+	int ch;
+	while ((ch = getopt(argc, argv, "abc:d:e:g:l:n:p:r:s:u:")) != -1) {
+		switch (ch) {
+			case 'a': {
+				background = YES;
+			} break;
+			case 'b': {
+				batch = YES;
+			} break;
+			case 'c': {
+				cycleBudget = strtoull(optarg, NULL, 0);
+			} break;
+			case 'd': {
+				diskImage = optarg;
+			} break;
+			case 'e': {
+				statusAddress = strtol(optarg, NULL, 0) & 0xFFFF;
+			} break;
+			case 'g': {
+				debuggerAddress = optarg;
+			} break;
+			case 'l': {
+				plugins[pluginCount++] = optarg;
+			} break;
+			case 'n': {
+				instructionBudget = strtoull(optarg, NULL, 0);
+			} break;
+			case 'p': {
+				playback = optarg;
+			} break;
+			case 'r': {
+				recording = fopen(optarg, "wb");
+				if (!recording) {
+					fprintf(stderr, "Could not open \"%s\" for writing!\n", optarg);
+					return EXIT_FAILURE;
+				}
+			} break;
+			case 's': {
+				speed = strtod(optarg, NULL);
+			} break;
+			case 'u': {
+				serialLine = optarg;
+			} break;
+			case '?':
+			default:
+				usage();
+				return EXIT_FAILURE;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	// A batch run has nobody to show video to, or to take over from a debugger
+	if (batch && (recording || debuggerAddress)) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	// Running in the background leaves the terminal to the debugger, so it can't be shared with the guest
+	if (background && (batch || debuggerAddress || (serialLine && !strcmp(serialLine, "-")))) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	// Playing back a recording doesn't need a machine at all
+	if (playback) {
+		FILE *stream = fopen(playback, "rb");
+		if (!stream) {
+			fprintf(stderr, "Could not open \"%s\" for reading!\n", playback);
+			return EXIT_FAILURE;
+		}
+
+		int valid = textMode_play(stream, speed);
+		fclose(stream);
+		if (!valid) {
+			fprintf(stderr, "\"%s\" is not a valid recording.\n", playback);
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	signal(SIGINT, handleSignal);
+
+	progress("Creating 1 virtual CPU...\n");
+	cpu = v6502_createCPU();
+	cpu->fault_callback = fault;
+
+	progress("Allocating %dk of virtual memory...\n", MEMORY_SIZE / 1024);
+	cpu->memory = v6502_createMemory(MEMORY_SIZE);
+
+	// Check for a binary as an argument; if so, load and run it
+	if (argc > 0) {
+		const char *filename = argv[0];
+		progress("Loading binary image \"%s\" into memory...\n", filename);
+		v6502_loadFileAtAddress(cpu->memory, filename, DEFAULT_RESET_VECTOR);
+	}
+
+	// Set the reset vector
+	v6502_write(cpu->memory, v6502_memoryVectorResetLow, DEFAULT_RESET_VECTOR & 0xFF);
+	v6502_write(cpu->memory, v6502_memoryVectorResetHigh, DEFAULT_RESET_VECTOR >> 8);
+
+	progress("Resetting CPU...\n");
+	v6502_reset(cpu);
+
+	/* An empty breakpoint list must be created even before first run, since 
+	 * breakpoint checks are made during all calls to run()
+	 */
+	breakpoint_list = v6502_createBreakpointList();
+
+	// An empty symbol table is allocated, since they are dynamically created
+	table = as6502_createSymbolTable();
+
+	int usingStandardIO = serialLine && !strcmp(serialLine, "-");
+	if (!batch) {
+		printf("Starting Text Mode Video...\n");
+		// Without a terminal, nobody would see the video, so don't bother with curses
+		video = textMode_create(cpu->memory, (isatty(STDOUT_FILENO) && !background) ? textMode_backend_curses : textMode_backend_headless);
+
+		// Piped input is meant for the debugger, so only a terminal is read as a keyboard, unless it belongs to the serial port
+		printf("Starting Keyboard...\n");
+		keyboard = keyboard_create(cpu, (isatty(STDIN_FILENO) && !usingStandardIO && !background) ? STDIN_FILENO : -1);
+	}
+
+	progress("Starting Interval Timer...\n");
+	timer = intervalTimer_create(cpu);
+
+	if (diskImage) {
+		progress("Attaching Disk...\n");
+		disk = blockDevice_create(cpu->memory, diskImage, blockDevice_defaultBlockSize);
+		if (!disk) {
+			fprintf(stderr, "Could not attach \"%s\" as a disk!\n", diskImage);
+		}
+	}
+
+	int serialFd = -1;
+	if (serialLine) {
+		progress("Starting Serial Port...\n");
+		serialFd = usingStandardIO ? -1 : openSerialLine(serialLine);
+		if (!usingStandardIO && serialFd < 0) {
+			fprintf(stderr, "Could not open \"%s\" as a serial line!\n", serialLine);
+		}
+		else {
+			serial = usingStandardIO ? uart_create(cpu, STDIN_FILENO, STDOUT_FILENO) : uart_create(cpu, serialFd, serialFd);
+		}
+	}
+
+	// Plugins come last, so they can't take the place of the built in devices
+	for (int i = 0; i < pluginCount; i++) {
+		char *path = strdup(plugins[i]);
+		char *args = strchr(path, ':');
+		if (args) {
+			*args++ = '\0';
+		}
+
+		progress("Loading Plugin \"%s\"...\n", path);
+		v6502_loadDevice(cpu, path, args);
+		free(path);
+	}
+
+	if (recording && !textMode_startRecording(video, recording, cpu)) {
+		fprintf(stderr, "Could not start recording!\n");
+	}
+
+	int status = EXIT_SUCCESS;
+	if (batch) {
+		status = batchRun(instructionBudget, cycleBudget, statusAddress);
+	}
+	else if (debuggerAddress) {
+		status = serveDebugger(debuggerAddress) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	else {
+		printf("Recording History...\n");
+		cpuHistory = v6502_createHistory(cpu, history_defaultInterval);
+
+		printf("Starting CPU Thread...\n");
+		worker = worker_create(cpu, runOnWorker, NULL);
+		if (!worker) {
+			fprintf(stderr, "Could not start the CPU thread!\n");
+			status = EXIT_FAILURE;
+		}
+		else {
+			printf("Running...\n");
+			if (background) {
+				start(cpu);
+			}
+			else {
+				run(cpu);
+			}
+			interact();
+
+			worker_destroy(worker);
+		}
+
+		v6502_destroyHistory(cpuHistory);
+	}
+
+	if (recording) {
+		textMode_stopRecording(video);
+		fclose(recording);
+	}
+
+	v6502_detachDevices(cpu);
+	uart_destroy(serial);
+	if (serialFd >= 0) {
+		close(serialFd);
+	}
+	blockDevice_destroy(disk);
+	intervalTimer_destroy(timer);
+	keyboard_destroy(keyboard);
+	if (video) {
+		textMode_destroy(video);
+	}
+	as6502_destroySymbolTable(table);
+	v6502_destroyBreakpointList(breakpoint_list);
+	v6502_destroyDebuggerState();
+	progress("\n");
+    return status;
 }
 
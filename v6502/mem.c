@@ -21,17 +21,164 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "mem.h"
 
+#define v6502_pageBudgetErrorText		"Page budget exceeded, write dropped"
+#define v6502_snapshotErrorText			"Could not save page for snapshot"
+
+/** Every unwritten page of sparse memory reads from this, and is never written */
+static uint8_t _zeroPage[v6502_memoryPageSize];
+
+/** Initial number of hash buckets in a v6502_pagePool, which must be a power of two */
+#define v6502_pagePoolInitialBuckets	64
+
+#pragma mark -
+#pragma mark Page Pool
+
+static uint32_t _hashPage(const uint8_t *bytes) {
+	// 32-bit FNV-1a
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < v6502_memoryPageSize; i++) {
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	return hash;
+}
+
+static int _growPagePool(v6502_pagePool *pool) {
+	size_t bucketCount = pool->bucketCount * 2;
+	v6502_sharedPage **buckets = calloc(bucketCount, sizeof(v6502_sharedPage *));
+	if (!buckets) {
+		return NO;
+	}
+
+	for (size_t i = 0; i < pool->bucketCount; i++) {
+		v6502_sharedPage *page = pool->buckets[i];
+		while (page) {
+			v6502_sharedPage *next = page->next;
+			size_t bucket = page->hash & (bucketCount - 1);
+			page->next = buckets[bucket];
+			buckets[bucket] = page;
+			page = next;
+		}
+	}
+
+	free(pool->buckets);
+	pool->buckets = buckets;
+	pool->bucketCount = bucketCount;
+	return YES;
+}
+
+/** Returns a referenced page with the same contents as bytes, or NULL if a new one couldn't be allocated */
+static v6502_sharedPage *_retainSharedPage(v6502_pagePool *pool, const uint8_t *bytes) {
+	uint32_t hash = _hashPage(bytes);
+
+	for (v6502_sharedPage *page = pool->buckets[hash & (pool->bucketCount - 1)]; page; page = page->next) {
+		if (page->hash == hash && !memcmp(page->bytes, bytes, v6502_memoryPageSize)) {
+			page->references++;
+			return page;
+		}
+	}
+
+	// Keep the chains short, although failing to grow only makes them longer
+	if (pool->pageCount >= pool->bucketCount) {
+		_growPagePool(pool);
+	}
+
+	v6502_sharedPage *page = malloc(sizeof(v6502_sharedPage));
+	if (!page) {
+		return NULL;
+	}
+
+	memcpy(page->bytes, bytes, v6502_memoryPageSize);
+	page->hash = hash;
+	page->references = 1;
+
+	size_t bucket = hash & (pool->bucketCount - 1);
+	page->next = pool->buckets[bucket];
+	pool->buckets[bucket] = page;
+	pool->pageCount++;
+
+	return page;
+}
+
+static void _releaseSharedPage(v6502_pagePool *pool, v6502_sharedPage *page) {
+	if (--page->references) {
+		return;
+	}
+
+	v6502_sharedPage **link = &pool->buckets[page->hash & (pool->bucketCount - 1)];
+	while (*link != page) {
+		link = &(*link)->next;
+	}
+	*link = page->next;
+
+	pool->pageCount--;
+	free(page);
+}
+
+/**
+ *	If there are allocation problems, v6502_createPagePool will return NULL.
+ */
+v6502_pagePool *v6502_createPagePool(void) {
+	v6502_pagePool *pool = calloc(1, sizeof(v6502_pagePool));
+	if (!pool) {
+		return NULL;
+	}
+
+	pool->buckets = calloc(v6502_pagePoolInitialBuckets, sizeof(v6502_sharedPage *));
+	if (!pool->buckets) {
+		free(pool);
+		return NULL;
+	}
+	pool->bucketCount = v6502_pagePoolInitialBuckets;
+
+	return pool;
+}
+
+void v6502_destroyPagePool(v6502_pagePool *pool) {
+	if (!pool) {
+		return;
+	}
+
+	for (size_t i = 0; i < pool->bucketCount; i++) {
+		v6502_sharedPage *page = pool->buckets[i];
+		while (page) {
+			v6502_sharedPage *next = page->next;
+			free(page);
+			page = next;
+		}
+	}
+
+	free(pool->buckets);
+	free(pool);
+}
+
 #pragma mark -
 #pragma mark Memory Lifecycle
 
+static size_t _backedPageCount(v6502_memory *memory) {
+	size_t count = (memory->size + v6502_memoryPageSize - 1) / v6502_memoryPageSize;
+	return (count < v6502_memoryPageCount) ? count : v6502_memoryPageCount;
+}
+
+/** Where a page points when nothing has been written to it, or been mapped over it */
+static uint8_t *_homePage(v6502_memory *memory, size_t page) {
+	if (page >= _backedPageCount(memory)) {
+		return NULL;
+	}
+	return memory->bytes ? memory->bytes + (page * v6502_memoryPageSize) : _zeroPage;
+}
+
 /**
- * This function is the slow brute force way (the original implementation) of
- * looking up v6502_mappedRange's for a given address. This function should
- * never be hit if map caching is enabled.
+ * This function is the slow path for looking up v6502_mappedRange's for a
+ * given address. With map caching enabled, it is only used to find the owner
+ * of a deferred page (see v6502_mapDeferred). The ranges are kept sorted by
+ * start address (see v6502_map), so this is a binary search, preceded by a
+ * check of whichever range was hit last, since consecutive accesses tend to
+ * land in the same device.
  *
  * A notable side effect of the joined mapping system is that a given range can
  * only ever be mapped once. This means, for example, that you can't map 0xA000
@@ -40,40 +187,66 @@
  * behavior, but three map calls would be required.
  */
 
-v6502_mappedRange *v6502_mappedRangeForOffset(v6502_memory *memory, uint16_t offset) {
-	assert(!memory->mapCacheEnabled);
+static v6502_mappedRange *_rangeForOffset(v6502_memory *memory, uint16_t offset) {
+	if (!memory->rangeCount) {
+		return NULL;
+	}
+
+	// Check the last hit first
+	v6502_mappedRange *currentRange = &memory->mappedRanges[memory->lastRangeHit];
+	if (offset >= currentRange->start && offset < (currentRange->start + currentRange->size)) {
+		return currentRange;
+	}
 
-	for (size_t i = 0; i < memory->rangeCount; i++) {
-		v6502_mappedRange *currentRange = &memory->mappedRanges[i];
-		if (offset >= currentRange->start && offset < (currentRange->start + currentRange->size)) {
-			return currentRange;
+	// Find the last range that starts at or before the offset
+	size_t low = 0;
+	size_t high = memory->rangeCount;
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		if (memory->mappedRanges[mid].start <= offset) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
 		}
 	}
+
+	if (!low) {
+		return NULL;
+	}
+
+	currentRange = &memory->mappedRanges[low - 1];
+	if (offset < (currentRange->start + currentRange->size)) {
+		memory->lastRangeHit = low - 1;
+		return currentRange;
+	}
 	return NULL;
 }
 
-static int v6502_memoryRangesIntersect(uint16_t start1, uint16_t size1, uint16_t start2, uint16_t size2) {
-	// Curly braces are 1
-	// Square braces are 2
-	uint16_t end1 = start1 + size1;
-	uint16_t end2 = start2 + size2;
+v6502_mappedRange *v6502_mappedRangeForOffset(v6502_memory *memory, uint16_t offset) {
+	assert(!memory->mapCacheEnabled);
 
-	// [ { ]
-	if (start1 >= start2 && start1 < end2) {
-		return YES;
+	return _rangeForOffset(memory, offset);
+}
+
+static void _recordDeferredWrite(v6502_memory *memory, v6502_mappedRange *range, uint16_t start, uint16_t end) {
+	if (!range->dirty) {
+		range->dirty = YES;
+		range->dirtyStart = start;
+		range->dirtyEnd = end;
+		memory->dirtyRangeCount++;
+		return;
 	}
-	// [ } ]
-	if (end1 >= start2 && end1 < end2) {
-		return YES;
+
+	if (start < range->dirtyStart) {
+		range->dirtyStart = start;
 	}
-	// { [ ] }
-	if (start2 >= start1 && end2 <= end1) {
-		return YES;
+	if (end > range->dirtyEnd) {
+		range->dirtyEnd = end;
 	}
-	return NO;
 }
 
-int v6502_map(v6502_memory *memory, uint16_t start, size_t size, v6502_readFunction *read, v6502_writeFunction *write, void *context) {
+static int _map(v6502_memory *memory, uint16_t start, size_t size, v6502_readFunction *read, v6502_writeFunction *write, v6502_flushFunction *flush, void *context) {
 	assert(memory);
 
 	// Mapping beyond the end of the address space is prohibited
@@ -81,26 +254,46 @@ int v6502_map(v6502_memory *memory, uint16_t start, size_t size, v6502_readFunct
 		return NO;
 	}
 
-	// Make sure it's not already mapped
-	for (size_t i = 0; i < memory->rangeCount; i++) {
-		v6502_mappedRange *currentRange = &memory->mappedRanges[i];
-		if (v6502_memoryRangesIntersect(start, size, currentRange->start, currentRange->size)) {
+	// Find where this range belongs in the sorted list
+	size_t index = 0;
+	while (index < memory->rangeCount && memory->mappedRanges[index].start < start) {
+		index++;
+	}
+
+	// Since the list is sorted and never overlaps, only the neighbors can intersect
+	if (index > 0) {
+		v6502_mappedRange *previous = &memory->mappedRanges[index - 1];
+		if ((uint32_t)previous->start + previous->size > start) {
+			return NO;
+		}
+	}
+	if (index < memory->rangeCount) {
+		if ((uint32_t)start + size > memory->mappedRanges[index].start) {
 			return NO;
 		}
 	}
 
-	// Create a struct and add it to the list
-	memory->mappedRanges = realloc(memory->mappedRanges, sizeof(v6502_mappedRange) * (memory->rangeCount + 1));
+	// Create a struct and insert it into the list
+	v6502_mappedRange *ranges = realloc(memory->mappedRanges, sizeof(v6502_mappedRange) * (memory->rangeCount + 1));
+	if (!ranges) {
+		return NO;
+	}
+	memory->mappedRanges = ranges;
+	memmove(&ranges[index + 1], &ranges[index], sizeof(v6502_mappedRange) * (memory->rangeCount - index));
 
-	v6502_mappedRange *this = &memory->mappedRanges[memory->rangeCount];
+	v6502_mappedRange *this = &ranges[index];
 
 	this->start = start;
 	this->size = size;
 	this->read = read;
 	this->write = write;
+	this->flush = flush;
 	this->context = context;
+	this->dirty = NO;
+	this->replayed = NO;
 
 	memory->rangeCount++;
+	memory->lastRangeHit = index;
 
 	// Finally, if caching is enabled, update the cache
 	if (memory->mapCacheEnabled) {
@@ -132,6 +325,127 @@ int v6502_map(v6502_memory *memory, uint16_t start, size_t size, v6502_readFunct
 	return YES;
 }
 
+int v6502_map(v6502_memory *memory, uint16_t start, size_t size, v6502_readFunction *read, v6502_writeFunction *write, void *context) {
+	return _map(memory, start, size, read, write, NULL, context);
+}
+
+int v6502_mapReplayed(v6502_memory *memory, uint16_t start, size_t size, v6502_readFunction *read, v6502_writeFunction *write, void *context) {
+	if (!_map(memory, start, size, read, write, NULL, context)) {
+		return NO;
+	}
+
+	memory->mappedRanges[memory->lastRangeHit].replayed = YES;
+	return YES;
+}
+
+int v6502_mapDeferred(v6502_memory *memory, uint16_t start, size_t size, v6502_readFunction *read, v6502_flushFunction *flush, void *context) {
+	assert(memory);
+	assert(flush);
+
+	// Write trapping is done a page at a time
+	if (start % v6502_memoryPageSize || size % v6502_memoryPageSize) {
+		return NO;
+	}
+	for (size_t i = start / v6502_memoryPageSize; i < (start + size) / v6502_memoryPageSize && i < v6502_memoryPageCount; i++) {
+		if (!memory->readPages[i]) {
+			return NO;
+		}
+	}
+
+	if (!_map(memory, start, size, read, NULL, flush, context)) {
+		return NO;
+	}
+
+	// Clearing the write pages sends every write through the slow path in v6502_writeBacking
+	for (size_t i = start / v6502_memoryPageSize; i < (start + size) / v6502_memoryPageSize; i++) {
+		memory->pageFlags[i] |= v6502_pageFlag_deferred;
+		memory->writePages[i] = NULL;
+	}
+
+	return YES;
+}
+
+void v6502_flushMemory(v6502_memory *memory) {
+	assert(memory);
+
+	for (size_t i = 0; i < memory->rangeCount && memory->dirtyRangeCount; i++) {
+		v6502_mappedRange *range = &memory->mappedRanges[i];
+		if (range->dirty) {
+			// Clear first, so that the callback can safely write to the range
+			range->dirty = NO;
+			memory->dirtyRangeCount--;
+			range->flush(memory, range->dirtyStart, range->dirtyEnd - range->dirtyStart + 1, range->context);
+		}
+	}
+}
+
+/**
+ * Writes to mapped hardware, logging whatever it writes to memory in turn,
+ * unless the CPU is replaying, in which case the hardware has already seen
+ * the write, and only what it wrote to memory the first time is written again.
+ * Replayed hardware sees every write again instead, so nothing is logged.
+ */
+static void _writeMapped(v6502_memory *memory, uint16_t offset, uint8_t value, v6502_writeFunction *write, void *context) {
+	v6502_replayLog *log = memory->replayLog;
+	if (!log) {
+		write(memory, offset, value, context);
+		return;
+	}
+
+	v6502_mappedRange *range = _rangeForOffset(memory, offset);
+	if (range && range->replayed) {
+		write(memory, offset, value, context);
+		return;
+	}
+
+	if (log->replaying) {
+		while (log->position < log->count && log->entries[log->position].type == v6502_replayEntry_write) {
+			v6502_replayEntry *entry = &log->entries[log->position++];
+			v6502_writeBacking(memory, entry->address, entry->value);
+		}
+		return;
+	}
+
+	log->hardware++;
+	write(memory, offset, value, context);
+	log->hardware--;
+}
+
+/** Adds a write made by virtual hardware to the replay log, if one is being recorded */
+static void _logHardwareWrite(v6502_memory *memory, uint16_t offset, uint8_t value) {
+	v6502_replayLog *log = memory->replayLog;
+	if (log->replaying || !v6502_logReplayEntry(log, v6502_replayEntry_write, log->hardwareCycles, value)) {
+		return;
+	}
+	log->entries[log->count - 1].address = offset;
+}
+
+/** Reads from mapped hardware, recording what it said, or repeating what it said the first time when the CPU is replaying */
+static uint8_t _readMapped(v6502_memory *memory, uint16_t offset, int trap, v6502_readFunction *read, void *context) {
+	v6502_replayLog *log = memory->replayLog;
+	if (!log || !trap) {
+		return read(memory, offset, trap, context);
+	}
+
+	if (log->replaying) {
+		// Replayed hardware is read again for its side effects, but the CPU still gets what it read the first time
+		v6502_mappedRange *range = _rangeForOffset(memory, offset);
+		if (range && range->replayed) {
+			read(memory, offset, trap, context);
+		}
+
+		// Reads that were never recorded can't be answered without disturbing the hardware, so they read as zero
+		if (log->position < log->count && log->entries[log->position].type == v6502_replayEntry_read) {
+			return log->entries[log->position++].value;
+		}
+		return 0;
+	}
+
+	uint8_t value = read(memory, offset, trap, context);
+	v6502_logReplayEntry(log, v6502_replayEntry_read, 0, value);
+	return value;
+}
+
 void v6502_write(v6502_memory *memory, uint16_t offset, uint8_t value) {
 	assert(memory);
 
@@ -139,24 +453,22 @@ void v6502_write(v6502_memory *memory, uint16_t offset, uint8_t value) {
 		// Check cache
 		if (memory->writeCache && memory->writeCache[offset]) {
 			void *context = memory->contextCache ? memory->contextCache[offset] : NULL;
-			memory->writeCache[offset](memory, offset, value, context);
+			_writeMapped(memory, offset, value, memory->writeCache[offset], context);
 			return;
 		}
 	}
 	else {
 		// Check hard map
 		v6502_mappedRange *range = v6502_mappedRangeForOffset(memory, offset);
-		assert((offset < memory->size) || (range && range->write));
 
 		if (range && range->write) {
-			range->write(memory, offset, value, range->context);
+			_writeMapped(memory, offset, value, range->write, range->context);
 			return;
 		}
 	}
 
 	// Not memory mapped
-	assert(memory->bytes);
-	memory->bytes[offset] = value;
+	v6502_writeBacking(memory, offset, value);
 }
 
 uint8_t v6502_read(v6502_memory *memory, uint16_t offset, int trap) {
@@ -166,22 +478,247 @@ uint8_t v6502_read(v6502_memory *memory, uint16_t offset, int trap) {
 		// Check cache
 		if (memory->readCache && memory->readCache[offset]) {
 			void *context = memory->contextCache ? memory->contextCache[offset] : NULL;
-			return memory->readCache[offset](memory, offset, trap, context);
+			return _readMapped(memory, offset, trap, memory->readCache[offset], context);
 		}
 	}
 	else {
 		// Search mapped memory regions to see if we should defer to the map
 		v6502_mappedRange *range = v6502_mappedRangeForOffset(memory, offset);
-		assert((offset < memory->size) || (range && range->read));
 
 		if (range && range->read) {
-			return range->read(memory, offset, trap, range->context);
+			return _readMapped(memory, offset, trap, range->read, range->context);
 		}
 	}
 
 	// Not memory mapped
-	assert(memory->bytes);
-	return memory->bytes[offset];
+	return v6502_readBacking(memory, offset);
+}
+
+/**
+ * Gives a page that is only readable (such as the shared zero page of sparse
+ * memory, or a page from a v6502_pagePool) a writable copy of its contents.
+ * Flat memory copies back into its own storage, while sparse memory allocates
+ * a private page. Returns NO if the page budget doesn't allow it.
+ */
+static int _materializePage(v6502_memory *memory, size_t page) {
+	uint8_t *copy;
+	if (memory->bytes) {
+		copy = _homePage(memory, page);
+		assert(copy);
+	}
+	else {
+		if (memory->pageBudget && memory->pageCount >= memory->pageBudget) {
+			if (memory->fault_callback) {
+				memory->fault_callback(memory->fault_context, v6502_pageBudgetErrorText);
+			}
+			return NO;
+		}
+
+		copy = malloc(v6502_memoryPageSize);
+		if (!copy) {
+			return NO;
+		}
+		memory->pageCount++;
+		memory->pageFlags[page] |= v6502_pageFlag_private;
+	}
+	memcpy(copy, memory->readPages[page], v6502_memoryPageSize);
+
+	if (memory->pageFlags[page] & v6502_pageFlag_shared) {
+		_releaseSharedPage(memory->pagePool, (v6502_sharedPage *)memory->readPages[page]);
+		memory->pageFlags[page] &= ~v6502_pageFlag_shared;
+	}
+
+	memory->readPages[page] = copy;
+
+	// Deferred pages need their writes to keep taking the slow path
+	if (!(memory->pageFlags[page] & v6502_pageFlag_deferred)) {
+		memory->writePages[page] = copy;
+	}
+	return YES;
+}
+
+static v6502_savedPage *_foreignSaveForOrigin(v6502_memorySnapshot *snapshot, const uint8_t *origin) {
+	for (size_t i = 0; i < snapshot->foreignCount; i++) {
+		if (snapshot->foreignPages[i].origin == origin) {
+			return &snapshot->foreignPages[i];
+		}
+	}
+
+	return NULL;
+}
+
+static int _addForeignSave(v6502_memorySnapshot *snapshot, uint8_t *origin, uint8_t *bytes) {
+	v6502_savedPage *pages = realloc(snapshot->foreignPages, sizeof(v6502_savedPage) * (snapshot->foreignCount + 1));
+	if (!pages) {
+		return NO;
+	}
+
+	snapshot->foreignPages = pages;
+	snapshot->foreignPages[snapshot->foreignCount].origin = origin;
+	snapshot->foreignPages[snapshot->foreignCount].bytes = bytes;
+	snapshot->foreignCount++;
+	return YES;
+}
+
+/**
+ * Saves a protected page in the newest snapshot, before its first write since
+ * the snapshot was taken, and lets later writes take the fast path again if
+ * nothing else needs them to take the slow path.
+ */
+static void _savePage(v6502_memory *memory, size_t page) {
+	memory->pageFlags[page] &= ~v6502_pageFlag_protected;
+
+	v6502_memorySnapshot *snapshot = memory->snapshot;
+	if (snapshot && (memory->pageFlags[page] & v6502_pageFlag_foreign)) {
+		// Foreign pages are saved by where they live, since they may be mapped somewhere else, or nowhere, by the time they are restored
+		if (!_foreignSaveForOrigin(snapshot, memory->readPages[page])) {
+			uint8_t *bytes = malloc(v6502_memoryPageSize);
+			if (bytes && _addForeignSave(snapshot, memory->readPages[page], bytes)) {
+				memcpy(bytes, memory->readPages[page], v6502_memoryPageSize);
+			}
+			else {
+				free(bytes);
+				if (memory->fault_callback) {
+					memory->fault_callback(memory->fault_context, v6502_snapshotErrorText);
+				}
+			}
+		}
+	}
+	else if (snapshot && !snapshot->pages[page]) {
+		snapshot->pages[page] = malloc(v6502_memoryPageSize);
+		if (snapshot->pages[page]) {
+			memcpy(snapshot->pages[page], memory->readPages[page], v6502_memoryPageSize);
+		}
+		else if (memory->fault_callback) {
+			memory->fault_callback(memory->fault_context, v6502_snapshotErrorText);
+		}
+	}
+
+	if (!(memory->pageFlags[page] & (v6502_pageFlag_deferred | v6502_pageFlag_shared)) && memory->readPages[page] != _zeroPage) {
+		memory->writePages[page] = memory->readPages[page];
+	}
+}
+
+void v6502_writeBacking(v6502_memory *memory, uint16_t offset, uint8_t value) {
+	if (memory->replayLog && memory->replayLog->hardware) {
+		_logHardwareWrite(memory, offset, value);
+	}
+
+	size_t page = offset / v6502_memoryPageSize;
+	if (memory->writePages[page]) {
+		memory->writePages[page][offset % v6502_memoryPageSize] = value;
+		return;
+	}
+
+	// Slow path, for pages that need to know about writes
+	assert(memory->readPages[page]);
+
+	// First write since a snapshot, which may be all the slow path was for
+	if (memory->pageFlags[page] & v6502_pageFlag_protected) {
+		_savePage(memory, page);
+		if (memory->writePages[page]) {
+			memory->writePages[page][offset % v6502_memoryPageSize] = value;
+			return;
+		}
+	}
+
+	// First write to a page of sparse memory, or to a shared page
+	if ((memory->readPages[page] == _zeroPage || (memory->pageFlags[page] & v6502_pageFlag_shared)) && !_materializePage(memory, page)) {
+		return;
+	}
+
+	if (memory->pageFlags[page] & v6502_pageFlag_deferred) {
+		v6502_mappedRange *range = _rangeForOffset(memory, offset);
+		assert(range && range->flush);
+		_recordDeferredWrite(memory, range, offset, offset);
+	}
+
+	memory->readPages[page][offset % v6502_memoryPageSize] = value;
+}
+
+uint8_t v6502_readBacking(v6502_memory *memory, uint16_t offset) {
+	const uint8_t *page = memory->readPages[offset / v6502_memoryPageSize];
+	assert(page);
+	return page[offset % v6502_memoryPageSize];
+}
+
+/** Clips a transfer to the top of the address space, and to the end of the page it starts in */
+static size_t _chunkSize(uint32_t offset, size_t remaining) {
+	size_t chunk = v6502_memoryPageSize - (offset % v6502_memoryPageSize);
+	return (remaining < chunk) ? remaining : chunk;
+}
+
+size_t v6502_readBackingBytes(v6502_memory *memory, uint16_t offset, uint8_t *bytes, size_t size) {
+	assert(memory && bytes);
+
+	if (size > 0x10000 - (size_t)offset) {
+		size = 0x10000 - (size_t)offset;
+	}
+
+	for (size_t i = 0; i < size;) {
+		uint32_t address = (uint32_t)offset + i;
+		size_t chunk = _chunkSize(address, size - i);
+		const uint8_t *page = memory->readPages[address / v6502_memoryPageSize];
+
+		if (page) {
+			memcpy(bytes + i, page + (address % v6502_memoryPageSize), chunk);
+		}
+		else {
+			memset(bytes + i, 0, chunk);
+		}
+		i += chunk;
+	}
+
+	return size;
+}
+
+size_t v6502_writeBackingBytes(v6502_memory *memory, uint16_t offset, const uint8_t *bytes, size_t size) {
+	assert(memory && bytes);
+
+	if (size > 0x10000 - (size_t)offset) {
+		size = 0x10000 - (size_t)offset;
+	}
+
+	if (memory->replayLog && memory->replayLog->hardware) {
+		for (size_t i = 0; i < size; i++) {
+			_logHardwareWrite(memory, offset + i, bytes[i]);
+		}
+	}
+
+	for (size_t i = 0; i < size;) {
+		uint32_t address = (uint32_t)offset + i;
+		size_t chunk = _chunkSize(address, size - i);
+		size_t page = address / v6502_memoryPageSize;
+		i += chunk;
+
+		if (memory->writePages[page]) {
+			memcpy(memory->writePages[page] + (address % v6502_memoryPageSize), bytes + i - chunk, chunk);
+			continue;
+		}
+
+		// The same slow path as v6502_writeBacking, taken once per page rather than once per byte
+		if (!memory->readPages[page]) {
+			continue;
+		}
+		if (memory->pageFlags[page] & v6502_pageFlag_protected) {
+			_savePage(memory, page);
+			if (memory->writePages[page]) {
+				memcpy(memory->writePages[page] + (address % v6502_memoryPageSize), bytes + i - chunk, chunk);
+				continue;
+			}
+		}
+		if ((memory->readPages[page] == _zeroPage || (memory->pageFlags[page] & v6502_pageFlag_shared)) && !_materializePage(memory, page)) {
+			continue;
+		}
+		if (memory->pageFlags[page] & v6502_pageFlag_deferred) {
+			v6502_mappedRange *range = _rangeForOffset(memory, address);
+			assert(range && range->flush);
+			_recordDeferredWrite(memory, range, address, address + chunk - 1);
+		}
+		memcpy(memory->readPages[page] + (address % v6502_memoryPageSize), bytes + i - chunk, chunk);
+	}
+
+	return size;
 }
 
 void v6502_loadExpansionRomIntoMemory(v6502_memory *memory, uint8_t *rom, uint16_t size) {
@@ -192,8 +729,118 @@ void v6502_loadExpansionRomIntoMemory(v6502_memory *memory, uint8_t *rom, uint16
 	}
 }
 
+void v6502_releasePage(v6502_memory *memory, size_t page) {
+	assert(memory && page < v6502_memoryPageCount);
+
+	if (memory->pageFlags[page] & v6502_pageFlag_private) {
+		free(memory->readPages[page]);
+		memory->pageCount--;
+	}
+	else if (memory->pageFlags[page] & v6502_pageFlag_shared) {
+		_releaseSharedPage(memory->pagePool, (v6502_sharedPage *)memory->readPages[page]);
+	}
+
+	memory->pageFlags[page] &= ~(v6502_pageFlag_private | v6502_pageFlag_shared | v6502_pageFlag_protected | v6502_pageFlag_foreign);
+	memory->readPages[page] = NULL;
+	memory->writePages[page] = NULL;
+}
+
+void v6502_repointPage(v6502_memory *memory, size_t page, uint8_t *bytes) {
+	assert(memory && page < v6502_memoryPageCount && bytes);
+
+	v6502_releasePage(memory, page);
+	memory->readPages[page] = bytes;
+	memory->pageFlags[page] |= v6502_pageFlag_foreign;
+
+	// What the page points at now may not have been saved in the newest snapshot yet, and deferred pages need their writes to keep taking the slow path
+	if (memory->snapshot) {
+		memory->pageFlags[page] |= v6502_pageFlag_protected;
+	}
+	else if (!(memory->pageFlags[page] & v6502_pageFlag_deferred)) {
+		memory->writePages[page] = bytes;
+	}
+}
+
+/** Pages that are deferred, or that virtual hardware has pointed elsewhere, keep their contents when loading */
+static int _pageIsShareable(v6502_memory *memory, size_t page) {
+	if (page >= _backedPageCount(memory) || (memory->pageFlags[page] & v6502_pageFlag_deferred)) {
+		return NO;
+	}
+
+	return (memory->pageFlags[page] & (v6502_pageFlag_private | v6502_pageFlag_shared)) || memory->readPages[page] == _homePage(memory, page);
+}
+
+size_t v6502_loadBytesIntoMemory(v6502_memory *memory, const uint8_t *bytes, size_t size, uint16_t address) {
+	assert(memory);
+
+	// Anything past the top of the address space is dropped
+	if (size > 0x10000 - (size_t)address) {
+		size = 0x10000 - (size_t)address;
+	}
+
+	size_t i = 0;
+	while (i < size) {
+		uint16_t offset = address + i;
+		size_t page = offset / v6502_memoryPageSize;
+
+		// Whole pages are shared, if possible
+		if (memory->pagePool && !(offset % v6502_memoryPageSize) && size - i >= v6502_memoryPageSize && _pageIsShareable(memory, page)) {
+			// Retain before releasing, in case the page is already shared with itself
+			v6502_sharedPage *shared = _retainSharedPage(memory->pagePool, bytes + i);
+			if (shared) {
+				if (memory->pageFlags[page] & v6502_pageFlag_protected) {
+					_savePage(memory, page);
+				}
+				v6502_releasePage(memory, page);
+				memory->readPages[page] = shared->bytes;
+				memory->pageFlags[page] |= v6502_pageFlag_shared;
+				i += v6502_memoryPageSize;
+				continue;
+			}
+		}
+
+		// Everything else is copied, up to the next page boundary
+		i += v6502_writeBackingBytes(memory, offset, bytes + i, _chunkSize(offset, size - i));
+	}
+
+	return size;
+}
+
+void v6502_clearMemory(v6502_memory *memory) {
+	assert(memory);
+
+	for (size_t i = 0; i < v6502_memoryPageCount; i++) {
+		if (memory->pageFlags[i] & v6502_pageFlag_protected) {
+			_savePage(memory, i);
+		}
+
+		if (memory->pageFlags[i] & v6502_pageFlag_deferred) {
+			uint16_t start = i * v6502_memoryPageSize;
+			if (memory->readPages[i] != _zeroPage) {
+				memset(memory->readPages[i], 0, v6502_memoryPageSize);
+			}
+			_recordDeferredWrite(memory, _rangeForOffset(memory, start), start, start + v6502_memoryPageSize - 1);
+		}
+		else if (memory->pageFlags[i] & (v6502_pageFlag_private | v6502_pageFlag_shared)) {
+			// Sparse and shared pages go back to being unwritten
+			v6502_releasePage(memory, i);
+			memory->readPages[i] = _homePage(memory, i);
+			if (memory->bytes) {
+				memset(memory->readPages[i], 0, v6502_memoryPageSize);
+				memory->writePages[i] = memory->readPages[i];
+			}
+		}
+		else if (memory->writePages[i]) {
+			memset(memory->writePages[i], 0, v6502_memoryPageSize);
+		}
+	}
+}
+
 /**
  *	If there are allocation problems, v6502_createMemory will return NULL.
+ *
+ *	The backing storage is rounded up to a whole number of pages, and only the
+ *	first 64k of it is reachable through the page tables.
  */
 v6502_memory *v6502_createMemory(size_t size) {
 	// Allocate Memory Struct
@@ -203,8 +850,8 @@ v6502_memory *v6502_createMemory(size_t size) {
 	}
 
 	// Allocate the backing storage
-	// Is doing it this way overly pedantic? The count and size are effectively reversed.
-	memory->bytes = calloc(size, sizeof(uint8_t));
+	size_t pageCount = (size + v6502_memoryPageSize - 1) / v6502_memoryPageSize;
+	memory->bytes = calloc(pageCount, v6502_memoryPageSize);
 	if (!memory->bytes) {
 		free(memory);
 		return NULL;
@@ -212,6 +859,33 @@ v6502_memory *v6502_createMemory(size_t size) {
 
 	memory->size = size;
 
+	// Point the page tables at it
+	for (size_t i = 0; i < pageCount && i < v6502_memoryPageCount; i++) {
+		memory->readPages[i] = memory->bytes + (i * v6502_memoryPageSize);
+		memory->writePages[i] = memory->readPages[i];
+	}
+
+	return memory;
+}
+
+/**
+ *	If there are allocation problems, v6502_createSparseMemory will return NULL.
+ */
+v6502_memory *v6502_createSparseMemory(size_t size, size_t pageBudget) {
+	// Allocate Memory Struct
+	v6502_memory *memory = calloc(1, sizeof(v6502_memory));
+	if (!memory) {
+		return NULL;
+	}
+
+	memory->size = size;
+	memory->pageBudget = pageBudget;
+
+	// Every page reads as zero until it is first written
+	for (size_t i = 0; i < _backedPageCount(memory); i++) {
+		memory->readPages[i] = _zeroPage;
+	}
+
 	return memory;
 }
 
@@ -220,6 +894,14 @@ void v6502_destroyMemory(v6502_memory *memory) {
 		return;
 	}
 
+	for (size_t i = 0; i < v6502_memoryPageCount; i++) {
+		v6502_releasePage(memory, i);
+	}
+
+	while (memory->snapshot) {
+		v6502_destroyMemorySnapshot(memory, memory->snapshot);
+	}
+
 	free(memory->readCache);
 	free(memory->writeCache);
 	free(memory->contextCache);
@@ -229,6 +911,208 @@ void v6502_destroyMemory(v6502_memory *memory) {
 	free(memory);
 }
 
+#pragma mark -
+#pragma mark Snapshots
+
+static void _freeSavedPages(v6502_memorySnapshot *snapshot) {
+	for (size_t i = 0; i < v6502_memoryPageCount; i++) {
+		free(snapshot->pages[i]);
+		snapshot->pages[i] = NULL;
+	}
+
+	for (size_t i = 0; i < snapshot->foreignCount; i++) {
+		free(snapshot->foreignPages[i].bytes);
+	}
+	free(snapshot->foreignPages);
+	snapshot->foreignPages = NULL;
+	snapshot->foreignCount = 0;
+}
+
+/** Whether saved is the first snapshot from oldest on to have saved origin, which is the one that knows what it held when oldest was taken */
+static int _foreignSaveIsOldest(v6502_memorySnapshot *oldest, v6502_memorySnapshot *saved, const uint8_t *origin) {
+	for (v6502_memorySnapshot *older = oldest; older != saved; older = older->newer) {
+		if (_foreignSaveForOrigin(older, origin)) {
+			return NO;
+		}
+	}
+
+	return YES;
+}
+
+/** Copies a saved foreign page back where it came from, and lets deferred ranges that show it know about the change */
+static void _restoreForeignPage(v6502_memory *memory, v6502_savedPage *page) {
+	memcpy(page->origin, page->bytes, v6502_memoryPageSize);
+
+	for (size_t i = 0; i < v6502_memoryPageCount; i++) {
+		if (memory->readPages[i] == page->origin && (memory->pageFlags[i] & v6502_pageFlag_deferred)) {
+			uint16_t start = i * v6502_memoryPageSize;
+			_recordDeferredWrite(memory, _rangeForOffset(memory, start), start, start + v6502_memoryPageSize - 1);
+		}
+	}
+}
+
+static void _protectPages(v6502_memory *memory) {
+	for (size_t i = 0; i < v6502_memoryPageCount; i++) {
+		if (memory->readPages[i]) {
+			memory->pageFlags[i] |= v6502_pageFlag_protected;
+			memory->writePages[i] = NULL;
+		}
+	}
+}
+
+/**
+ *	If there are allocation problems, v6502_snapshotMemory will return NULL,
+ *	and the newest snapshot is left as it was.
+ */
+v6502_memorySnapshot *v6502_snapshotMemory(v6502_memory *memory) {
+	assert(memory);
+
+	v6502_memorySnapshot *snapshot = calloc(1, sizeof(v6502_memorySnapshot));
+	if (!snapshot) {
+		return NULL;
+	}
+
+	for (size_t i = 0; i < v6502_memoryPageCount; i++) {
+		if (memory->pageFlags[i] & v6502_pageFlag_foreign) {
+			snapshot->mapped[i] = memory->readPages[i];
+		}
+	}
+
+	snapshot->older = memory->snapshot;
+	if (snapshot->older) {
+		snapshot->older->newer = snapshot;
+	}
+	memory->snapshot = snapshot;
+
+	_protectPages(memory);
+	return snapshot;
+}
+
+void v6502_restoreMemorySnapshot(v6502_memory *memory, v6502_memorySnapshot *snapshot) {
+	assert(memory && snapshot);
+
+	// Nothing saves the pages being restored
+	memory->snapshot = NULL;
+
+	// Virtual hardware's pages are pointed back where they were first, such as to the banks that were switched in
+	for (size_t i = 0; i < v6502_memoryPageCount; i++) {
+		if (snapshot->mapped[i] && memory->readPages[i] != snapshot->mapped[i]) {
+			v6502_repointPage(memory, i, snapshot->mapped[i]);
+		}
+	}
+
+	// A page saved by a newer snapshot still held what it held when this one was taken, unless this one saved it first
+	for (size_t i = 0; i < v6502_memoryPageCount; i++) {
+		if (memory->pageFlags[i] & v6502_pageFlag_foreign) {
+			continue;
+		}
+
+		for (v6502_memorySnapshot *saved = snapshot; saved; saved = saved->newer) {
+			if (saved->pages[i]) {
+				v6502_writeBackingBytes(memory, i * v6502_memoryPageSize, saved->pages[i], v6502_memoryPageSize);
+				break;
+			}
+		}
+	}
+
+	// The same goes for virtual hardware's memory, wherever it is mapped now
+	for (v6502_memorySnapshot *saved = snapshot; saved; saved = saved->newer) {
+		for (size_t i = 0; i < saved->foreignCount; i++) {
+			v6502_savedPage *page = &saved->foreignPages[i];
+			if (_foreignSaveIsOldest(snapshot, saved, page->origin)) {
+				_restoreForeignPage(memory, page);
+			}
+		}
+	}
+
+	while (snapshot->newer) {
+		v6502_memorySnapshot *newer = snapshot->newer;
+		snapshot->newer = newer->newer;
+		_freeSavedPages(newer);
+		free(newer);
+	}
+
+	_freeSavedPages(snapshot);
+
+	memory->snapshot = snapshot;
+	_protectPages(memory);
+}
+
+void v6502_destroyMemorySnapshot(v6502_memory *memory, v6502_memorySnapshot *snapshot) {
+	assert(memory && snapshot);
+
+	v6502_memorySnapshot *older = snapshot->older;
+	for (size_t i = 0; i < v6502_memoryPageCount; i++) {
+		if (older && !older->pages[i]) {
+			older->pages[i] = snapshot->pages[i];
+		}
+		else {
+			free(snapshot->pages[i]);
+		}
+	}
+
+	for (size_t i = 0; i < snapshot->foreignCount; i++) {
+		v6502_savedPage *page = &snapshot->foreignPages[i];
+		if (!older || _foreignSaveForOrigin(older, page->origin) || !_addForeignSave(older, page->origin, page->bytes)) {
+			free(page->bytes);
+		}
+	}
+	free(snapshot->foreignPages);
+
+	if (older) {
+		older->newer = snapshot->newer;
+	}
+	if (snapshot->newer) {
+		snapshot->newer->older = older;
+	}
+	else {
+		// Pages protected for this snapshot are saved for the older one instead, which is correct, since they haven't changed since it was taken either
+		memory->snapshot = older;
+	}
+
+	free(snapshot);
+}
+
+#pragma mark -
+#pragma mark Replay Logs
+
+/**
+ *	If there are allocation problems, v6502_createReplayLog will return NULL.
+ */
+v6502_replayLog *v6502_createReplayLog(void) {
+	return calloc(1, sizeof(v6502_replayLog));
+}
+
+void v6502_destroyReplayLog(v6502_replayLog *log) {
+	if (!log) {
+		return;
+	}
+
+	free(log->entries);
+	free(log);
+}
+
+int v6502_logReplayEntry(v6502_replayLog *log, v6502_replayEntryType type, uint64_t cycles, uint8_t value) {
+	assert(log);
+
+	if (log->count == log->capacity) {
+		size_t capacity = log->capacity ? log->capacity * 2 : 256;
+		v6502_replayEntry *entries = realloc(log->entries, sizeof(v6502_replayEntry) * capacity);
+		if (!entries) {
+			return NO;
+		}
+		log->entries = entries;
+		log->capacity = capacity;
+	}
+
+	v6502_replayEntry *entry = &log->entries[log->count++];
+	entry->cycles = cycles;
+	entry->type = type;
+	entry->value = value;
+	entry->address = 0;
+	return YES;
+}
+
 #pragma mark -
 #pragma mark Signedness Management
 
@@ -67,6 +67,10 @@
 #define v6502_memorySizeWorkMemory          0x0800
 /** @brief Size of PPU registers for the RP2C02 chipset */
 #define v6502_memorySizePPURegisters        0x0008
+/** @brief Size of a single page, which is the granularity of the v6502_memory page tables */
+#define v6502_memoryPageSize                0x0100
+/** @brief Number of pages in the 64k address space */
+#define v6502_memoryPageCount               0x0100
 /** @brief Size of the six interrupt vector bytes (Hint: It's six.) */
 #define v6502_memorySizeInterruptVectors    (v6502_memoryStartCeiling - v6502_memoryStartInterruptVectors)
 
@@ -98,6 +102,118 @@ struct _v6502_memory;
 typedef uint8_t (v6502_readFunction)(struct _v6502_memory *memory, uint16_t offset, int trap, void *context);
 /** @brief The function prototype for memory mapped accessors to be used by external virtual hardware. */
 typedef void (v6502_writeFunction)(struct _v6502_memory *memory, uint16_t offset, uint8_t value, void *context);
+/** @brief The function prototype for batched write notifications to be used by external virtual hardware (See: v6502_mapDeferred) */
+typedef void (v6502_flushFunction)(struct _v6502_memory *memory, uint16_t start, size_t size, void *context);
+
+/** @enum */
+/** @brief Page Table Flags */
+typedef enum {
+	/** @brief Writes to this page are stored, then reported to a v6502_flushFunction by v6502_flushMemory */
+	v6502_pageFlag_deferred = 1 << 0,
+	/** @brief This page was allocated on its first write, and is owned by the v6502_memory (See: v6502_createSparseMemory) */
+	v6502_pageFlag_private  = 1 << 1,
+	/** @brief This page is a read-only v6502_sharedPage, and is copied on its first write (See: v6502_pagePool) */
+	v6502_pageFlag_shared   = 1 << 2,
+	/** @brief This page hasn't been written since the newest v6502_memorySnapshot was taken, and is saved on its first write (See: @ref mem_snapshots) */
+	v6502_pageFlag_protected = 1 << 3,
+	/** @brief This page points at host memory owned by virtual hardware, which snapshots save by where it points (See: v6502_repointPage) */
+	v6502_pageFlag_foreign  = 1 << 4,
+} v6502_pageFlag;
+
+/** @struct */
+/** @brief Reference counted page of memory, shared by every v6502_memory that loaded the same contents */
+typedef struct _v6502_sharedPage {
+	/** @brief Contents of the page, which come first so that a page table entry is also a pointer to its v6502_sharedPage */
+	uint8_t bytes[v6502_memoryPageSize];
+	/** @brief Hash of the contents */
+	uint32_t hash;
+	/** @brief Number of page table entries pointing at this page */
+	size_t references;
+	/** @brief Next page in the same hash bucket */
+	struct _v6502_sharedPage *next;
+} v6502_sharedPage;
+
+/** @struct */
+/** @brief Content addressed set of v6502_sharedPage's (See: @ref mem_pages) */
+typedef struct {
+	/** @brief Hash table of pages, chained through v6502_sharedPage::next */
+	v6502_sharedPage **buckets;
+	/** @brief Number of buckets in the hash table, which is always a power of two */
+	size_t bucketCount;
+	/** @brief Number of distinct pages in the pool */
+	size_t pageCount;
+} v6502_pagePool;
+
+/** @struct */
+/** @brief Page of host memory owned by virtual hardware, as it was when a v6502_memorySnapshot was taken */
+typedef struct {
+	/** @brief Host memory that the page was saved from, and is restored to */
+	uint8_t *origin;
+	/** @brief What it held */
+	uint8_t *bytes;
+} v6502_savedPage;
+
+/** @struct */
+/** @brief Copy-on-Write Snapshot of v6502_memory (See: @ref mem_snapshots) */
+typedef struct _v6502_memorySnapshot {
+	/** @brief What each page held when the snapshot was taken, or NULL if it hasn't been written since, or a newer snapshot was taken first */
+	uint8_t *pages[v6502_memoryPageCount];
+	/** @brief Where each page with v6502_pageFlag_foreign pointed when the snapshot was taken, or NULL for every other page */
+	uint8_t *mapped[v6502_memoryPageCount];
+	/** @brief Pages of host memory owned by virtual hardware that have been written since the snapshot was taken, saved by their origin rather than by page, since they may not be mapped anymore */
+	v6502_savedPage *foreignPages;
+	/** @brief Number of foreignPages */
+	size_t foreignCount;
+	/** @brief Next older snapshot, or NULL */
+	struct _v6502_memorySnapshot *older;
+	/** @brief Next newer snapshot, or NULL if this is the newest */
+	struct _v6502_memorySnapshot *newer;
+} v6502_memorySnapshot;
+
+/** @enum */
+/** @brief Kinds of v6502_replayEntry */
+typedef enum {
+	/** @brief A byte read by the CPU from mapped hardware */
+	v6502_replayEntry_read,
+	/** @brief An IRQ taken by the CPU */
+	v6502_replayEntry_irq,
+	/** @brief An NMI taken by the CPU */
+	v6502_replayEntry_nmi,
+	/** @brief A byte written to memory by virtual hardware, such as by DMA */
+	v6502_replayEntry_write,
+} v6502_replayEntryType;
+
+/** @struct */
+/** @brief Something the CPU got from virtual hardware, which has to happen again the same way when replaying */
+typedef struct {
+	/** @brief Value of v6502_cpu::cycles when an interrupt was taken, or when a scheduled event wrote to memory, which isn't used for reads */
+	uint64_t cycles;
+	/** @brief v6502_replayEntryType of the entry */
+	uint8_t type;
+	/** @brief Byte that was read or written */
+	uint8_t value;
+	/** @brief Address that was written */
+	uint16_t address;
+} v6502_replayEntry;
+
+/** @struct */
+/** @brief Log of Hardware Input, for Deterministic Replay (See: @ref mem_replay) */
+typedef struct {
+	/** @brief Entries, in the order they happened */
+	v6502_replayEntry *entries;
+	/** @brief Number of entries */
+	size_t count;
+	/** @brief Number of entries that fit before the array has to grow */
+	size_t capacity;
+	/** @brief Index of the next entry to replay */
+	size_t position;
+	/** @brief Whether hardware input comes from the log, rather than being added to it */
+	int replaying;
+	/** @brief Nonzero while virtual hardware is being called, from a mapped write or a scheduled event, so that what it writes to memory is added to the log */
+	int hardware;
+	/** @brief Value of v6502_cpu::cycles when the last scheduled event was called */
+	uint64_t hardwareCycles;
+} v6502_replayLog;
 
 /** @struct */
 /** @brief Memory Map Range Record */
@@ -110,14 +226,24 @@ typedef struct {
 	v6502_readFunction *read;
 	/** @brief Memory access callback for writing bytes within this memory range */
 	v6502_writeFunction *write;
+	/** @brief Batched write notification callback for deferred ranges, or NULL for ordinary ranges (See: v6502_mapDeferred) */
+	v6502_flushFunction *flush;
 	/** @brief Context pointer, generally used to point to hardware data structures so that they can be referenced when called back to  */
 	void *context;
+	/** @brief Lowest address written since the last flush of a deferred range */
+	uint16_t dirtyStart;
+	/** @brief Highest address written since the last flush of a deferred range */
+	uint16_t dirtyEnd;
+	/** @brief Whether a deferred range has been written since the last flush */
+	int dirty;
+	/** @brief Whether the range is called again while a v6502_replayLog is replaying (See: v6502_mapReplayed) */
+	int replayed;
 } v6502_mappedRange;
 
 /** @struct */
 /** @brief Virtual Memory Object */
 typedef struct /** @cond STRUCT_FORWARD_DECLS */ _v6502_memory /** @endcond */ {
-	/** @brief Memory accessible as a byte-array */
+	/** @brief Flat backing storage allocated by v6502_createMemory, which the page tables point into by default, or NULL for sparse memory */
 	uint8_t *bytes;
 	/** @brief Byte-length of memory object */
 	size_t size;
@@ -125,10 +251,14 @@ typedef struct /** @cond STRUCT_FORWARD_DECLS */ _v6502_memory /** @endcond */ {
 	void(*fault_callback)(void *context, const char *reason);
 	/** @brief Fault Callback Context */
 	void *fault_context;
-	/** @brief Array of memory map ranges */
+	/** @brief Array of memory map ranges, sorted by start address */
 	v6502_mappedRange *mappedRanges;
 	/** @brief Number of memory map ranges in array */
 	size_t rangeCount;
+	/** @brief Index of the last range found by any lookup of an address, or the last one mapped, which is checked before searching */
+	size_t lastRangeHit;
+	/** @brief Number of deferred ranges waiting to be flushed */
+	size_t dirtyRangeCount;
 	/** @brief @ref mem_cache control */
 	int mapCacheEnabled;
 	/** @brief Memory map read cache (See: @ref mem_cache) */
@@ -137,23 +267,97 @@ typedef struct /** @cond STRUCT_FORWARD_DECLS */ _v6502_memory /** @endcond */ {
 	v6502_writeFunction **writeCache;
 	/** @brief Memory map context cache (See: @ref mem_cache) */
 	void **contextCache;
+	/** @brief Host memory backing each page for reads, or NULL if nothing backs the page (See: @ref mem_pages) */
+	uint8_t *readPages[v6502_memoryPageCount];
+	/** @brief Host memory backing each page for writes, or NULL if writes must take the slow path (See: @ref mem_pages) */
+	uint8_t *writePages[v6502_memoryPageCount];
+	/** @brief v6502_pageFlag bits for each page */
+	uint8_t pageFlags[v6502_memoryPageCount];
+	/** @brief Number of pages allocated on first write */
+	size_t pageCount;
+	/** @brief Maximum number of pages that may be allocated on first write, or 0 for no limit */
+	size_t pageBudget;
+	/** @brief Pool that v6502_loadBytesIntoMemory shares whole pages through, or NULL to always copy */
+	v6502_pagePool *pagePool;
+	/** @brief Newest v6502_memorySnapshot, which saves pages as they are first written, or NULL */
+	v6502_memorySnapshot *snapshot;
+	/** @brief Log that hardware input is recorded to, or replayed from, or NULL (See: @ref mem_replay) */
+	v6502_replayLog *replayLog;
 } v6502_memory;
 
 /** @defgroup mem_lifecycle Memory Lifecycle Functions */
 /**@{*/
 /** @brief Create v6502_memory, type is a size_t so that you can alloc an entire 64k with 0x1,0000 */
 v6502_memory *v6502_createMemory(size_t size);
+/** @brief Create v6502_memory that only allocates pages as they are written */
+/** Every page starts out reading as zeroes from a single shared page, and gets a private page of host memory on its first write. A program that only touches zero page and the stack costs two pages, rather than the full size. If pageBudget is nonzero, writes that would allocate more pages than that are dropped, and reported through v6502_memory::fault_callback. */
+v6502_memory *v6502_createSparseMemory(size_t size, size_t pageBudget);
 /** @brief Destroy v6502_memory */
 void v6502_destroyMemory(v6502_memory *memory);
+/** @brief Zero all writable pages of a given v6502_memory, without triggering any memory mapped hardware */
+/** Pages of sparse memory are released, and go back to reading from the shared zero page. */
+void v6502_clearMemory(v6502_memory *memory);
 /** @brief Load a binary blob of expansion ROM into a given v6502_memory */
 void v6502_loadExpansionRomIntoMemory(v6502_memory *memory, uint8_t *rom, uint16_t size);
+/** @brief Load a binary image into the storage backing v6502_memory at a given address, bypassing any memory mapping */
+/** If v6502_memory::pagePool is set, every page that the image covers completely is looked up in the pool by its contents, and the page table is pointed at the shared copy instead of copying it. The first write to a shared page gives it a private copy again. Bytes beyond the end of the address space are ignored. Returns the number of bytes loaded. */
+size_t v6502_loadBytesIntoMemory(v6502_memory *memory, const uint8_t *bytes, size_t size, uint16_t address);
+/** @brief Release any host memory that v6502_memory owns or shares for a single page */
+/** This is for virtual hardware that is about to point the page tables somewhere else. The page is left unbacked. */
+void v6502_releasePage(v6502_memory *memory, size_t page);
+/** @brief Point a page at host memory owned by virtual hardware, such as a bank of v6502_extendedMemory */
+/** The page is released first, and marked with v6502_pageFlag_foreign, so that snapshots save what it points at by where it lives, and put the page table back the way it was when restoring. While there is a snapshot, the page is protected, so its first write saves the memory it points at now. */
+void v6502_repointPage(v6502_memory *memory, size_t page, uint8_t *bytes);
+/**@}*/
+
+/** @defgroup mem_pool Page Pool Lifecycle Functions */
+/**@{*/
+/** @brief Create an empty v6502_pagePool */
+/** Assign it to v6502_memory::pagePool of as many v6502_memory's as you like, so that they can share identical pages loaded with v6502_loadBytesIntoMemory. A pool is not thread safe, so every v6502_memory sharing it must be used from the same thread. */
+v6502_pagePool *v6502_createPagePool(void);
+/** @brief Destroy v6502_pagePool */
+/** Every v6502_memory using the pool must be destroyed first. */
+void v6502_destroyPagePool(v6502_pagePool *pool);
+/**@}*/
+
+/** @defgroup mem_snapshots Memory Snapshots */
+/**@{*/
+/** @brief Take a copy-on-write v6502_memorySnapshot of v6502_memory, returning NULL if it can't be allocated */
+/** Taking a snapshot doesn't copy anything. Instead, every backed page is protected, so that its next write takes the slow path, and saves the page in the newest snapshot first. Only the pages written between one snapshot and the next cost any memory, and each page is only copied once. Snapshots are owned by the v6502_memory, and are destroyed along with it. Pages that were pointed at host memory owned by virtual hardware with v6502_repointPage are saved by the memory they point at, rather than by address, and the page tables are pointed back where they were when restoring, so switching banks is undone along with whatever was written to them. */
+v6502_memorySnapshot *v6502_snapshotMemory(v6502_memory *memory);
+/** @brief Put v6502_memory back the way it was when a v6502_memorySnapshot was taken */
+/** Every newer snapshot is destroyed, and the snapshot is taken again, so that it is the newest. Restored pages are written like v6502_writeBackingBytes, so deferred ranges see the change at the next flush. */
+void v6502_restoreMemorySnapshot(v6502_memory *memory, v6502_memorySnapshot *snapshot);
+/** @brief Destroy a v6502_memorySnapshot, without changing v6502_memory */
+/** The pages it saved are handed to the next older snapshot, if that one hasn't saved them itself, so that older snapshots can still be restored. */
+void v6502_destroyMemorySnapshot(v6502_memory *memory, v6502_memorySnapshot *snapshot);
+/**@}*/
+
+/** @defgroup mem_replay Replay Logs */
+/**@{*/
+/** While v6502_memory::replayLog is set, every read the CPU makes from mapped hardware, and every interrupt it takes, is added to the log. What virtual hardware writes to memory while it is being called, from a mapped write or a scheduled event, is added too, since that is input to the CPU as much as a read is. While the log is replaying, those come from the log instead, starting at v6502_replayLog::position, and writes to mapped hardware are dropped, with the memory they wrote the first time being written again in their place, unless the hardware was mapped with v6502_mapReplayed. Scheduled events aren't called while replaying either, so that running the CPU again from an earlier state does exactly what it did the first time, without the hardware noticing. Reads that the CPU doesn't trap, such as those made by debuggers, still go to the hardware. */
+/** @brief Create an empty v6502_replayLog */
+v6502_replayLog *v6502_createReplayLog(void);
+/** @brief Destroy v6502_replayLog */
+void v6502_destroyReplayLog(v6502_replayLog *log);
+/** @brief Add an entry to a v6502_replayLog, returning NO if it couldn't grow */
+int v6502_logReplayEntry(v6502_replayLog *log, v6502_replayEntryType type, uint64_t cycles, uint8_t value);
 /**@}*/
 
 /** @defgroup mem_access Memory Access */
 /**@{*/
 /** @brief Map an address in v6502_memory */
-/** This works by registering an v6502_memoryAccessor as the handler for that range of v6502_memory. Anytime an access is made to that range of memory, the v6502_memoryAccessor is called instead, and is expected to return a byte ready for access. When this function is called, it is also assumed that an access is actually going to happen, which means it is safe to use calls to your callback as trap signals. This function returns YES if the mapping succeedsm, and NO if it fails. It is highly reccomended that you assert, or at least check the return code. */
+/** This works by registering an v6502_memoryAccessor as the handler for that range of v6502_memory. Anytime an access is made to that range of memory, the v6502_memoryAccessor is called instead, and is expected to return a byte ready for access. When this function is called, it is also assumed that an access is actually going to happen, which means it is safe to use calls to your callback as trap signals. This function returns YES if the mapping succeedsm, and NO if it fails. It is highly reccomended that you assert, or at least check the return code. Ranges can't be unmapped, so hardware that is destroyed leaves its callbacks and context behind, and the v6502_memory must not be used afterwards. */
 int v6502_map(v6502_memory *memory, uint16_t start, size_t size, v6502_readFunction *read, v6502_writeFunction *write, void *context);
+/** @brief Map an address in v6502_memory, like v6502_map, for hardware whose state is put back along with memory snapshots */
+/** Writes to the range are made again while a v6502_replayLog is replaying, rather than being dropped, and reads still call the hardware for their side effects, though the CPU gets what it read the first time. This is for hardware whose state lives in the page tables, like the bank registers of v6502_extendedMemory, or is restored along with memory some other way. */
+int v6502_mapReplayed(v6502_memory *memory, uint16_t start, size_t size, v6502_readFunction *read, v6502_writeFunction *write, void *context);
+/** @brief Map a page aligned range of v6502_memory whose writes are reported in batches */
+/** Writes to a deferred range are stored in memory like any other write, and the range is marked dirty, instead of calling back for every byte. The next call to v6502_flushMemory calls flush once with the span of addresses that were written. This is meant for hardware like framebuffers, where only the end result of many writes matters; registers with side effects should use v6502_map instead. Reads call the read callback, if one is given, or read memory otherwise. Both start and size must be multiples of v6502_memoryPageSize, and the range must be backed by memory. This function returns YES if the mapping succeeds, and NO if it fails. */
+int v6502_mapDeferred(v6502_memory *memory, uint16_t start, size_t size, v6502_readFunction *read, v6502_flushFunction *flush, void *context);
+/** @brief Report all pending writes to deferred ranges in v6502_memory (See: v6502_mapDeferred) */
+/** This should be called at batch boundaries, like the end of a v6502_run, or the end of a frame. */
+void v6502_flushMemory(v6502_memory *memory);
 /** @brief Read a byte from v6502_memory */
 /** All accesses made by the v6502_cpu should travel through these functions, so that they respect any hardware memory mapping.
 	The trap argument should always be YES when accessed by the CPU, and always NO when accessed by any virtual hardware outside the CPU, or any VM construct (such as logging/introspection mechanisms.)
@@ -162,7 +366,19 @@ uint8_t v6502_read(v6502_memory *memory, uint16_t offset, int trap);
 /** @brief Write a byte to v6502_memory */
 /** All accesses made by the v6502_cpu should travel through these functions, so that they respect any hardware memory mapping. */
 void v6502_write(v6502_memory *memory, uint16_t offset, uint8_t value);
+/** @brief Read a byte from the storage backing v6502_memory, bypassing any memory mapping */
+/** This is intended for virtual hardware that needs to look at the memory underneath its own mapping, such as a video device displaying the bytes written to it. */
+uint8_t v6502_readBacking(v6502_memory *memory, uint16_t offset);
+/** @brief Write a byte to the storage backing v6502_memory, bypassing any memory mapping */
+void v6502_writeBacking(v6502_memory *memory, uint16_t offset, uint8_t value);
+/** @brief Copy a block of bytes out of the storage backing v6502_memory, bypassing any memory mapping */
+/** This is for virtual hardware that moves whole blocks, like DMA, and copies a page at a time, rather than a byte at a time. Pages that nothing backs read as zeroes. The copy stops at the top of the address space, and the number of bytes copied is returned. */
+size_t v6502_readBackingBytes(v6502_memory *memory, uint16_t offset, uint8_t *bytes, size_t size);
+/** @brief Copy a block of bytes into the storage backing v6502_memory, bypassing any memory mapping */
+/** This behaves like a v6502_writeBacking for every byte, so deferred ranges are still marked dirty, and sparse or shared pages are still copied on write, but it only takes the slow path once per page. Writes to pages that nothing backs are dropped. The copy stops at the top of the address space, and the number of bytes copied is returned. */
+size_t v6502_writeBackingBytes(v6502_memory *memory, uint16_t offset, const uint8_t *bytes, size_t size);
 /** @brief Locate a v6502_mappedRange inside of v6502_memory, if it exists */
+/** This is a binary search over the sorted ranges, and is only used when map caching is disabled (See: @ref mem_cache) */
 v6502_mappedRange *v6502_mappedRangeForOffset(v6502_memory *memory, uint16_t offset);
 /** @brief Convert a raw byte to its signed value */
 int8_t v6502_signedValueOfByte(uint8_t byte);
@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <dlfcn.h>
+#include <assert.h>
+
+#include "plugin.h"
+
+static int _mapDevice(v6502_memory *memory, uint16_t start, size_t size, v6502_readFunction *read, v6502_writeFunction *write, void *context);
+static int _mapDeferredDevice(v6502_memory *memory, uint16_t start, size_t size, v6502_readFunction *read, v6502_flushFunction *flush, void *context);
+
+static const v6502_deviceHost _host = {
+	.abiVersion = v6502_deviceABIVersion,
+	.map = _mapDevice,
+	.mapDeferred = _mapDeferredDevice,
+	.readBackingBytes = v6502_readBackingBytes,
+	.writeBackingBytes = v6502_writeBackingBytes,
+	.schedule = v6502_schedule,
+	.cancelEvents = v6502_cancelEvents,
+	.raiseIRQ = v6502_raiseIRQ,
+	.clearIRQ = v6502_clearIRQ,
+	.nmi = v6502_nmi,
+};
+
+/** Every attached device, newest first, since there are only ever a handful */
+static v6502_device *_devices;
+/** The device being created or mapped, whose ranges are replayed if it can be snapshotted */
+static v6502_device *_mappingDevice;
+/** How many ranges the device being created or mapped has mapped so far */
+static size_t _mappedRanges;
+/** The serial of the next device attached */
+static unsigned long _nextSerial = 1;
+
+static int _canSnapshot(const v6502_device *device) {
+	return device->descriptor->snapshot && device->descriptor->restore;
+}
+
+/** Devices that are rewound along with history see the CPU's accesses again when replaying, since their state has gone back too */
+static int _mapDevice(v6502_memory *memory, uint16_t start, size_t size, v6502_readFunction *read, v6502_writeFunction *write, void *context) {
+	int mapped;
+	if (_mappingDevice && _canSnapshot(_mappingDevice)) {
+		mapped = v6502_mapReplayed(memory, start, size, read, write, context);
+	}
+	else {
+		mapped = v6502_map(memory, start, size, read, write, context);
+	}
+
+	_mappedRanges += mapped ? 1 : 0;
+	return mapped;
+}
+
+static int _mapDeferredDevice(v6502_memory *memory, uint16_t start, size_t size, v6502_readFunction *read, v6502_flushFunction *flush, void *context) {
+	int mapped = v6502_mapDeferred(memory, start, size, read, flush, context);
+
+	_mappedRanges += mapped ? 1 : 0;
+	return mapped;
+}
+
+const v6502_deviceHost *v6502_deviceHostInterface(void) {
+	return &_host;
+}
+
+/**
+ *	If the device fails after mapping some of its ranges, they can't be
+ *	unmapped, so the instance is kept alive for them rather than destroyed, and
+ *	stranded is set so that the library it came from isn't closed either.
+ */
+static v6502_device *_attachDevice(v6502_cpu *cpu, const v6502_deviceDescriptor *descriptor, const char *args, int *stranded) {
+	*stranded = NO;
+
+	if (descriptor->abiVersion != v6502_deviceABIVersion || !descriptor->create || !descriptor->map || !descriptor->destroy) {
+		return NULL;
+	}
+
+	v6502_device *device = calloc(1, sizeof(v6502_device));
+	if (!device) {
+		return NULL;
+	}
+
+	device->descriptor = descriptor;
+	device->cpu = cpu;
+	_mappingDevice = device;
+	_mappedRanges = 0;
+	device->instance = descriptor->create(cpu, &_host, args);
+	int mapped = device->instance && descriptor->map(device->instance);
+	_mappingDevice = NULL;
+
+	if (!mapped) {
+		if (_mappedRanges) {
+			*stranded = YES;
+		}
+		else if (device->instance) {
+			descriptor->destroy(device->instance);
+		}
+		free(device);
+		return NULL;
+	}
+
+	device->serial = _nextSerial++;
+	device->next = _devices;
+	_devices = device;
+	return device;
+}
+
+v6502_device *v6502_attachDevice(v6502_cpu *cpu, const v6502_deviceDescriptor *descriptor, const char *args) {
+	assert(cpu && descriptor);
+
+	int stranded;
+	return _attachDevice(cpu, descriptor, args, &stranded);
+}
+
+v6502_device *v6502_loadDevice(v6502_cpu *cpu, const char *path, const char *args) {
+	assert(cpu && path);
+
+	void *library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if (!library) {
+		printf("Could not load plugin: %s\n", dlerror());
+		return NULL;
+	}
+
+	v6502_deviceEntryFunction *entry = (v6502_deviceEntryFunction *)dlsym(library, v6502_deviceEntrySymbol);
+	const v6502_deviceDescriptor *descriptor = entry ? entry() : NULL;
+	if (!descriptor) {
+		printf("\"%s\" is not a device plugin.\n", path);
+		dlclose(library);
+		return NULL;
+	}
+	if (descriptor->abiVersion != v6502_deviceABIVersion) {
+		printf("\"%s\" was built for device ABI version %u, but this is version %u.\n", path, descriptor->abiVersion, v6502_deviceABIVersion);
+		dlclose(library);
+		return NULL;
+	}
+
+	int stranded;
+	v6502_device *device = _attachDevice(cpu, descriptor, args, &stranded);
+	if (!device) {
+		printf("Could not attach %s from \"%s\".\n", descriptor->name ? descriptor->name : "device", path);
+		// Whatever it did map still calls into the library
+		if (!stranded) {
+			dlclose(library);
+		}
+		return NULL;
+	}
+
+	device->library = library;
+	return device;
+}
+
+void v6502_detachDevices(v6502_cpu *cpu) {
+	v6502_device **link = &_devices;
+
+	while (*link) {
+		v6502_device *device = *link;
+		if (device->cpu != cpu) {
+			link = &device->next;
+			continue;
+		}
+
+		*link = device->next;
+		device->descriptor->destroy(device->instance);
+		// The descriptor lives in the library, so it can only be closed after the device is gone
+		if (device->library) {
+			dlclose(device->library);
+		}
+		free(device);
+	}
+}
+
+void v6502_resetDevices(v6502_cpu *cpu) {
+	for (v6502_device *device = _devices; device; device = device->next) {
+		if (device->cpu == cpu && device->descriptor->reset) {
+			device->descriptor->reset(device->instance);
+		}
+	}
+}
+
+/**
+ *	If there are allocation problems, v6502_snapshotDevices will return NULL.
+ */
+v6502_deviceSnapshot *v6502_snapshotDevices(v6502_cpu *cpu) {
+	v6502_deviceSnapshot *snapshot = calloc(1, sizeof(v6502_deviceSnapshot));
+	if (!snapshot) {
+		return NULL;
+	}
+
+	for (v6502_device *device = _devices; device; device = device->next) {
+		if (device->cpu != cpu || !_canSnapshot(device)) {
+			continue;
+		}
+
+		v6502_deviceState *states = realloc(snapshot->states, sizeof(v6502_deviceState) * (snapshot->count + 1));
+		if (!states) {
+			v6502_destroyDeviceSnapshot(snapshot);
+			return NULL;
+		}
+		snapshot->states = states;
+
+		// Asking with no buffer says how big it has to be
+		v6502_deviceState *state = &snapshot->states[snapshot->count];
+		state->serial = device->serial;
+		state->size = device->descriptor->snapshot(device->instance, NULL, 0);
+		state->bytes = malloc(state->size ? state->size : 1);
+		if (!state->bytes) {
+			v6502_destroyDeviceSnapshot(snapshot);
+			return NULL;
+		}
+		snapshot->count++;
+
+		if (device->descriptor->snapshot(device->instance, state->bytes, state->size) > state->size) {
+			v6502_destroyDeviceSnapshot(snapshot);
+			return NULL;
+		}
+	}
+
+	return snapshot;
+}
+
+int v6502_restoreDevices(v6502_cpu *cpu, const v6502_deviceSnapshot *snapshot) {
+	assert(snapshot);
+
+	int restored = YES;
+	for (size_t i = 0; i < snapshot->count; i++) {
+		const v6502_deviceState *state = &snapshot->states[i];
+		for (v6502_device *device = _devices; device; device = device->next) {
+			if (device->serial == state->serial && device->cpu == cpu) {
+				if (!device->descriptor->restore(device->instance, state->bytes, state->size)) {
+					restored = NO;
+				}
+				break;
+			}
+		}
+	}
+
+	return restored;
+}
+
+void v6502_destroyDeviceSnapshot(v6502_deviceSnapshot *snapshot) {
+	if (!snapshot) {
+		return;
+	}
+
+	for (size_t i = 0; i < snapshot->count; i++) {
+		free(snapshot->states[i].bytes);
+	}
+	free(snapshot->states);
+	free(snapshot);
+}
+
+void v6502_printDevices(v6502_cpu *cpu) {
+	for (v6502_device *device = _devices; device; device = device->next) {
+		if (device->cpu == cpu) {
+			printf("%s%s\n", device->descriptor->name ? device->descriptor->name : "(unnamed)", device->library ? "" : " (built in)");
+		}
+	}
+}
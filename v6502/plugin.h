@@ -0,0 +1,155 @@
+/** @brief 6502 Reference Platform Device Plugins */
+/** @file plugin.h */
+
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef v6502_plugin_h
+#define v6502_plugin_h
+
+#include <v6502/cpu.h>
+#include <v6502/mem.h>
+
+/** @brief Version of v6502_deviceHost and v6502_deviceDescriptor, which changes whenever either of them does */
+#define v6502_deviceABIVersion		1
+/** @brief Name of the function a plugin exports, which is a v6502_deviceEntryFunction */
+#define v6502_deviceEntrySymbol		"v6502_deviceEntry"
+
+/** A plugin is a shared object that exports a v6502_deviceEntryFunction named v6502_deviceEntry, which returns a v6502_deviceDescriptor describing the device. The device is handed a v6502_deviceHost, which holds the parts of libv6502 a device needs, so a plugin doesn't have to link against libv6502, and the emulator doesn't have to export its symbols.
+
+	Devices should map their registers with v6502_deviceHost::map, and any framebuffer-like memory a page at a time with v6502_deviceHost::mapDeferred, which notifies them of writes in batches rather than a byte at a time. Anything that has to happen over time should be scheduled for the cycle it happens on with v6502_deviceHost::schedule, rather than checked after every instruction.
+
+	A device with both snapshot and restore hooks is rewound along with the CPU when going back in history (See: @ref history). Its registers are mapped so that they are written and read again while replaying, rather than being replayed from the log, since its state is put back first. Events aren't called while replaying, so restore should cancel the device's events and schedule them again from the state it was given. Devices without the hooks stay where they are, and the CPU is shown what they did the first time.
+ */
+
+/** @defgroup plugin Reference Platform Device Plugins */
+/**@{*/
+/** @struct */
+/** @brief The Parts of libv6502 Available to a Device */
+typedef struct {
+	/** @brief The v6502_deviceABIVersion the host was built with */
+	uint32_t abiVersion;
+	/** @brief v6502_map */
+	int (*map)(v6502_memory *memory, uint16_t start, size_t size, v6502_readFunction *read, v6502_writeFunction *write, void *context);
+	/** @brief v6502_mapDeferred */
+	int (*mapDeferred)(v6502_memory *memory, uint16_t start, size_t size, v6502_readFunction *read, v6502_flushFunction *flush, void *context);
+	/** @brief v6502_readBackingBytes */
+	size_t (*readBackingBytes)(v6502_memory *memory, uint16_t offset, uint8_t *bytes, size_t size);
+	/** @brief v6502_writeBackingBytes */
+	size_t (*writeBackingBytes)(v6502_memory *memory, uint16_t offset, const uint8_t *bytes, size_t size);
+	/** @brief v6502_schedule */
+	int (*schedule)(v6502_cpu *cpu, uint64_t deadline, v6502_eventFunction *callback, void *context);
+	/** @brief v6502_cancelEvents */
+	void (*cancelEvents)(v6502_cpu *cpu, v6502_eventFunction *callback, void *context);
+	/** @brief v6502_raiseIRQ */
+	void (*raiseIRQ)(v6502_cpu *cpu, uint32_t lines);
+	/** @brief v6502_clearIRQ */
+	void (*clearIRQ)(v6502_cpu *cpu, uint32_t lines);
+	/** @brief v6502_nmi */
+	void (*nmi)(v6502_cpu *cpu);
+} v6502_deviceHost;
+
+/** @struct */
+/** @brief Device Plugin Hooks */
+/** Only create, map and destroy are required. */
+typedef struct {
+	/** @brief The v6502_deviceABIVersion the device was built with, which must match the host's */
+	uint32_t abiVersion;
+	/** @brief Name of the device, for the debugger */
+	const char *name;
+	/** @brief Create a device for a v6502_cpu, given whatever arguments it was loaded with, which may be NULL. Returns NULL on failure. */
+	void *(*create)(v6502_cpu *cpu, const v6502_deviceHost *host, const char *args);
+	/** @brief Map the device's registers and memory, and schedule its first events. Returns NO if they can't be mapped. Since ranges can't be unmapped, a device should find out whether it can map everything before mapping anything. If it returns NO after mapping some ranges through the v6502_deviceHost, it is never destroyed, and its plugin is never unloaded, because those ranges still call it. */
+	int (*map)(void *device);
+	/** @brief Put the device back in the state it was created in, such as when the CPU is reset */
+	void (*reset)(void *device);
+	/** @brief Save the state of the device into a buffer, returning how many bytes it took, or would have taken if the buffer is NULL or too small */
+	size_t (*snapshot)(void *device, uint8_t *buffer, size_t size);
+	/** @brief Restore the state of the device from a buffer made by snapshot, returning NO if it isn't valid */
+	int (*restore)(void *device, const uint8_t *buffer, size_t size);
+	/** @brief Cancel the device's events, and free it */
+	void (*destroy)(void *device);
+} v6502_deviceDescriptor;
+
+/** @brief The function a plugin exports, as v6502_deviceEntrySymbol */
+typedef const v6502_deviceDescriptor *(v6502_deviceEntryFunction)(void);
+
+/** @struct */
+/** @brief A Device Attached to a v6502_cpu */
+typedef struct _v6502_device {
+	/** @brief The hooks of the device */
+	const v6502_deviceDescriptor *descriptor;
+	/** @brief What v6502_deviceDescriptor::create returned */
+	void *instance;
+	/** @brief The shared object the device came from, or NULL if it was built in */
+	void *library;
+	/** @brief The v6502_cpu the device is attached to */
+	v6502_cpu *cpu;
+	/** @brief Number unique to the device, which v6502_deviceState finds it by, since it may have been detached since */
+	unsigned long serial;
+	/** @brief The next device attached to anything */
+	struct _v6502_device *next;
+} v6502_device;
+
+/** @struct */
+/** @brief State Saved by One Device's Snapshot Hook */
+typedef struct {
+	/** @brief v6502_device::serial of the device */
+	unsigned long serial;
+	/** @brief What the device saved */
+	uint8_t *bytes;
+	/** @brief Byte-length of bytes */
+	size_t size;
+} v6502_deviceState;
+
+/** @struct */
+/** @brief Snapshot of Every Device Attached to a v6502_cpu That Can Be Snapshotted */
+typedef struct {
+	/** @brief The state of each device */
+	v6502_deviceState *states;
+	/** @brief Number of states */
+	size_t count;
+} v6502_deviceSnapshot;
+
+/** @brief The v6502_deviceHost handed to every device */
+const v6502_deviceHost *v6502_deviceHostInterface(void);
+/** @brief Create a device from its v6502_deviceDescriptor, and attach it to a v6502_cpu */
+/** Returns NULL if the ABI versions don't match, a required hook is missing, or the device can't be created or mapped. A device that couldn't be mapped is destroyed, unless it had already mapped some ranges, as described at v6502_deviceDescriptor::map. */
+v6502_device *v6502_attachDevice(v6502_cpu *cpu, const v6502_deviceDescriptor *descriptor, const char *args);
+/** @brief Load a device from a plugin at a path, and attach it to a v6502_cpu */
+/** Returns NULL, after printing why, if the plugin can't be loaded, or the device can't be attached. */
+v6502_device *v6502_loadDevice(v6502_cpu *cpu, const char *path, const char *args);
+/** @brief Destroy every device attached to a v6502_cpu, and unload any plugins they came from */
+void v6502_detachDevices(v6502_cpu *cpu);
+/** @brief Reset every device attached to a v6502_cpu that has a reset hook */
+void v6502_resetDevices(v6502_cpu *cpu);
+/** @brief Save the state of every device attached to a v6502_cpu that has snapshot and restore hooks, returning NULL if it can't be allocated */
+v6502_deviceSnapshot *v6502_snapshotDevices(v6502_cpu *cpu);
+/** @brief Put every device in a v6502_deviceSnapshot that is still attached back the way it was, returning NO if any of them refused */
+/** Devices attached since the snapshot was taken are left alone. */
+int v6502_restoreDevices(v6502_cpu *cpu, const v6502_deviceSnapshot *snapshot);
+/** @brief Destroy v6502_deviceSnapshot */
+void v6502_destroyDeviceSnapshot(v6502_deviceSnapshot *snapshot);
+/** @brief Print every device attached to a v6502_cpu */
+void v6502_printDevices(v6502_cpu *cpu);
+/**@}*/
+
+#endif
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "ppu.h"
+
+const uint8_t ppu_defaultColors[ppu_colorCount][3] = {
+	{0x00, 0x00, 0x00}, {0x74, 0x74, 0x74}, {0xBC, 0xBC, 0xBC}, {0xFC, 0xFC, 0xFC},
+	{0x00, 0x00, 0x00}, {0xA4, 0x00, 0x00}, {0xF8, 0x38, 0x00}, {0xFC, 0xA0, 0x44},
+	{0x00, 0x00, 0x00}, {0x00, 0x78, 0x00}, {0x00, 0xB8, 0x00}, {0xB8, 0xF8, 0x18},
+	{0x00, 0x00, 0x00}, {0x00, 0x00, 0xBC}, {0x00, 0x78, 0xF8}, {0x3C, 0xBC, 0xFC},
+};
+
+void ppu_decodeTilesScalar(const uint8_t *chr, size_t count, uint8_t *pixels) {
+	for (size_t tile = 0; tile < count; tile++, chr += ppu_bytesPerTile) {
+		for (int y = 0; y < 8; y++) {
+			uint8_t low = chr[y];
+			uint8_t high = chr[y + 8];
+
+			// The leftmost pixel is the most significant bit of each plane
+			for (int x = 0; x < 8; x++) {
+				*pixels++ = ((low >> (7 - x)) & 1) | (((high >> (7 - x)) & 1) << 1);
+			}
+		}
+	}
+}
+
+#ifdef __SSE2__
+/**
+ *	Each plane's byte is repeated across 8 lanes, and compared against a mask
+ *	holding one bit per lane, which spreads the bits of two rows over a vector.
+ */
+static inline __m128i _decodeRows(__m128i low, __m128i high, __m128i bits) {
+	__m128i one = _mm_set1_epi8(1);
+	__m128i lowPixels = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(low, bits), bits), one);
+	__m128i highPixels = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(high, bits), bits), _mm_add_epi8(one, one));
+	return _mm_or_si128(lowPixels, highPixels);
+}
+
+void ppu_decodeTiles(const uint8_t *chr, size_t count, uint8_t *pixels) {
+	const __m128i bits = _mm_setr_epi8(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+
+	for (size_t tile = 0; tile < count; tile++, chr += ppu_bytesPerTile, pixels += ppu_pixelsPerTile) {
+		// Both planes, widened from bytes to runs of 4 (rows 0-3 and 4-7 of each plane)
+		__m128i low = _mm_loadl_epi64((const __m128i *)chr);
+		__m128i high = _mm_loadl_epi64((const __m128i *)(chr + 8));
+		low = _mm_unpacklo_epi8(low, low);
+		high = _mm_unpacklo_epi8(high, high);
+		__m128i low03 = _mm_unpacklo_epi16(low, low);
+		__m128i low47 = _mm_unpackhi_epi16(low, low);
+		__m128i high03 = _mm_unpacklo_epi16(high, high);
+		__m128i high47 = _mm_unpackhi_epi16(high, high);
+
+		// Then to runs of 8, two rows per vector
+		_mm_storeu_si128((__m128i *)(pixels +  0), _decodeRows(_mm_unpacklo_epi32(low03, low03), _mm_unpacklo_epi32(high03, high03), bits));
+		_mm_storeu_si128((__m128i *)(pixels + 16), _decodeRows(_mm_unpackhi_epi32(low03, low03), _mm_unpackhi_epi32(high03, high03), bits));
+		_mm_storeu_si128((__m128i *)(pixels + 32), _decodeRows(_mm_unpacklo_epi32(low47, low47), _mm_unpacklo_epi32(high47, high47), bits));
+		_mm_storeu_si128((__m128i *)(pixels + 48), _decodeRows(_mm_unpackhi_epi32(low47, low47), _mm_unpackhi_epi32(high47, high47), bits));
+	}
+}
+#else
+void ppu_decodeTiles(const uint8_t *chr, size_t count, uint8_t *pixels) {
+	ppu_decodeTilesScalar(chr, count, pixels);
+}
+#endif
+
+v6502_ppu *ppu_create(v6502_memory *mem, uint16_t nametable, const uint8_t *chr, size_t size) {
+	assert(chr || !size);
+
+	size_t tileCount = size / ppu_bytesPerTile;
+	if (!tileCount) {
+		return NULL;
+	}
+
+	v6502_ppu *ppu = calloc(1, sizeof(v6502_ppu));
+	if (!ppu) {
+		return NULL;
+	}
+
+	ppu->memory = mem;
+	ppu->nametableAddress = nametable;
+	ppu->tileCount = tileCount;
+	memcpy(ppu->colors, ppu_defaultColors, sizeof(ppu->colors));
+	ppu->tiles = malloc(tileCount * ppu_paletteCount * ppu_pixelsPerTile);
+	if (!ppu->tiles) {
+		free(ppu);
+		return NULL;
+	}
+
+	// Decode into the palette 0 slot of each tile, then derive the other palettes from it
+	for (size_t tile = 0; tile < tileCount; tile++) {
+		uint8_t *decoded = ppu->tiles + (tile * ppu_paletteCount * ppu_pixelsPerTile);
+		ppu_decodeTiles(chr + (tile * ppu_bytesPerTile), 1, decoded);
+
+		for (int palette = 1; palette < ppu_paletteCount; palette++) {
+			uint8_t *shaded = decoded + (palette * ppu_pixelsPerTile);
+			for (int i = 0; i < ppu_pixelsPerTile; i++) {
+				shaded[i] = decoded[i] ? (uint8_t)((palette << 2) | decoded[i]) : 0;
+			}
+		}
+	}
+
+	return ppu;
+}
+
+void ppu_destroy(v6502_ppu *ppu) {
+	if (!ppu) {
+		return;
+	}
+
+	free(ppu->tiles);
+	free(ppu);
+}
+
+void ppu_renderNametable(v6502_ppu *ppu, const uint8_t *nametable) {
+	const uint8_t *attributes = nametable + ppu_attributeOffset;
+	size_t tableBase = (size_t)ppu->patternTable * ppu_tilesPerTable;
+
+	for (int row = 0; row < ppu_rows; row++) {
+		for (int column = 0; column < ppu_columns; column++) {
+			// Each attribute byte covers 4x4 tiles, with 2 bits for each 2x2 quadrant
+			uint8_t attribute = attributes[(row / 4) * (ppu_columns / 4) + (column / 4)];
+			int palette = (attribute >> ((((row / 2) & 1) << 2) | (((column / 2) & 1) << 1))) & 0x03;
+
+			// Tiles past the end of the CHR data are drawn as backdrop
+			size_t tile = tableBase + nametable[row * ppu_columns + column];
+			const uint8_t *pixels = NULL;
+			if (tile < ppu->tileCount) {
+				pixels = ppu->tiles + (((tile * ppu_paletteCount) + palette) * ppu_pixelsPerTile);
+			}
+
+			for (int y = 0; y < 8; y++) {
+				uint8_t *line = &ppu->framebuffer[row * 8 + y][column * 8];
+				if (pixels) {
+					memcpy(line, pixels + (y * 8), 8);
+				}
+				else {
+					memset(line, 0, 8);
+				}
+			}
+		}
+	}
+}
+
+void ppu_renderBackground(v6502_ppu *ppu) {
+	assert(ppu->memory);
+
+	// Anything past the top of memory reads as tile 0
+	uint8_t nametable[ppu_nametableSize] = {0};
+	v6502_readBackingBytes(ppu->memory, ppu->nametableAddress, nametable, sizeof(nametable));
+	ppu_renderNametable(ppu, nametable);
+}
+
+uint32_t ppu_hashFrame(const v6502_ppu *ppu) {
+	// 32-bit FNV-1a
+	const uint8_t *bytes = &ppu->framebuffer[0][0];
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < sizeof(ppu->framebuffer); i++) {
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	return hash;
+}
+
+int ppu_writeImage(const v6502_ppu *ppu, FILE *file) {
+	if (fprintf(file, "P6\n%d %d\n255\n", ppu_width, ppu_height) < 0) {
+		return NO;
+	}
+
+	// A line at a time, so that the colors are looked up into a buffer rather than written a pixel at a time
+	uint8_t line[ppu_width][3];
+	for (int y = 0; y < ppu_height; y++) {
+		for (int x = 0; x < ppu_width; x++) {
+			memcpy(line[x], ppu->colors[ppu->framebuffer[y][x] % ppu_colorCount], 3);
+		}
+		if (fwrite(line, 1, sizeof(line), file) != sizeof(line)) {
+			return NO;
+		}
+	}
+
+	return YES;
+}
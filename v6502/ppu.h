@@ -0,0 +1,104 @@
+/** @brief 6502 Reference Platform Pattern Table Renderer */
+/** @file ppu.h */
+
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef v6502_ppu_h
+#define v6502_ppu_h
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <v6502/mem.h>
+
+/** @brief Width of the framebuffer in pixels */
+#define ppu_width				256
+/** @brief Height of the framebuffer in pixels */
+#define ppu_height				240
+/** @brief Number of tiles across a nametable */
+#define ppu_columns				32
+/** @brief Number of tiles down a nametable */
+#define ppu_rows				30
+/** @brief Bytes of CHR data per 8x8 tile, which is two bit planes of 8 bytes each */
+#define ppu_bytesPerTile		16
+/** @brief Pixels per 8x8 tile */
+#define ppu_pixelsPerTile		64
+/** @brief Number of tiles in a pattern table */
+#define ppu_tilesPerTable		256
+/** @brief Number of background palettes */
+#define ppu_paletteCount		4
+/** @brief Number of palette indices a pixel can be */
+#define ppu_colorCount			(ppu_paletteCount * 4)
+/** @brief Size of a nametable, including its attribute table */
+#define ppu_nametableSize		0x400
+/** @brief Offset of the attribute table within a nametable */
+#define ppu_attributeOffset		(ppu_columns * ppu_rows)
+
+/** Pixels in the framebuffer are palette indices, the way the NES's PPU has them before they reach the screen. Each is (palette << 2) | color, except that color 0 of every palette is the shared backdrop, index 0.
+
+	CHR data never changes, so every tile is decoded once, for every palette, when v6502_ppu is created, and drawing a nametable only copies rows of pixels.
+ */
+
+/** @defgroup ppu Pattern Table Renderer */
+/**@{*/
+/** @struct */
+/** @brief Background Renderer Object */
+typedef struct {
+	/** @brief The v6502_memory the nametable is read from, or NULL if it is only ever handed in */
+	v6502_memory *memory;
+	/** @brief Address of the nametable in v6502_ppu::memory */
+	uint16_t nametableAddress;
+	/** @brief Which pattern table the background uses, when the CHR data holds more than one */
+	uint8_t patternTable;
+	/** @brief Number of tiles in the CHR data */
+	size_t tileCount;
+	/** @brief Every tile decoded for every palette, ppu_pixelsPerTile bytes each, indexed by (tile * ppu_paletteCount) + palette */
+	uint8_t *tiles;
+	/** @brief Rendered palette indices */
+	uint8_t framebuffer[ppu_height][ppu_width];
+	/** @brief Red, green and blue of each palette index, for ppu_writeImage, which start out as ppu_defaultColors */
+	uint8_t colors[ppu_colorCount][3];
+} v6502_ppu;
+
+/** @brief Colors of the palette indices until they are changed, which are a black backdrop, then greys, reds, greens and blues from the NES's master palette */
+extern const uint8_t ppu_defaultColors[ppu_colorCount][3];
+
+/** @brief Decode 2bpp CHR tiles into one byte per pixel, using SIMD where it's available */
+void ppu_decodeTiles(const uint8_t *chr, size_t count, uint8_t *pixels);
+/** @brief Decode 2bpp CHR tiles into one byte per pixel, a bit at a time, as a reference for ppu_decodeTiles */
+void ppu_decodeTilesScalar(const uint8_t *chr, size_t count, uint8_t *pixels);
+/** @brief Create a v6502_ppu from CHR data, such as the CHR ROM of an iNES image */
+/** The nametable is read from mem at nametable when rendering with ppu_renderBackground. mem can be NULL if the nametable is only ever passed to ppu_renderNametable. Any partial tile at the end of the CHR data is ignored. Returns NULL if there are no whole tiles, or allocation fails. */
+v6502_ppu *ppu_create(v6502_memory *mem, uint16_t nametable, const uint8_t *chr, size_t size);
+/** @brief Destroy a v6502_ppu */
+void ppu_destroy(v6502_ppu *ppu);
+/** @brief Render a nametable, with its attribute table, into the framebuffer */
+void ppu_renderNametable(v6502_ppu *ppu, const uint8_t *nametable);
+/** @brief Render the nametable in v6502_ppu::memory into the framebuffer */
+void ppu_renderBackground(v6502_ppu *ppu);
+/** @brief Hash the framebuffer, so that it can be compared against a known good render */
+uint32_t ppu_hashFrame(const v6502_ppu *ppu);
+/** @brief Write the framebuffer as a PPM image, with each palette index in its color from v6502_ppu::colors. Returns NO if writing fails. */
+int ppu_writeImage(const v6502_ppu *ppu, FILE *file);
+/**@}*/
+
+#endif
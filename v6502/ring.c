@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "ring.h"
+#include "mem.h"
+
+/**
+ *	If there are allocation problems, v6502_createRing will return NULL.
+ */
+v6502_ring *v6502_createRing(size_t capacity) {
+	v6502_ring *ring = calloc(1, sizeof(v6502_ring));
+	if (!ring) {
+		return NULL;
+	}
+
+	// Round up to a power of two, so that indices can be masked instead of divided
+	ring->capacity = 1;
+	while (ring->capacity < capacity) {
+		ring->capacity <<= 1;
+	}
+
+	ring->bytes = malloc(ring->capacity);
+	if (!ring->bytes) {
+		free(ring);
+		return NULL;
+	}
+
+	return ring;
+}
+
+void v6502_destroyRing(v6502_ring *ring) {
+	if (!ring) {
+		return;
+	}
+
+	free(ring->bytes);
+	free(ring);
+}
+
+int v6502_ringPush(v6502_ring *ring, uint8_t byte) {
+	assert(ring);
+
+	size_t head = ring->head;
+	if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == ring->capacity) {
+		return NO;
+	}
+
+	ring->bytes[head & (ring->capacity - 1)] = byte;
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+	return YES;
+}
+
+int v6502_ringPop(v6502_ring *ring, uint8_t *byte) {
+	assert(ring && byte);
+
+	size_t tail = ring->tail;
+	if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail) {
+		return NO;
+	}
+
+	*byte = ring->bytes[tail & (ring->capacity - 1)];
+	__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+	return YES;
+}
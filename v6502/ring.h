@@ -0,0 +1,59 @@
+/** @brief Lock-free Byte Ring */
+/** @file ring.h */
+
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef v6502_ring_h
+#define v6502_ring_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** @defgroup ring Single Producer, Single Consumer Byte Ring */
+/**@{*/
+/** @struct */
+/** @brief Lock-free Byte Ring */
+/** A ring lets exactly one thread (such as a host input thread) hand bytes to exactly one other thread (such as the thread running the v6502_cpu) without locks. Each index is only ever written by one side, and is published with release/acquire ordering, so neither side can block the other. Using a ring from more than one producer or more than one consumer is not safe.
+ */
+typedef struct {
+	/** @brief Storage for queued bytes */
+	uint8_t *bytes;
+	/** @brief Byte-length of storage, which is always a power of two */
+	size_t capacity;
+	/** @brief Count of bytes ever pushed, only written by the producer */
+	size_t head;
+	/** @brief Count of bytes ever popped, only written by the consumer */
+	size_t tail;
+} v6502_ring;
+
+/** @brief Create a v6502_ring that holds at least the given number of bytes */
+v6502_ring *v6502_createRing(size_t capacity);
+/** @brief Destroy a v6502_ring */
+void v6502_destroyRing(v6502_ring *ring);
+/** @brief Queue a byte, from the producer thread. Returns NO if the ring is full. */
+int v6502_ringPush(v6502_ring *ring, uint8_t byte);
+/** @brief Dequeue a byte, from the consumer thread. Returns NO if the ring is empty. */
+int v6502_ringPop(v6502_ring *ring, uint8_t *byte);
+/**@}*/
+
+#endif
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "search.h"
+#include "mem.h"
+
+#pragma mark Patterns
+
+int search_parsePattern(const char *text, search_pattern *pattern) {
+	assert(text && pattern);
+
+	pattern->length = 0;
+	for (;;) {
+		while (isspace((int)*text)) {
+			text++;
+		}
+		if (!*text) {
+			break;
+		}
+		if (pattern->length == search_maxPatternLength) {
+			return NO;
+		}
+
+		if (text[0] == '?' && text[1] == '?') {
+			pattern->bytes[pattern->length] = 0;
+			pattern->mask[pattern->length++] = 0x00;
+			text += 2;
+		}
+		else {
+			if (*text == '$') {
+				text++;
+			}
+			char *end;
+			unsigned long byte = strtoul(text, &end, 16);
+			if (end == text || end - text > 2 || byte > 0xFF) {
+				return NO;
+			}
+			pattern->bytes[pattern->length] = (uint8_t)byte;
+			pattern->mask[pattern->length++] = 0xFF;
+			text = end;
+		}
+
+		if (*text && !isspace((int)*text)) {
+			return NO;
+		}
+	}
+
+	return pattern->length > 0;
+}
+
+static inline int _matchesAt(const uint8_t *bytes, const search_pattern *pattern) {
+	for (size_t i = 0; i < pattern->length; i++) {
+		if ((bytes[i] ^ pattern->bytes[i]) & pattern->mask[i]) {
+			return NO;
+		}
+	}
+	return YES;
+}
+
+static inline void _record(size_t offset, size_t *matches, size_t maxMatches, size_t count) {
+	if (count < maxMatches) {
+		matches[count] = offset;
+	}
+}
+
+size_t search_findPatternScalar(const uint8_t *bytes, size_t size, const search_pattern *pattern, size_t *matches, size_t maxMatches) {
+	size_t count = 0;
+	for (size_t offset = 0; offset + pattern->length <= size; offset++) {
+		if (_matchesAt(bytes + offset, pattern)) {
+			_record(offset, matches, maxMatches, count++);
+		}
+	}
+	return count;
+}
+
+#ifdef __SSE2__
+/**
+ *	The first byte that isn't a wildcard is the anchor. Sixteen starting
+ *	offsets are checked for it with one compare, and the whole pattern is only
+ *	checked at the offsets whose bit is set in the compare's mask.
+ */
+size_t search_findPattern(const uint8_t *bytes, size_t size, const search_pattern *pattern, size_t *matches, size_t maxMatches) {
+	size_t anchor = 0;
+	while (anchor < pattern->length && !pattern->mask[anchor]) {
+		anchor++;
+	}
+	if (anchor == pattern->length || size < pattern->length) {
+		return search_findPatternScalar(bytes, size, pattern, matches, maxMatches);
+	}
+
+	const __m128i needle = _mm_set1_epi8((char)pattern->bytes[anchor]);
+	size_t starts = size - pattern->length + 1;
+	size_t count = 0;
+	size_t offset = 0;
+	for (; offset + 16 <= starts; offset += 16) {
+		__m128i window = _mm_loadu_si128((const __m128i *)(bytes + offset + anchor));
+		unsigned hits = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(window, needle));
+		while (hits) {
+			size_t start = offset + __builtin_ctz(hits);
+			hits &= hits - 1;
+			if (_matchesAt(bytes + start, pattern)) {
+				_record(start, matches, maxMatches, count++);
+			}
+		}
+	}
+
+	for (; offset < starts; offset++) {
+		if (_matchesAt(bytes + offset, pattern)) {
+			_record(offset, matches, maxMatches, count++);
+		}
+	}
+	return count;
+}
+#else
+size_t search_findPattern(const uint8_t *bytes, size_t size, const search_pattern *pattern, size_t *matches, size_t maxMatches) {
+	return search_findPatternScalar(bytes, size, pattern, matches, maxMatches);
+}
+#endif
+
+#pragma mark Tracking
+
+void search_startTracking(search_tracker *tracker, const uint8_t *bytes) {
+	assert(tracker && bytes);
+
+	memcpy(tracker->previous, bytes, search_trackedSize);
+	memset(tracker->candidates, 0xFF, search_trackedSize);
+	tracker->count = search_trackedSize;
+}
+
+static inline int _follows(uint8_t current, uint8_t previous, search_rule rule, uint8_t value) {
+	switch (rule) {
+		case search_rule_changed:
+			return current != previous;
+		case search_rule_unchanged:
+			return current == previous;
+		case search_rule_increased:
+			return current > previous;
+		case search_rule_decreased:
+			return current < previous;
+		case search_rule_equal:
+			return current == value;
+	}
+	return NO;
+}
+
+size_t search_filterScalar(search_tracker *tracker, const uint8_t *bytes, search_rule rule, uint8_t value) {
+	assert(tracker && bytes);
+
+	size_t count = 0;
+	for (size_t i = 0; i < search_trackedSize; i++) {
+		if (tracker->candidates[i] && !_follows(bytes[i], tracker->previous[i], rule, value)) {
+			tracker->candidates[i] = 0x00;
+		}
+		count += tracker->candidates[i] & 1;
+	}
+
+	memcpy(tracker->previous, bytes, search_trackedSize);
+	tracker->count = count;
+	return count;
+}
+
+#ifdef __SSE2__
+/** SSE2 only compares unsigned bytes for equality, so ordering goes through the unsigned min and max */
+static inline __m128i _followsVector(__m128i current, __m128i previous, search_rule rule, __m128i value) {
+	__m128i same = _mm_cmpeq_epi8(current, previous);
+	switch (rule) {
+		case search_rule_changed:
+			return _mm_andnot_si128(same, _mm_set1_epi8(-1));
+		case search_rule_unchanged:
+			return same;
+		case search_rule_increased:
+			return _mm_andnot_si128(same, _mm_cmpeq_epi8(_mm_max_epu8(current, previous), current));
+		case search_rule_decreased:
+			return _mm_andnot_si128(same, _mm_cmpeq_epi8(_mm_min_epu8(current, previous), current));
+		case search_rule_equal:
+			return _mm_cmpeq_epi8(current, value);
+	}
+	return _mm_setzero_si128();
+}
+
+size_t search_filter(search_tracker *tracker, const uint8_t *bytes, search_rule rule, uint8_t value) {
+	assert(tracker && bytes);
+
+	const __m128i wanted = _mm_set1_epi8((char)value);
+	size_t count = 0;
+	for (size_t i = 0; i < search_trackedSize; i += 16) {
+		__m128i current = _mm_loadu_si128((const __m128i *)(bytes + i));
+		__m128i previous = _mm_loadu_si128((const __m128i *)(tracker->previous + i));
+		__m128i candidates = _mm_loadu_si128((const __m128i *)(tracker->candidates + i));
+
+		candidates = _mm_and_si128(candidates, _followsVector(current, previous, rule, wanted));
+		_mm_storeu_si128((__m128i *)(tracker->candidates + i), candidates);
+		_mm_storeu_si128((__m128i *)(tracker->previous + i), current);
+		count += __builtin_popcount((unsigned)_mm_movemask_epi8(candidates));
+	}
+
+	tracker->count = count;
+	return count;
+}
+#else
+size_t search_filter(search_tracker *tracker, const uint8_t *bytes, search_rule rule, uint8_t value) {
+	return search_filterScalar(tracker, bytes, rule, value);
+}
+#endif
@@ -0,0 +1,97 @@
+/** @brief Memory Search and Value Tracking */
+/** @file search.h */
+
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef v6502_search_h
+#define v6502_search_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** @brief Longest byte pattern that can be searched for */
+#define search_maxPatternLength		32
+/** @brief Number of addresses a tracker follows, which is the whole address space */
+#define search_trackedSize			0x10000
+
+/** Searches work on a copy of memory, such as one made with v6502_readBackingBytes, so they never touch mapped hardware.
+
+	A pattern search compares one byte of the pattern against 16 bytes of memory at a time, and only checks the rest of the pattern where that byte matched. Tracking keeps the value every address had at the last filter, and whether the address is still a candidate, and filters 16 addresses at a time, the way a cheat search narrows down where a game keeps a counter.
+ */
+
+/** @defgroup search Memory Search */
+/**@{*/
+/** @struct */
+/** @brief A Byte Pattern with Wildcards */
+typedef struct {
+	/** @brief Bytes to match */
+	uint8_t bytes[search_maxPatternLength];
+	/** @brief 0xFF for each byte that has to match, or 0x00 for a wildcard */
+	uint8_t mask[search_maxPatternLength];
+	/** @brief Number of bytes in the pattern */
+	size_t length;
+} search_pattern;
+
+/** @enum */
+/** @brief Rules for Narrowing Down Tracked Addresses */
+typedef enum {
+	/** @brief The value is different than at the last filter */
+	search_rule_changed,
+	/** @brief The value is the same as at the last filter */
+	search_rule_unchanged,
+	/** @brief The value is greater than at the last filter */
+	search_rule_increased,
+	/** @brief The value is less than at the last filter */
+	search_rule_decreased,
+	/** @brief The value is equal to a given value */
+	search_rule_equal,
+} search_rule;
+
+/** @struct */
+/** @brief Addresses Being Narrowed Down */
+typedef struct {
+	/** @brief What every address held at the last filter */
+	uint8_t previous[search_trackedSize];
+	/** @brief 0xFF for every address that is still a candidate, or 0x00 */
+	uint8_t candidates[search_trackedSize];
+	/** @brief Number of candidates left */
+	size_t count;
+} search_tracker;
+
+/** @brief Parse a pattern of hex bytes, separated by spaces, where ?? is a wildcard, returning NO if it isn't valid */
+/** A pattern has to have at least one byte, and no more than search_maxPatternLength. Bytes can be written with or without a leading $. */
+int search_parsePattern(const char *text, search_pattern *pattern);
+/** @brief Find every offset in bytes where a pattern starts, using SIMD where it's available */
+/** Up to maxMatches offsets are stored in matches, in ascending order, but every match is counted in the return value. */
+size_t search_findPattern(const uint8_t *bytes, size_t size, const search_pattern *pattern, size_t *matches, size_t maxMatches);
+/** @brief Find every offset in bytes where a pattern starts, a byte at a time, as a reference for search_findPattern */
+size_t search_findPatternScalar(const uint8_t *bytes, size_t size, const search_pattern *pattern, size_t *matches, size_t maxMatches);
+/** @brief Start tracking every address, remembering the values in a copy of memory of search_trackedSize bytes */
+void search_startTracking(search_tracker *tracker, const uint8_t *bytes);
+/** @brief Keep only the candidates that follow a rule in a new copy of memory, using SIMD where it's available, and return how many are left */
+/** The value is only used by search_rule_equal. The new copy is remembered for the next filter. */
+size_t search_filter(search_tracker *tracker, const uint8_t *bytes, search_rule rule, uint8_t value);
+/** @brief Keep only the candidates that follow a rule, a byte at a time, as a reference for search_filter */
+size_t search_filterScalar(search_tracker *tracker, const uint8_t *bytes, search_rule rule, uint8_t value);
+/**@}*/
+
+#endif
@@ -21,77 +21,495 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
 #include <assert.h>
 
 #include "textmode.h"
 
-static void textMode_updateOffset(v6502_textmode_video *vid, uint16_t address) {
-	if (!vid->screen) {
-		vid->screen = initscr();
+#define textMode_characterMemoryEnd		(textMode_characterMemoryStart + (textMode_columns * textMode_rows))
+#define textMode_attributeOffset			(textMode_attributeMemoryStart - textMode_characterMemoryStart)
+#define textMode_attributeMemoryEnd		(textMode_attributeMemoryStart + (textMode_columns * textMode_rows))
+
+#define textMode_cellCount				(textMode_columns * textMode_rows)
+/** Big enough for a frame where every cell changed, and no two neighbors are the same */
+#define textMode_maxRecordSize			(textMode_cellCount * 8)
+
+#define textMode_colorCount				8
+#define textMode_colorMask				0x07
+#define textMode_brightMask				0x08
+
+/** Every foreground and background combination gets its own pair, except black on black, which is pair 0 (the terminal's defaults) */
+static short textMode_pairForColors(int fg, int bg) {
+	return (fg * textMode_colorCount) + bg;
+}
+
+static uint64_t textMode_hostTime(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static void textMode_buildAttributeTable(v6502_textmode_video *vid) {
+	for (int attribute = 0; attribute < 256; attribute++) {
+		int fg = attribute >> 4;
+		int bg = attribute & 0x0F;
+
+		vid->attributeTable[attribute] = COLOR_PAIR(textMode_pairForColors(fg & textMode_colorMask, bg & textMode_colorMask));
+		if (fg & textMode_brightMask) {
+			vid->attributeTable[attribute] |= A_BOLD;
+		}
+	}
+}
+
+static void textMode_screenIfNeeded(v6502_textmode_video *vid) {
+	if (vid->screen || vid->backend != textMode_backend_curses) {
+		return;
 	}
 
-	char ch = vid->memory->bytes[address];
-	address -= textMode_characterMemoryStart;
+	vid->screen = initscr();
 
-	int x = address % 80;
-	int y = (address - x) / 80;
+	// Keys go to the keyboard device as they are typed, rather than a line at a time
+	cbreak();
+	noecho();
 
-	if (ch) {
-		wmove(vid->screen, y, x);
-		waddch(vid->screen, ch);
+	// Pairs outlive endwin, so they only need to be registered the first time
+	if (!vid->colorsReady && has_colors()) {
+		start_color();
+		for (int fg = 0; fg < textMode_colorCount; fg++) {
+			for (int bg = 0; bg < textMode_colorCount; bg++) {
+				short pair = textMode_pairForColors(fg, bg);
+				if (pair && pair < COLOR_PAIRS) {
+					init_pair(pair, fg, bg);
+				}
+			}
+		}
 	}
+	vid->colorsReady = YES;
 }
 
-static void textMode_write(v6502_memory *memory, uint16_t offset, uint8_t value, void *context) {
+/** Copies a cell from memory into the frame */
+static void textMode_captureCell(v6502_textmode_video *vid, int x, int y) {
+	uint16_t address = textMode_addressForLocation(x, y);
+	char ch = v6502_readBacking(vid->memory, address);
+
+	// Unwritten cells are blank, and control characters would move the cursor
+	vid->frame.characters[y][x] = isprint((unsigned char)ch) ? ch : ' ';
+	vid->frame.attributes[y][x] = v6502_readBacking(vid->memory, address + textMode_attributeOffset);
+}
+
+static void textMode_markCell(v6502_textmode_video *vid, int x, int y) {
+	vid->dirtyCells[y][x / 8] |= 1 << (x % 8);
+	vid->dirtyRows |= 1 << y;
+}
+
+static int textMode_frameIsDue(v6502_textmode_video *vid) {
+	uint64_t now;
+	uint64_t interval;
+
+	if (vid->frameCPU) {
+		now = vid->frameCPU->cycles;
+		interval = vid->frameCycles;
+	}
+	else {
+		now = textMode_hostTime();
+		interval = vid->frameInterval;
+	}
+
+	if (now - vid->lastFrame < interval) {
+		return NO;
+	}
+
+	vid->lastFrame = now;
+	return YES;
+}
+
+/** Marks the cells for the part of [start, end) that falls within [base, limit), which is either the character or attribute memory */
+static void textMode_markSpan(v6502_textmode_video *vid, uint32_t start, uint32_t end, uint32_t base, uint32_t limit) {
+	if (start < base) {
+		start = base;
+	}
+	if (end > limit) {
+		end = limit;
+	}
+
+	for (uint32_t address = start; address < end; address++) {
+		int cell = address - base;
+		textMode_markCell(vid, cell % textMode_columns, cell / textMode_columns);
+	}
+}
+
+static void textMode_flush(v6502_memory *memory, uint16_t start, size_t size, void *context) {
 	v6502_textmode_video *vid = context;
-	vid->memory->bytes[offset] = value;
-	textMode_updateOffset(vid, offset);
-	wrefresh(vid->screen);
+
+	// Changing either a character or its attribute dirties the cell
+	textMode_markSpan(vid, start, (uint32_t)start + size, textMode_characterMemoryStart, textMode_characterMemoryEnd);
+	textMode_markSpan(vid, start, (uint32_t)start + size, textMode_attributeMemoryStart, textMode_attributeMemoryEnd);
+
+	textMode_updateVideo(vid);
 }
 
-v6502_textmode_video *textMode_create(v6502_memory *mem) {
-	v6502_textmode_video *vid = malloc(sizeof(v6502_textmode_video));
-	vid->screen = NULL;
+/** Memory may be NULL, for video that is only ever drawn from its frame, like the player */
+static v6502_textmode_video *textMode_alloc(v6502_memory *mem, textMode_backend backend) {
+	v6502_textmode_video *vid = calloc(1, sizeof(v6502_textmode_video));
+	vid->backend = backend;
 	vid->memory = mem;
-	assert(v6502_map(mem, textMode_characterMemoryStart, textMode_memoryCeiling - textMode_characterMemoryStart, NULL, textMode_write, vid));
+	memset(vid->frame.characters, ' ', sizeof(vid->frame.characters));
+	textMode_buildAttributeTable(vid);
+	textMode_setFrameRate(vid, textMode_defaultFrameRate);
+	return vid;
+}
+
+#pragma mark -
+#pragma mark Recording
+
+static size_t textMode_putVarint(uint8_t *buffer, uint64_t value) {
+	size_t length = 0;
+	do {
+		buffer[length] = value & 0x7F;
+		value >>= 7;
+		if (value) {
+			buffer[length] |= 0x80;
+		}
+		length++;
+	} while (value);
+	return length;
+}
+
+static int textMode_getVarint(FILE *stream, uint64_t *value) {
+	*value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		int byte = fgetc(stream);
+		if (byte == EOF) {
+			return NO;
+		}
+
+		*value |= (uint64_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80)) {
+			return YES;
+		}
+	}
+	return NO;
+}
+
+static int textMode_cellChanged(v6502_textmode_video *vid, size_t cell) {
+	return (&vid->frame.characters[0][0])[cell] != (&vid->recorded.characters[0][0])[cell] ||
+		   (&vid->frame.attributes[0][0])[cell] != (&vid->recorded.attributes[0][0])[cell];
+}
+
+static int textMode_sameCells(v6502_textmode_video *vid, size_t a, size_t b) {
+	return (&vid->frame.characters[0][0])[a] == (&vid->frame.characters[0][0])[b] &&
+		   (&vid->frame.attributes[0][0])[a] == (&vid->frame.attributes[0][0])[b];
+}
+
+static void textMode_recordFrame(v6502_textmode_video *vid) {
+	uint8_t body[textMode_maxRecordSize];
+	size_t length = 0;
+	size_t spans = 0;
+	size_t spanEnd = 0;
+
+	for (size_t cell = 0; cell < textMode_cellCount;) {
+		if (!textMode_cellChanged(vid, cell)) {
+			cell++;
+			continue;
+		}
+
+		size_t start = cell;
+		size_t runs = 0;
+		while (cell < textMode_cellCount && textMode_cellChanged(vid, cell)) {
+			if (cell == start || !textMode_sameCells(vid, cell, cell - 1)) {
+				runs++;
+			}
+			cell++;
+		}
+
+		length += textMode_putVarint(body + length, start - spanEnd);
+		length += textMode_putVarint(body + length, runs);
+		for (size_t run = start; run < cell;) {
+			size_t repeat = 1;
+			while (run + repeat < cell && textMode_sameCells(vid, run, run + repeat)) {
+				repeat++;
+			}
+
+			length += textMode_putVarint(body + length, repeat);
+			body[length++] = (&vid->frame.characters[0][0])[run];
+			body[length++] = (&vid->frame.attributes[0][0])[run];
+			run += repeat;
+		}
+
+		spanEnd = cell;
+		spans++;
+	}
+
+	if (!spans) {
+		return;
+	}
+
+	uint8_t header[20];
+	size_t headerLength = textMode_putVarint(header, vid->recordingCPU->cycles - vid->recordedCycles);
+	headerLength += textMode_putVarint(header + headerLength, spans);
+	fwrite(header, 1, headerLength, vid->recording);
+	fwrite(body, 1, length, vid->recording);
+
+	vid->recorded = vid->frame;
+	vid->recordedCycles = vid->recordingCPU->cycles;
+}
+
+int textMode_startRecording(v6502_textmode_video *vid, FILE *stream, const v6502_cpu *cpu) {
+	assert(vid && stream && cpu);
+
+	const uint8_t header[] = { textMode_recordingVersion, textMode_columns, textMode_rows };
+	if (fwrite(textMode_recordingMagic, 1, 4, stream) != 4 || fwrite(header, 1, sizeof(header), stream) != sizeof(header)) {
+		return NO;
+	}
+
+	// The first frame records everything that isn't blank
+	memset(vid->recorded.characters, ' ', sizeof(vid->recorded.characters));
+	memset(vid->recorded.attributes, 0, sizeof(vid->recorded.attributes));
+	vid->recording = stream;
+	vid->recordingCPU = cpu;
+	vid->recordedCycles = cpu->cycles;
+
+	textMode_recordFrame(vid);
+	return YES;
+}
+
+void textMode_stopRecording(v6502_textmode_video *vid) {
+	if (!vid->recording) {
+		return;
+	}
+
+	textMode_drawFrame(vid);
+	fflush(vid->recording);
+	vid->recording = NULL;
+}
+
+/** Reads the spans of one frame into the frame of vid, marking each cell dirty */
+static int textMode_readFrame(v6502_textmode_video *vid, FILE *stream) {
+	uint64_t spans;
+	if (!textMode_getVarint(stream, &spans)) {
+		return NO;
+	}
+
+	uint64_t cell = 0;
+	for (uint64_t span = 0; span < spans; span++) {
+		uint64_t skip;
+		uint64_t runs;
+		if (!textMode_getVarint(stream, &skip) || !textMode_getVarint(stream, &runs) || skip > textMode_cellCount - cell) {
+			return NO;
+		}
+
+		cell += skip;
+		for (uint64_t run = 0; run < runs; run++) {
+			uint64_t repeat;
+			int ch;
+			int attribute;
+			if (!textMode_getVarint(stream, &repeat) || (ch = fgetc(stream)) == EOF || (attribute = fgetc(stream)) == EOF || repeat > textMode_cellCount - cell) {
+				return NO;
+			}
+
+			for (; repeat; repeat--, cell++) {
+				int x = cell % textMode_columns;
+				int y = cell / textMode_columns;
+				vid->frame.characters[y][x] = isprint(ch) ? ch : ' ';
+				vid->frame.attributes[y][x] = attribute;
+				textMode_markCell(vid, x, y);
+			}
+		}
+	}
+
+	return YES;
+}
+
+int textMode_play(FILE *stream, double speed) {
+	char magic[4];
+	uint8_t header[3];
+	if (fread(magic, 1, sizeof(magic), stream) != sizeof(magic) || memcmp(magic, textMode_recordingMagic, sizeof(magic)) ||
+		fread(header, 1, sizeof(header), stream) != sizeof(header) || header[0] != textMode_recordingVersion ||
+		header[1] != textMode_columns || header[2] != textMode_rows) {
+		return NO;
+	}
+
+	v6502_textmode_video *vid = textMode_alloc(NULL, textMode_backend_curses);
+	int valid = YES;
+	uint64_t cycles;
+
+	while (textMode_getVarint(stream, &cycles)) {
+		if (!textMode_readFrame(vid, stream)) {
+			valid = NO;
+			break;
+		}
+
+		if (speed > 0) {
+			double seconds = cycles / (textMode_playbackClockRate * speed);
+			struct timespec delay = { .tv_sec = (time_t)seconds, .tv_nsec = (long)((seconds - (time_t)seconds) * 1000000000) };
+			nanosleep(&delay, NULL);
+		}
+		textMode_drawFrame(vid);
+	}
+
+	if (vid->screen) {
+		wgetch(vid->screen);
+	}
+	textMode_destroy(vid);
+	return valid;
+}
+
+#pragma mark -
+#pragma mark Video Lifecycle
+
+v6502_textmode_video *textMode_create(v6502_memory *mem, textMode_backend backend) {
+	v6502_textmode_video *vid = textMode_alloc(mem, backend);
+
+	// Character and attribute memory are mapped separately, leaving the gap between them for hardware registers
+	assert(v6502_mapDeferred(mem, textMode_characterMemoryStart, textMode_memorySize, NULL, textMode_flush, vid));
+	assert(v6502_mapDeferred(mem, textMode_attributeMemoryStart, textMode_memorySize, NULL, textMode_flush, vid));
 	return vid;
 }
 
 void textMode_destroy(v6502_textmode_video *vid) {
-	endwin();
+	if (vid->backend == textMode_backend_curses) {
+		endwin();
+	}
 	free(vid);
 }
 
 void textMode_rest(v6502_textmode_video *vid) {
-	vid->screen = NULL;
-	endwin();
+	if (vid->backend == textMode_backend_curses) {
+		vid->screen = NULL;
+		endwin();
+	}
 }
 
+void textMode_setFrameRate(v6502_textmode_video *vid, unsigned int framesPerSecond) {
+	vid->frameCPU = NULL;
+	vid->frameInterval = framesPerSecond ? 1000000000 / framesPerSecond : 0;
+	vid->lastFrame = 0;
+}
 
-void textMode_refreshVideo(v6502_textmode_video *vid) {
-	if (!vid->screen) {
-		vid->screen = initscr();
+void textMode_setFrameCycles(v6502_textmode_video *vid, const v6502_cpu *cpu, uint64_t cycles) {
+	vid->frameCPU = cpu;
+	vid->frameCycles = cycles;
+	vid->lastFrame = cpu->cycles;
+}
+
+void textMode_updateVideo(v6502_textmode_video *vid) {
+	if (vid->dirtyRows && textMode_frameIsDue(vid)) {
+		textMode_drawFrame(vid);
 	}
+}
+
+void textMode_drawFrame(v6502_textmode_video *vid) {
+	if (!vid->dirtyRows) {
+		return;
+	}
+
+	textMode_screenIfNeeded(vid);
+
+	for (int y = 0; y < textMode_rows; y++) {
+		if (!(vid->dirtyRows & (1 << y))) {
+			continue;
+		}
+
+		// Redraw from the first dirty cell to the last, since curses only sends what changed anyway
+		int first = textMode_columns;
+		int last = 0;
+		for (int x = 0; x < textMode_columns; x++) {
+			if (vid->dirtyCells[y][x / 8] & (1 << (x % 8))) {
+				if (x < first) {
+					first = x;
+				}
+				last = x;
+			}
+		}
 
-	for (int y = 0; y < 24; y++) {
-		for (int x = 0; x < 80; x++) {
-			textMode_updateCharacter(vid, x, y);
+		for (int x = first; vid->memory && x <= last; x++) {
+			textMode_captureCell(vid, x, y);
 		}
+
+		// Each run of cells sharing an attribute goes out as one string
+		for (int x = first; vid->screen && x <= last;) {
+			uint8_t attribute = vid->frame.attributes[y][x];
+			int run = x;
+			while (run <= last && vid->frame.attributes[y][run] == attribute) {
+				run++;
+			}
+
+			wattrset(vid->screen, vid->attributeTable[attribute]);
+			mvwaddnstr(vid->screen, y, x, vid->frame.characters[y] + x, run - x);
+			x = run;
+		}
+		memset(vid->dirtyCells[y], 0, sizeof(vid->dirtyCells[y]));
+	}
+
+	vid->dirtyRows = 0;
+	if (vid->screen) {
+		wrefresh(vid->screen);
+	}
+
+	if (vid->recording) {
+		textMode_recordFrame(vid);
 	}
-	wrefresh(vid->screen);
+}
+
+void textMode_refreshVideo(v6502_textmode_video *vid) {
+	for (int y = 0; y < textMode_rows; y++) {
+		for (int x = 0; x < textMode_columns; x++) {
+			textMode_markCell(vid, x, y);
+		}
+	}
+	textMode_drawFrame(vid);
 }
 
 void textMode_updateCharacter(v6502_textmode_video *vid, int x, int y) {
-	uint16_t address = textMode_addressForLocation(x, y);
-	char ch = vid->memory->bytes[address];
+	textMode_screenIfNeeded(vid);
+
+	textMode_captureCell(vid, x, y);
+	if (vid->screen) {
+		mvwaddch(vid->screen, y, x, (chtype)(unsigned char)vid->frame.characters[y][x] | vid->attributeTable[vid->frame.attributes[y][x]]);
+	}
+}
+
+const v6502_textmode_frame *textMode_grabFrame(v6502_textmode_video *vid) {
+	textMode_drawFrame(vid);
+	return &vid->frame;
+}
 
-	if (ch) {
-		wmove(vid->screen, y, x);
-		waddch(vid->screen, ch);
+uint32_t textMode_hashFrame(const v6502_textmode_frame *frame) {
+	// 32-bit FNV-1a
+	const uint8_t *bytes = (const uint8_t *)frame;
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < sizeof(v6502_textmode_frame); i++) {
+		hash = (hash ^ bytes[i]) * 16777619u;
 	}
+	return hash;
+}
+
+size_t textMode_diffFrames(const v6502_textmode_frame *a, const v6502_textmode_frame *b, int *x, int *y) {
+	size_t differences = 0;
+
+	for (int row = 0; row < textMode_rows; row++) {
+		// Most rows of consecutive frames are identical
+		if (!memcmp(a->characters[row], b->characters[row], textMode_columns) && !memcmp(a->attributes[row], b->attributes[row], textMode_columns)) {
+			continue;
+		}
+
+		for (int column = 0; column < textMode_columns; column++) {
+			if (a->characters[row][column] != b->characters[row][column] || a->attributes[row][column] != b->attributes[row][column]) {
+				if (!differences && x && y) {
+					*x = column;
+					*y = row;
+				}
+				differences++;
+			}
+		}
+	}
+
+	return differences;
 }
 
 
 uint16_t textMode_addressForLocation(int x, int y) {
-	return textMode_characterMemoryStart + ((y * 80) + x);
+	return textMode_characterMemoryStart + ((y * textMode_columns) + x);
 }
@@ -26,16 +26,34 @@
 #ifndef v6502_textmode_h
 #define v6502_textmode_h
 
+#include <stdio.h>
 #include <curses.h>
 
 #include <v6502/mem.h>
+#include <v6502/cpu.h>
 
 /** @brief The start address of character data in memory */
 #define textMode_characterMemoryStart	0x2000
 /** @brief The start address of attribute data in memory */
 #define textMode_attributeMemoryStart	0x3000
+/** @brief The start address of hardware registers, between character and attribute data (See: keyboard.h) */
+#define textMode_registerStart			0x2800
 /** @brief The upper bounds of memory reserved for terminal hardware */
 #define textMode_memoryCeiling			0x4000
+/** @brief Size of character data, and of attribute data, rounded up to whole pages */
+#define textMode_memorySize				0x0800
+/** @brief Width of the screen, in characters */
+#define textMode_columns				80
+/** @brief Height of the screen, in characters */
+#define textMode_rows					24
+/** @brief Frames per second of host time, until textMode_setFrameRate or textMode_setFrameCycles is called */
+#define textMode_defaultFrameRate		60
+/** @brief The first bytes of a recording stream (See: textMode_startRecording) */
+#define textMode_recordingMagic			"v6tr"
+/** @brief Version of the recording stream format */
+#define textMode_recordingVersion		1
+/** @brief Emulated cycles per second of host time, when playing a recording at normal speed */
+#define textMode_playbackClockRate		1000000
 
 /** The first two kilobytes of memory (starting at textMode_characterMemoryStart or 0x2000) are character data, starting with the top right, ending with the bottom left, one row at a time, with no interruptions. After a short break for video hardware registers, another 2 kilobytes (starting at textMode_attributeMemoryStart or 0x3000) are attribute data, which correspond to each byte of character data + 0x1000.
  
@@ -44,30 +62,112 @@
 	<- fg -><- bg ->
 	B C C C  B C C C
  
+	Colors are the eight curses colors, in order (black, red, green, yellow, blue, magenta, cyan, white). A bright foreground is drawn bold, while a bright background can't be shown by most terminals, and is ignored. An attribute byte of zero (black on black) is drawn in the terminal's default colors instead, so that programs that never write attributes are still readable.
+ 
 	\image html textmode.png
  */
 
 /** @defgroup textmode Reference Platform Video/Keyboard */
 /**@{*/
+/** @enum */
+/** @brief Where v6502_textmode_video draws its frames */
+typedef enum {
+	/** @brief Draw to the hosting terminal with curses */
+	textMode_backend_curses,
+	/** @brief Only draw into v6502_textmode_video::frame, without touching the terminal */
+	textMode_backend_headless,
+} textMode_backend;
+
+/** @struct */
+/** @brief The contents of the screen as of the last frame */
+typedef struct {
+	/** @brief Printable characters, with unwritten and control characters shown as spaces */
+	char characters[textMode_rows][textMode_columns];
+	/** @brief Attribute bytes for each character */
+	uint8_t attributes[textMode_rows][textMode_columns];
+} v6502_textmode_frame;
+
 /** @struct */
 /** @brief Virtual Text-Mode Hardware Object */
 typedef struct {
-	/** @brief Curses output object */
+	/** @brief Where frames are drawn */
+	textMode_backend backend;
+	/** @brief Every cell drawn so far, which is kept for both backends */
+	v6502_textmode_frame frame;
+	/** @brief Curses output object, or NULL while resting or headless */
 	WINDOW *screen;
+	/** @brief Curses attributes for each attribute byte, computed once at creation, so that cells only need a lookup */
+	attr_t attributeTable[256];
+	/** @brief Whether the color pairs used by attributeTable have been registered with curses */
+	int colorsReady;
 	/** @brief Hardwired memory used to trap video activity and report keyboard input */
 	v6502_memory *memory;
+	/** @brief One bit per character cell, set when the cell has been written since the last frame */
+	uint8_t dirtyCells[textMode_rows][textMode_columns / 8];
+	/** @brief One bit per row, set when any cell in the row is dirty */
+	uint32_t dirtyRows;
+	/** @brief Nanoseconds of host time between frames, or 0 to draw a frame on every flush */
+	uint64_t frameInterval;
+	/** @brief CPU whose v6502_cpu::cycles paces frames instead of host time, or NULL */
+	const v6502_cpu *frameCPU;
+	/** @brief Emulated cycles between frames, when paced by frameCPU */
+	uint64_t frameCycles;
+	/** @brief Host time or cycle count when the last frame was drawn */
+	uint64_t lastFrame;
+	/** @brief Stream that frames are recorded to, or NULL when not recording */
+	FILE *recording;
+	/** @brief CPU whose v6502_cpu::cycles timestamps recorded frames */
+	const v6502_cpu *recordingCPU;
+	/** @brief Cycle count when the last frame was recorded */
+	uint64_t recordedCycles;
+	/** @brief The screen as of the last recorded frame, which the next one is compared against */
+	v6502_textmode_frame recorded;
 } v6502_textmode_video;
 
-/** @brief Create v6502_textmode_video */
-v6502_textmode_video *textMode_create(v6502_memory *mem);
+/** @brief Create v6502_textmode_video, drawing with the given backend */
+/** The headless backend never initializes curses, so it is safe to use without a terminal, and is much cheaper when nobody is watching. */
+v6502_textmode_video *textMode_create(v6502_memory *mem, textMode_backend backend);
 /** @brief Destroy v6502_textmode_video */
 void textMode_destroy(v6502_textmode_video *vid);
 /** @brief Put virtual video into "rest" mode, where the hosting terminal is restored, but the video data is preserved and will be redisplayed on next access */
 void textMode_rest(v6502_textmode_video *vid);
 /** @brief Force a fullscreen refresh */
 void textMode_refreshVideo(v6502_textmode_video *vid);
-/** @brief Refresh a single character of the output (When memory is trapped, this is called automatically on memory interaction) */
+/** @brief Refresh a single character of the output, without waiting for the next frame */
 void textMode_updateCharacter(v6502_textmode_video *vid, int x, int y);
+/** @brief Draw every dirty cell, one span per row, followed by a single refresh of the terminal */
+void textMode_drawFrame(v6502_textmode_video *vid);
+/** @brief Draw a frame, if one is due */
+/** Writes to video memory only mark cells dirty when memory is flushed, and a frame is drawn at most once per frame interval. Call this periodically, such as after every v6502_run, so that cells written just after a frame aren't left waiting for the next write. */
+void textMode_updateVideo(v6502_textmode_video *vid);
+/** @brief Pace frames by host time, at a given number of frames per second, or 0 to draw on every flush */
+void textMode_setFrameRate(v6502_textmode_video *vid, unsigned int framesPerSecond);
+/** @brief Pace frames by emulated time, drawing once every given number of cycles executed by a v6502_cpu */
+void textMode_setFrameCycles(v6502_textmode_video *vid, const v6502_cpu *cpu, uint64_t cycles);
+/** @brief Draw any dirty cells immediately, and return the resulting frame */
+/** The frame is owned by the v6502_textmode_video, and changes with the next frame drawn, so copy it to keep it. */
+const v6502_textmode_frame *textMode_grabFrame(v6502_textmode_video *vid);
+/** @brief Hash the contents of a frame, for cheaply comparing it to a known good frame */
+uint32_t textMode_hashFrame(const v6502_textmode_frame *frame);
+/** @brief Compare two frames, returning the number of cells whose character or attribute differ */
+/** If there are differences, and x and y are not NULL, they are set to the location of the first one. */
+size_t textMode_diffFrames(const v6502_textmode_frame *a, const v6502_textmode_frame *b, int *x, int *y);
+/** @brief Start recording every frame drawn to a stream, timestamped with the cycle count of a v6502_cpu */
+/** Each frame only records the cells that changed since the last one, as spans of run-length coded cells, so a recording of a mostly static screen costs a few bytes per frame. The stream is written with stdio, and is left open when recording stops. Returns NO if the header couldn't be written.
+
+	Every integer in the stream is an unsigned LEB128 varint. After a header of textMode_recordingMagic, the version, and the number of columns and rows (one byte each), each frame is:
+	- the cycles elapsed since the previous frame, or the start of the recording
+	- the number of spans, each of which is
+		- the number of unchanged cells since the end of the previous span (counting left to right, top to bottom)
+		- the number of runs in the span, each of which is
+			- a repeat count, followed by the character and attribute bytes of the repeated cell
+ */
+int textMode_startRecording(v6502_textmode_video *vid, FILE *stream, const v6502_cpu *cpu);
+/** @brief Record any pending changes, and stop recording */
+void textMode_stopRecording(v6502_textmode_video *vid);
+/** @brief Play a recording back to the terminal, with curses */
+/** The recording plays at the given multiple of textMode_playbackClockRate, or as fast as possible if speed is 0. The last frame is left up until a key is pressed. Returns NO if the stream isn't a valid recording. */
+int textMode_play(FILE *stream, double speed);
 /** @brief Convert x, y coordinates to the address in memory that is expected to hold the character */
 uint16_t textMode_addressForLocation(int x, int y);
 /**@}*/
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "timer.h"
+
+static void intervalTimer_expire(v6502_cpu *cpu, void *context);
+
+/** Starts a period at a given cycle, from the current reload and prescaler values */
+static void intervalTimer_start(v6502_intervalTimer *timer, uint64_t start) {
+	timer->start = start;
+	timer->startCount = timer->reload;
+	timer->cyclesPerCount = (uint64_t)timer->prescaler + 1;
+
+	v6502_schedule(timer->cpu, start + ((uint64_t)timer->startCount + 1) * timer->cyclesPerCount, intervalTimer_expire, timer);
+}
+
+static void intervalTimer_expire(v6502_cpu *cpu, void *context) {
+	v6502_intervalTimer *timer = context;
+	uint64_t deadline = timer->start + ((uint64_t)timer->startCount + 1) * timer->cyclesPerCount;
+
+	timer->control |= intervalTimer_control_expired;
+	if (timer->control & intervalTimer_control_irq) {
+		v6502_raiseIRQ(cpu, intervalTimer_irqLine);
+	}
+	if (timer->control & intervalTimer_control_nmi) {
+		v6502_nmi(cpu);
+	}
+
+	// The next period starts on the deadline, not when the event ran, so periodic interrupts don't drift
+	if (timer->control & intervalTimer_control_periodic) {
+		intervalTimer_start(timer, deadline);
+	}
+	else {
+		timer->control &= ~intervalTimer_control_enable;
+	}
+}
+
+uint16_t intervalTimer_count(v6502_intervalTimer *timer) {
+	if (!(timer->control & intervalTimer_control_enable)) {
+		return 0;
+	}
+
+	uint64_t elapsed = (timer->cpu->cycles - timer->start) / timer->cyclesPerCount;
+	return (elapsed >= timer->startCount) ? 0 : (uint16_t)(timer->startCount - elapsed);
+}
+
+static uint8_t intervalTimer_read(v6502_memory *memory, uint16_t offset, int trap, void *context) {
+	v6502_intervalTimer *timer = context;
+
+	switch (offset) {
+		case intervalTimer_controlRegister: {
+			uint8_t control = timer->control;
+			// Only the CPU reading the register acknowledges, not the debugger looking at it
+			if (trap) {
+				timer->control &= ~intervalTimer_control_expired;
+				v6502_clearIRQ(timer->cpu, intervalTimer_irqLine);
+			}
+			return control;
+		}
+		case intervalTimer_reloadLowRegister:
+			return timer->reload & 0xFF;
+		case intervalTimer_reloadHighRegister:
+			return timer->reload >> 8;
+		case intervalTimer_prescalerRegister:
+			return timer->prescaler;
+		case intervalTimer_countLowRegister: {
+			uint16_t count = intervalTimer_count(timer);
+			if (trap) {
+				timer->countHighLatch = count >> 8;
+			}
+			return count & 0xFF;
+		}
+		case intervalTimer_countHighRegister:
+			return trap ? timer->countHighLatch : intervalTimer_count(timer) >> 8;
+		default:
+			return 0;
+	}
+}
+
+static void intervalTimer_write(v6502_memory *memory, uint16_t offset, uint8_t value, void *context) {
+	v6502_intervalTimer *timer = context;
+
+	switch (offset) {
+		case intervalTimer_controlRegister: {
+			const uint8_t writable = intervalTimer_control_enable | intervalTimer_control_periodic | intervalTimer_control_irq | intervalTimer_control_nmi;
+
+			// Any write restarts or stops the timer, so there is never more than one expiry pending
+			v6502_cancelEvents(timer->cpu, intervalTimer_expire, timer);
+			timer->control = (timer->control & ~writable) | (value & writable);
+			if (timer->control & intervalTimer_control_enable) {
+				intervalTimer_start(timer, timer->cpu->cycles);
+			}
+			if (!(timer->control & intervalTimer_control_irq)) {
+				v6502_clearIRQ(timer->cpu, intervalTimer_irqLine);
+			}
+		} break;
+		case intervalTimer_reloadLowRegister:
+			timer->reload = (timer->reload & 0xFF00) | value;
+			break;
+		case intervalTimer_reloadHighRegister:
+			timer->reload = (timer->reload & 0x00FF) | (value << 8);
+			break;
+		case intervalTimer_prescalerRegister:
+			timer->prescaler = value;
+			break;
+		default:
+			break;
+	}
+}
+
+v6502_intervalTimer *intervalTimer_create(v6502_cpu *cpu) {
+	assert(cpu && cpu->memory);
+
+	v6502_intervalTimer *timer = calloc(1, sizeof(v6502_intervalTimer));
+	if (!timer) {
+		return NULL;
+	}
+
+	timer->cpu = cpu;
+	timer->reload = 0xFFFF;
+	timer->cyclesPerCount = 1;
+	if (!v6502_map(cpu->memory, intervalTimer_controlRegister, intervalTimer_registerCount, intervalTimer_read, intervalTimer_write, timer)) {
+		free(timer);
+		return NULL;
+	}
+
+	return timer;
+}
+
+void intervalTimer_destroy(v6502_intervalTimer *timer) {
+	if (!timer) {
+		return;
+	}
+
+	v6502_cancelEvents(timer->cpu, intervalTimer_expire, timer);
+	v6502_clearIRQ(timer->cpu, intervalTimer_irqLine);
+	free(timer);
+}
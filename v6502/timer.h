@@ -0,0 +1,101 @@
+/** @brief 6502 Reference Platform Interval Timer */
+/** @file timer.h */
+
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef v6502_timer_h
+#define v6502_timer_h
+
+#include <v6502/cpu.h>
+#include <v6502/textmode.h>
+
+/** @brief Address of the timer control register */
+#define intervalTimer_controlRegister	(textMode_registerStart + 0x10)
+/** @brief Address of the low byte of the timer reload register */
+#define intervalTimer_reloadLowRegister	(textMode_registerStart + 0x11)
+/** @brief Address of the high byte of the timer reload register */
+#define intervalTimer_reloadHighRegister	(textMode_registerStart + 0x12)
+/** @brief Address of the timer prescaler register */
+#define intervalTimer_prescalerRegister	(textMode_registerStart + 0x13)
+/** @brief Address of the low byte of the timer count register */
+#define intervalTimer_countLowRegister	(textMode_registerStart + 0x14)
+/** @brief Address of the high byte of the timer count register */
+#define intervalTimer_countHighRegister	(textMode_registerStart + 0x15)
+/** @brief Number of timer registers */
+#define intervalTimer_registerCount		6
+/** @brief The v6502_cpu::irqLines bit used by the timer */
+#define intervalTimer_irqLine			(1 << 1)
+
+/** The timer counts down from the reload value once every (prescaler + 1) cycles, and expires when it would pass zero, so a period is (reload + 1) * (prescaler + 1) cycles.
+
+	Writing the control register with intervalTimer_control_enable set starts the timer from the reload value, and writing it without stops it. The reload and prescaler registers only take effect the next time the timer starts or reloads. The count registers are read only; reading the low byte latches the high byte, so a guest can read both without the count moving underneath it. Reading the control register acknowledges an expiry, clearing intervalTimer_control_expired and the IRQ.
+ */
+
+/** @defgroup intervalTimer Reference Platform Interval Timer */
+/**@{*/
+/** @enum */
+/** @brief Timer Control Register Bits */
+typedef enum {
+	/** @brief The timer is counting (read/write) */
+	intervalTimer_control_enable   = 1 << 0,
+	/** @brief Reload and keep counting after expiring, rather than stopping (read/write) */
+	intervalTimer_control_periodic = 1 << 1,
+	/** @brief Raise an IRQ when the timer expires (read/write) */
+	intervalTimer_control_irq      = 1 << 2,
+	/** @brief Raise an NMI when the timer expires (read/write) */
+	intervalTimer_control_nmi      = 1 << 3,
+	/** @brief The timer has expired since the control register was last read (read only) */
+	intervalTimer_control_expired  = 1 << 7,
+} intervalTimer_control;
+
+/** @struct */
+/** @brief Virtual Interval Timer Hardware Object */
+/** The timer is never ticked. The count is worked out from v6502_cpu::cycles when the guest reads it, and expiry is a single event scheduled for the cycle it happens on, so a running timer costs nothing per instruction. */
+typedef struct {
+	/** @brief The v6502_cpu that the timer counts the cycles of, and interrupts */
+	v6502_cpu *cpu;
+	/** @brief Control register */
+	uint8_t control;
+	/** @brief Reload register */
+	uint16_t reload;
+	/** @brief Prescaler register */
+	uint8_t prescaler;
+	/** @brief High byte of the count, latched when the low byte is read */
+	uint8_t countHighLatch;
+	/** @brief Cycle that the current period started on */
+	uint64_t start;
+	/** @brief Cycles per count in the current period, which is fixed when the period starts */
+	uint64_t cyclesPerCount;
+	/** @brief Count that the current period started from */
+	uint16_t startCount;
+} v6502_intervalTimer;
+
+/** @brief Create v6502_intervalTimer, mapping its registers into the v6502_cpu's memory */
+/** The timer starts stopped, with a reload value of 0xFFFF and no prescaling. Returns NULL if the registers can't be mapped, or allocation fails. */
+v6502_intervalTimer *intervalTimer_create(v6502_cpu *cpu);
+/** @brief Destroy v6502_intervalTimer, cancelling any pending expiry */
+void intervalTimer_destroy(v6502_intervalTimer *timer);
+/** @brief Get the current count of a v6502_intervalTimer, which is 0 if it is stopped */
+uint16_t intervalTimer_count(v6502_intervalTimer *timer);
+/**@}*/
+
+#endif
@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "uart.h"
+
+/** Loads the next received byte into the receive register, returning NO if there wasn't one */
+static int uart_receive(v6502_uart *uart) {
+	// The input thread only ends once everything it read is in the ring, so this has to be checked before the ring is
+	int ended = v6502_inputEnded(&uart->input);
+
+	if (!v6502_ringPop(uart->ring, &uart->data)) {
+		if (ended) {
+			uart->status |= uart_status_endOfInput;
+		}
+		return NO;
+	}
+
+	uart->status |= uart_status_received;
+	if (uart->status & uart_status_interruptEnable) {
+		v6502_raiseIRQ(uart->cpu, uart_irqLine);
+	}
+	return YES;
+}
+
+static void uart_poll(v6502_cpu *cpu, void *context) {
+	v6502_uart *uart = context;
+
+	if (!(uart->status & uart_status_received)) {
+		uart_receive(uart);
+	}
+
+	v6502_schedule(cpu, cpu->cycles + uart->pollInterval, uart_poll, uart);
+}
+
+void uart_flush(v6502_uart *uart) {
+	if (!uart->transmitted) {
+		return;
+	}
+
+	size_t written = 0;
+	while (uart->outFd >= 0 && written < uart->transmitted) {
+		ssize_t length = write(uart->outFd, uart->transmitBuffer + written, uart->transmitted - written);
+		if (length < 0 && errno == EINTR) {
+			continue;
+		}
+		// Nobody is listening anymore, so the rest goes nowhere, like a disconnected line
+		if (length <= 0) {
+			break;
+		}
+		written += length;
+	}
+
+	uart->transmitted = 0;
+}
+
+static uint8_t uart_read(v6502_memory *memory, uint16_t offset, int trap, void *context) {
+	v6502_uart *uart = context;
+
+	if (offset == uart_statusRegister) {
+		return uart->status | uart_status_transmitReady;
+	}
+	if (offset != uart_receiveRegister) {
+		return 0;
+	}
+
+	// Only the CPU reading the byte consumes it, not the debugger looking at it
+	uint8_t data = uart->data;
+	if (trap && (uart->status & uart_status_received)) {
+		uart->status &= ~uart_status_received;
+		v6502_clearIRQ(uart->cpu, uart_irqLine);
+		uart_receive(uart);
+	}
+	return data;
+}
+
+static void uart_write(v6502_memory *memory, uint16_t offset, uint8_t value, void *context) {
+	v6502_uart *uart = context;
+
+	if (offset == uart_statusRegister) {
+		uart->status = (uart->status & ~uart_status_interruptEnable) | (value & uart_status_interruptEnable);
+		if ((uart->status & uart_status_interruptEnable) && (uart->status & uart_status_received)) {
+			v6502_raiseIRQ(uart->cpu, uart_irqLine);
+		}
+		else {
+			v6502_clearIRQ(uart->cpu, uart_irqLine);
+		}
+		return;
+	}
+	if (offset != uart_transmitRegister) {
+		return;
+	}
+
+	uart->transmitBuffer[uart->transmitted++] = value;
+	if (value == '\n' || uart->transmitted == uart_transmitBufferSize) {
+		uart_flush(uart);
+	}
+}
+
+v6502_uart *uart_create(v6502_cpu *cpu, int inFd, int outFd) {
+	assert(cpu && cpu->memory);
+
+	v6502_uart *uart = calloc(1, sizeof(v6502_uart));
+	if (!uart) {
+		return NULL;
+	}
+
+	uart->cpu = cpu;
+	uart->outFd = outFd;
+	uart->pollInterval = uart_defaultPollInterval;
+	uart->ring = v6502_createRing(uart_receiveBufferSize);
+	if (!uart->ring || !v6502_map(cpu->memory, uart_statusRegister, 3, uart_read, uart_write, uart)) {
+		v6502_destroyRing(uart->ring);
+		free(uart);
+		return NULL;
+	}
+
+	// Unlike a keyboard, a stream can't lose bytes, so the input thread waits for the guest to make room
+	v6502_startInput(&uart->input, uart->ring, inFd, YES);
+
+	v6502_schedule(cpu, cpu->cycles + uart->pollInterval, uart_poll, uart);
+	return uart;
+}
+
+void uart_destroy(v6502_uart *uart) {
+	if (!uart) {
+		return;
+	}
+
+	uart_flush(uart);
+	v6502_stopInput(&uart->input);
+
+	v6502_cancelEvents(uart->cpu, uart_poll, uart);
+	v6502_clearIRQ(uart->cpu, uart_irqLine);
+	v6502_destroyRing(uart->ring);
+	free(uart);
+}
+
+void uart_listen(v6502_uart *uart) {
+	v6502_listenInput(&uart->input);
+}
+
+void uart_rest(v6502_uart *uart) {
+	v6502_restInput(&uart->input);
+}
@@ -0,0 +1,105 @@
+/** @brief 6502 Reference Platform Serial Port */
+/** @file uart.h */
+
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef v6502_uart_h
+#define v6502_uart_h
+
+#include <v6502/cpu.h>
+#include <v6502/ring.h>
+#include <v6502/input.h>
+#include <v6502/textmode.h>
+
+/** @brief Address of the serial port status register */
+#define uart_statusRegister			(textMode_registerStart + 0x30)
+/** @brief Address of the serial port receive register */
+#define uart_receiveRegister		(textMode_registerStart + 0x31)
+/** @brief Address of the serial port transmit register */
+#define uart_transmitRegister		(textMode_registerStart + 0x32)
+/** @brief The v6502_cpu::irqLines bit used by the serial port */
+#define uart_irqLine				(1 << 2)
+/** @brief Emulated cycles between checks for received bytes, while none are waiting */
+#define uart_defaultPollInterval	1000
+/** @brief Number of bytes that can be received ahead of the guest */
+#define uart_receiveBufferSize		4096
+/** @brief Number of bytes sent by the guest that are held before being written in one go */
+#define uart_transmitBufferSize		256
+
+/** The serial port has three registers, after the block device's.
+
+	Reading the receive register returns the next byte received, and immediately loads the one after it if there is one, so a guest reading a stream never waits on the poll interval. Writing the transmit register sends a byte. They are kept apart because v6502_cpu reads the target of a store as well as writing it, which would consume a received byte. Writing the status register sets uart_status_interruptEnable; the other bits are read only. Like the keyboard, uart_status_received is the high bit, so it can be tested with bit/bmi.
+ */
+
+/** @defgroup uart Reference Platform Serial Port */
+/**@{*/
+/** @enum */
+/** @brief Serial Port Status Register Bits */
+typedef enum {
+	/** @brief Raise an IRQ when a byte is received (read/write) */
+	uart_status_interruptEnable = 1 << 0,
+	/** @brief Nothing more will be received, because the other end has closed (read only) */
+	uart_status_endOfInput      = 1 << 5,
+	/** @brief The transmit register can be written, which it always can, since the port never waits on the host (read only) */
+	uart_status_transmitReady   = 1 << 6,
+	/** @brief The receive register holds a byte that hasn't been read yet (read only) */
+	uart_status_received        = 1 << 7,
+} uart_status;
+
+/** @struct */
+/** @brief Virtual Serial Port Hardware Object */
+/** Received bytes are read from a host file descriptor by an input thread, in as large chunks as are available, and passed to the CPU's thread through a v6502_ring. Sent bytes are held in a buffer, and written to a host file descriptor a line at a time, when the buffer fills, or when uart_flush is called, so a guest printing text costs a system call per line rather than per byte. */
+typedef struct {
+	/** @brief The v6502_cpu that received bytes are delivered to */
+	v6502_cpu *cpu;
+	/** @brief Bytes read by the input thread, waiting for the CPU */
+	v6502_ring *ring;
+	/** @brief Host file descriptor bytes are sent to, or -1 if they are discarded */
+	int outFd;
+	/** @brief Input thread, which waits for room when the ring is full */
+	v6502_input input;
+	/** @brief Status register */
+	uint8_t status;
+	/** @brief Receive register */
+	uint8_t data;
+	/** @brief Bytes sent by the guest that haven't been written yet */
+	uint8_t transmitBuffer[uart_transmitBufferSize];
+	/** @brief Number of bytes in v6502_uart::transmitBuffer */
+	size_t transmitted;
+	/** @brief Emulated cycles between checks of the ring */
+	uint64_t pollInterval;
+} v6502_uart;
+
+/** @brief Create v6502_uart, mapping its registers into the v6502_cpu's memory */
+/** If inFd is -1, no input thread is started, and nothing is ever received. If outFd is -1, sent bytes are discarded. The two can be the same descriptor, such as a socket. The input thread doesn't read until uart_listen is called. Returns NULL if the registers can't be mapped, or allocation fails. */
+v6502_uart *uart_create(v6502_cpu *cpu, int inFd, int outFd);
+/** @brief Destroy v6502_uart, writing anything still buffered and stopping its input thread */
+void uart_destroy(v6502_uart *uart);
+/** @brief Let the input thread start reading, such as when the CPU starts running */
+void uart_listen(v6502_uart *uart);
+/** @brief Stop the input thread from reading, so that something else (such as the debugger) can read the file descriptor */
+void uart_rest(v6502_uart *uart);
+/** @brief Write anything the guest has sent that is still buffered, such as at the end of a run */
+void uart_flush(v6502_uart *uart);
+/**@}*/
+
+#endif
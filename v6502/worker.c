@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <assert.h>
+
+#include "worker.h"
+#include "mem.h"
+
+#pragma mark Queues
+
+static int _initQueue(worker_queue *queue) {
+	queue->head = 0;
+	queue->tail = 0;
+	return !sem_init(&queue->pending, 0, 0);
+}
+
+/** Only the producer may post, and the queue is never allowed to fill, since each side waits for its answers */
+static void _post(worker_queue *queue, worker_message message) {
+	size_t head = queue->head;
+	assert(head - __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) < worker_queueLength);
+
+	queue->messages[head & (worker_queueLength - 1)] = message;
+	__atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+	sem_post(&queue->pending);
+}
+
+/** Only the consumer may receive. Returns NO if nothing was waiting, and wait was NO. */
+static int _receive(worker_queue *queue, worker_message *message, int wait) {
+	if (wait) {
+		while (sem_wait(&queue->pending) && errno == EINTR);
+	}
+	else if (sem_trywait(&queue->pending)) {
+		return NO;
+	}
+
+	size_t tail = queue->tail;
+	assert(__atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) != tail);
+
+	*message = queue->messages[tail & (worker_queueLength - 1)];
+	__atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+	return YES;
+}
+
+#pragma mark Worker Thread
+
+static void _stopped(v6502_worker *worker, worker_stop stop) {
+	worker_message message = { .type = worker_message_stopped, .stop = stop };
+	_post(&worker->events, message);
+}
+
+static void *_workerThread(void *context) {
+	v6502_worker *worker = context;
+	int running = NO;
+
+	for (;;) {
+		// Only sleep on the queue when there is nothing to run
+		worker_message message;
+		while (_receive(&worker->commands, &message, !running)) {
+			switch (message.type) {
+				case worker_message_resume:
+					running = YES;
+					break;
+				case worker_message_pause:
+					// A CPU that already stopped on its own has sent its stop
+					if (running) {
+						running = NO;
+						_stopped(worker, worker_stop_pause);
+					}
+					break;
+				case worker_message_call: {
+					message.call(worker->cpu, message.context);
+					worker_message called = { .type = worker_message_called };
+					_post(&worker->events, called);
+				} break;
+				case worker_message_quit:
+					return NULL;
+				default:
+					break;
+			}
+		}
+
+		worker_stop stop = worker->batch(worker->cpu, worker->context);
+		if (stop != worker_stop_none) {
+			running = NO;
+			_stopped(worker, stop);
+		}
+	}
+}
+
+#pragma mark Debugger Side
+
+/** Waits for the next event of a given type, setting aside a stop that arrives first */
+static void _await(v6502_worker *worker, worker_messageType type) {
+	worker_message message;
+	do {
+		_receive(&worker->events, &message, YES);
+		if (message.type == worker_message_stopped && type != worker_message_stopped) {
+			worker->stop = message.stop;
+			worker->stopPending = YES;
+		}
+	} while (message.type != type);
+
+	if (type == worker_message_stopped) {
+		worker->stop = message.stop;
+		worker->stopPending = YES;
+	}
+}
+
+/** Hands over a stop that has arrived, once the debugger owns the CPU again */
+static worker_stop _takeStop(v6502_worker *worker) {
+	worker->stopPending = NO;
+	worker->running = NO;
+	return worker->stop;
+}
+
+v6502_worker *worker_create(v6502_cpu *cpu, worker_batchFunction *batch, void *context) {
+	assert(cpu && batch);
+
+	v6502_worker *worker = calloc(1, sizeof(v6502_worker));
+	if (!worker) {
+		return NULL;
+	}
+
+	worker->cpu = cpu;
+	worker->batch = batch;
+	worker->context = context;
+	if (!_initQueue(&worker->commands)) {
+		free(worker);
+		return NULL;
+	}
+	if (!_initQueue(&worker->events)) {
+		sem_destroy(&worker->commands.pending);
+		free(worker);
+		return NULL;
+	}
+
+	// Signals are left to the debugger's thread, which is the one that knows what to do with them
+	sigset_t all, previous;
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &previous);
+	int failed = pthread_create(&worker->thread, NULL, _workerThread, worker);
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+	if (failed) {
+		sem_destroy(&worker->events.pending);
+		sem_destroy(&worker->commands.pending);
+		free(worker);
+		return NULL;
+	}
+
+	return worker;
+}
+
+void worker_destroy(v6502_worker *worker) {
+	if (!worker) {
+		return;
+	}
+
+	worker_pause(worker);
+
+	worker_message quit = { .type = worker_message_quit };
+	_post(&worker->commands, quit);
+	pthread_join(worker->thread, NULL);
+
+	sem_destroy(&worker->events.pending);
+	sem_destroy(&worker->commands.pending);
+	free(worker);
+}
+
+void worker_resume(v6502_worker *worker) {
+	assert(worker);
+
+	if (worker->running) {
+		return;
+	}
+
+	worker->running = YES;
+	worker->stopPending = NO;
+	worker_message resume = { .type = worker_message_resume };
+	_post(&worker->commands, resume);
+}
+
+worker_stop worker_pause(v6502_worker *worker) {
+	assert(worker);
+
+	if (!worker->running) {
+		return worker_stop_none;
+	}
+
+	if (!worker->stopPending) {
+		worker_message pause = { .type = worker_message_pause };
+		_post(&worker->commands, pause);
+		_await(worker, worker_message_stopped);
+	}
+	return _takeStop(worker);
+}
+
+void worker_call(v6502_worker *worker, worker_callFunction *call, void *context) {
+	assert(worker && call);
+
+	// A stopped CPU belongs to this thread already
+	if (!worker->running) {
+		call(worker->cpu, context);
+		return;
+	}
+
+	worker_message message = { .type = worker_message_call, .call = call, .context = context };
+	_post(&worker->commands, message);
+	_await(worker, worker_message_called);
+}
+
+int worker_pollStop(v6502_worker *worker, worker_stop *stop) {
+	assert(worker && stop);
+
+	if (!worker->running) {
+		return NO;
+	}
+
+	worker_message message;
+	while (!worker->stopPending && _receive(&worker->events, &message, NO)) {
+		if (message.type == worker_message_stopped) {
+			worker->stop = message.stop;
+			worker->stopPending = YES;
+		}
+	}
+
+	if (!worker->stopPending) {
+		return NO;
+	}
+
+	*stop = _takeStop(worker);
+	return YES;
+}
+
+worker_stop worker_waitForStop(v6502_worker *worker) {
+	assert(worker);
+
+	if (!worker->running) {
+		return worker_stop_none;
+	}
+
+	if (!worker->stopPending) {
+		_await(worker, worker_message_stopped);
+	}
+	return _takeStop(worker);
+}
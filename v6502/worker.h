@@ -0,0 +1,149 @@
+/** @brief GDB Remote Serial Protocol Stub */
+/** @file gdbstub.h */
+
+/*
+ * Copyright (c) 2013 Daniel Loffgren
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef v6502_worker_h
+#define v6502_worker_h
+
+#include <pthread.h>
+#include <semaphore.h>
+
+#include <v6502/cpu.h>
+
+/** @brief Number of messages that can be waiting in each direction */
+#define worker_queueLength		8
+
+/** The worker owns the v6502_cpu while it is running, and the thread that created it (the debugger) owns it while it is stopped. Messages go each way through a single producer, single consumer queue like v6502_ring, so posting a command never takes a lock. A semaphore counts the messages in each queue, but only so that whichever side has nothing to do can sleep.
+
+	While running, the worker runs the CPU in batches, and only looks at its commands between them. Commands therefore take effect at an instruction boundary, within one batch of being posted, and a function passed to worker_call sees the machine in a consistent state even though the guest keeps going afterwards.
+
+	Every worker_resume is answered by exactly one stop, whether the batch function stopped the CPU or worker_pause did.
+ */
+
+/** @defgroup worker CPU Worker Thread */
+/**@{*/
+/** @enum */
+/** @brief Reasons the CPU stops running */
+typedef enum {
+	/** @brief Still running, which is only returned by a worker_batchFunction */
+	worker_stop_none,
+	/** @brief Reached a brk instruction */
+	worker_stop_brk,
+	/** @brief Hit a breakpoint */
+	worker_stop_breakpoint,
+	/** @brief Received an interrupt from the host */
+	worker_stop_interrupt,
+	/** @brief Paused by worker_pause */
+	worker_stop_pause,
+} worker_stop;
+
+/** @brief Runs one batch of instructions on the worker thread, returning why the CPU stopped, or worker_stop_none to keep going */
+typedef worker_stop (worker_batchFunction)(v6502_cpu *cpu, void *context);
+/** @brief Runs on the worker thread between batches, for worker_call */
+typedef void (worker_callFunction)(v6502_cpu *cpu, void *context);
+
+/** @enum */
+/** @brief Kinds of Messages Between the Debugger and the Worker */
+typedef enum {
+	/** @brief Start running (command) */
+	worker_message_resume,
+	/** @brief Stop running (command) */
+	worker_message_pause,
+	/** @brief Call a function between batches (command) */
+	worker_message_call,
+	/** @brief Exit the worker thread (command) */
+	worker_message_quit,
+	/** @brief The CPU stopped running (event) */
+	worker_message_stopped,
+	/** @brief A function passed to worker_call returned (event) */
+	worker_message_called,
+} worker_messageType;
+
+/** @struct */
+/** @brief A Message Between the Debugger and the Worker */
+typedef struct {
+	/** @brief What kind of message this is */
+	worker_messageType type;
+	/** @brief Why the CPU stopped, for worker_message_stopped */
+	worker_stop stop;
+	/** @brief Function to call, for worker_message_call */
+	worker_callFunction *call;
+	/** @brief Context for worker_message::call */
+	void *context;
+} worker_message;
+
+/** @struct */
+/** @brief Lock-free Message Queue */
+typedef struct {
+	/** @brief Storage for queued messages */
+	worker_message messages[worker_queueLength];
+	/** @brief Count of messages ever posted, only written by the producer */
+	size_t head;
+	/** @brief Count of messages ever received, only written by the consumer */
+	size_t tail;
+	/** @brief Count of messages waiting, for the consumer to sleep on */
+	sem_t pending;
+} worker_queue;
+
+/** @struct */
+/** @brief CPU Worker Thread Object */
+typedef struct {
+	/** @brief The v6502_cpu being run */
+	v6502_cpu *cpu;
+	/** @brief Runs each batch of instructions */
+	worker_batchFunction *batch;
+	/** @brief Context for v6502_worker::batch */
+	void *context;
+	/** @brief Commands from the debugger */
+	worker_queue commands;
+	/** @brief Events from the worker */
+	worker_queue events;
+	/** @brief Worker thread */
+	pthread_t thread;
+	/** @brief Whether the debugger has resumed the CPU without seeing it stop yet, only used by the debugger's thread */
+	int running;
+	/** @brief Whether v6502_worker::stop holds a stop that arrived while waiting for something else, only used by the debugger's thread */
+	int stopPending;
+	/** @brief A stop that arrived while waiting for something else, only used by the debugger's thread */
+	worker_stop stop;
+} v6502_worker;
+
+/** @brief Create a v6502_worker that runs a v6502_cpu with a worker_batchFunction, starting out stopped */
+/** Returns NULL if the thread can't be started. */
+v6502_worker *worker_create(v6502_cpu *cpu, worker_batchFunction *batch, void *context);
+/** @brief Destroy a v6502_worker, stopping the CPU first if it is running */
+void worker_destroy(v6502_worker *worker);
+/** @brief Start running the CPU, returning immediately */
+void worker_resume(v6502_worker *worker);
+/** @brief Stop running the CPU, returning why it stopped, which is worker_stop_pause unless it had already stopped on its own, or worker_stop_none if it wasn't running */
+worker_stop worker_pause(v6502_worker *worker);
+/** @brief Run a function with the CPU at an instruction boundary, returning after it does */
+/** If the CPU is stopped, the function is called right away on the calling thread. */
+void worker_call(v6502_worker *worker, worker_callFunction *call, void *context);
+/** @brief Check whether a running CPU has stopped, without waiting. Returns YES, and why in stop, if it has. */
+int worker_pollStop(v6502_worker *worker, worker_stop *stop);
+/** @brief Wait for a running CPU to stop on its own, returning why, or worker_stop_none if it isn't running */
+worker_stop worker_waitForStop(v6502_worker *worker);
+/**@}*/
+
+#endif